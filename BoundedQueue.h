@@ -0,0 +1,95 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_BOUNDEDQUEUE_H_
+#define PROJEKT_BOUNDEDQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+// Lock-free ring buffer of fixed capacity for any number of producers and
+// consumers. Every cell carries a sequence number which tells whether it
+// is ready to be written or read in the current round, so push() and pop()
+// only need one compare-and-swap on their cursor.
+template <typename T>
+class BoundedQueue {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit BoundedQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    _mask = size - 1;
+    _cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) _cells[i].sequence = i;
+    _enqueue = 0;
+    _dequeue = 0;
+  }
+
+  // Append a value, returns false if the queue is full.
+  bool push(const T& value) {
+    size_t position = _enqueue.load(std::memory_order_relaxed);
+    while (true) {
+      Cell* cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+      if (diff == 0) {
+        if (_enqueue.compare_exchange_weak(position, position + 1,
+                std::memory_order_relaxed)) {
+          cell->value = value;
+          cell->sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Take the oldest value, returns false if the queue is empty.
+  bool pop(T* value) {
+    size_t position = _dequeue.load(std::memory_order_relaxed);
+    while (true) {
+      Cell* cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+      if (diff == 0) {
+        if (_dequeue.compare_exchange_weak(position, position + 1,
+                std::memory_order_relaxed)) {
+          *value = cell->value;
+          // the cell can be written again in the next round
+          cell->sequence.store(position + _mask + 1,
+              std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = _dequeue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> _cells;
+  size_t _mask;
+
+  // producers and consumers work on different cache lines
+  std::atomic<size_t> _enqueue __attribute__((aligned(64)));
+  std::atomic<size_t> _dequeue __attribute__((aligned(64)));
+
+  // no copies
+  BoundedQueue(const BoundedQueue&);
+  BoundedQueue& operator=(const BoundedQueue&);
+};
+
+#endif  // PROJEKT_BOUNDEDQUEUE_H_
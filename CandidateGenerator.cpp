@@ -0,0 +1,100 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <string.h>
+#include "./CandidateGenerator.h"
+
+const uint64_t CandidateGenerator::kOverflow;
+
+// Constructor, starts at the first combination
+CandidateGenerator::CandidateGenerator(const char* characters,
+    unsigned length, ByteOrder order) {
+  const unsigned kBase = strlen(characters);
+  for (unsigned i = 0; i < length; i++) {
+    _alphabets[i] = characters;
+    _bases[i] = kBase;
+  }
+  init(length, order);
+}
+
+// Constructor for masks, starts at the first combination
+CandidateGenerator::CandidateGenerator(const char* const* alphabets,
+    unsigned length, ByteOrder order) {
+  for (unsigned i = 0; i < length; i++) {
+    _alphabets[i] = alphabets[i];
+    _bases[i] = strlen(alphabets[i]);
+  }
+  init(length, order);
+}
+
+void CandidateGenerator::init(unsigned length, ByteOrder order) {
+  _length = length;
+  _dataWords = length / 4 + 1;
+
+  for (unsigned i = 0; i <= kMaxLength; i++) {
+    _shift[i] = (order == kLittleEndian) ? (i & 3) * 8 : (3 - (i & 3)) * 8;
+  }
+
+  // the padding never changes, only the character bytes do
+  memset(_block, 0, sizeof(_block));
+  _block[length / 4] = 0x80u << _shift[length];
+  if (order == kLittleEndian) {
+    _block[14] = length << 3;
+  } else {
+    _block[15] = length << 3;
+  }
+  seek(0);
+}
+
+void CandidateGenerator::setChar(unsigned position) {
+  const uint8_t c = _alphabets[position][_digits[position]];
+  _word[position] = c;
+  uint32_t* word = &_block[position / 4];
+  *word = (*word & ~(0xffu << _shift[position]))
+      | ((uint32_t)c << _shift[position]);
+}
+
+uint64_t CandidateGenerator::keyspace() const {
+  uint64_t n = 1;
+  for (unsigned i = 0; i < _length; i++) {
+    if (__builtin_mul_overflow(n, _bases[i], &n)) return kOverflow;
+  }
+  return n;
+}
+
+uint64_t CandidateGenerator::lastWordKeyspace() const {
+  uint64_t n = 1;
+  for (unsigned i = 4 * lastWord(); i < _length; i++) n *= _bases[i];
+  return n;
+}
+
+// The only place with divisions, called once per range of combinations
+void CandidateGenerator::seek(uint64_t index) {
+  for (int i = _length - 1; i >= 0; i--) {
+    _digits[i] = index % _bases[i];
+    index /= _bases[i];
+    setChar(i);
+  }
+}
+
+bool CandidateGenerator::next() {
+  for (int i = _length - 1; i >= 0; i--) {
+    if (++_digits[i] < _bases[i]) {
+      setChar(i);
+      return true;
+    }
+    // wrap around and carry into the position before
+    _digits[i] = 0;
+    setChar(i);
+  }
+  return false;
+}
+
+void CandidateGenerator::fillLanes(LaneBlock* lanes) const {
+  for (unsigned i = 0; i < 16; i++) {
+    for (unsigned lane = 0; lane < kMaxLanes; lane++) {
+      lanes->words[i][lane] = _block[i];
+    }
+  }
+}
@@ -0,0 +1,112 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>
+
+#ifndef PROJEKT_CANDIDATEGENERATOR_H_
+#define PROJEKT_CANDIDATEGENERATOR_H_
+
+#include <stdint.h>
+#include "./algorithms/LaneBlock.h"
+
+// Generates the combinations of a fixed length out of a set of characters,
+// or out of its own set of characters for every position (a mask). The
+// index of a combination is a mixed-radix number, it is decoded once with
+// seek(), after that next() works like an odometer: the last position is
+// incremented and only carries into the position before it when it wraps
+// around.
+//
+// The generator keeps its combination as a pre-padded single message block
+// (0x80 byte and bit length already set) in the byte order of the hash
+// kernel, so next() only rewrites the bytes of the positions it changed.
+class CandidateGenerator {
+ public:
+  // longest combination which still fits into a single block
+  static const unsigned kMaxLength = 55;
+
+  // keyspace() of more combinations than a 64 bit index can count
+  static const uint64_t kOverflow = UINT64_MAX;
+
+  // MD5 reads little endian words, SHA-1 big endian ones
+  enum ByteOrder { kLittleEndian, kBigEndian };
+
+  // The characters are not copied and must outlive the generator.
+  CandidateGenerator(const char* characters, unsigned length,
+      ByteOrder order);
+
+  // The same with the characters of every position in alphabets[position].
+  CandidateGenerator(const char* const* alphabets, unsigned length,
+      ByteOrder order);
+
+  // number of combinations of this length, kOverflow if they do not fit
+  // into the 64 bit index of seek()
+  uint64_t keyspace() const;
+
+  // Jump to the combination with the given index, the last position is the
+  // one which changes fastest.
+  void seek(uint64_t index);
+
+  // Advance to the next combination. Returns false after the last one, the
+  // generator is then back at the first combination.
+  bool next();
+
+  // the current combination (not null-terminated) and its length
+  const char* word() const { return _word; }
+  unsigned length() const { return _length; }
+
+  // the padded message block of the current combination
+  const uint32_t* block() const { return _block; }
+
+  // The last word of the block holding characters. Its positions change
+  // fastest, so runs of lastWordKeyspace() combinations share all other
+  // words of the block (not defined for length 0).
+  unsigned lastWord() const { return (_length - 1) / 4; }
+  uint64_t lastWordKeyspace() const;
+
+  // Copy the whole padded block into every lane, after that copyToLane()
+  // only has to copy the words holding characters.
+  void fillLanes(LaneBlock* lanes) const;
+
+  // Copy the words of the block which hold characters into the lane.
+  void copyToLane(LaneBlock* lanes, unsigned lane) const {
+    for (unsigned i = 0; i < _dataWords; i++) {
+      lanes->words[i][lane] = _block[i];
+    }
+  }
+
+  // The same with dataWords() known at compile time, the loop is unrolled.
+  template <unsigned kDataWords>
+  void copyToLane(LaneBlock* lanes, unsigned lane) const {
+    for (unsigned i = 0; i < kDataWords; i++) {
+      lanes->words[i][lane] = _block[i];
+    }
+  }
+
+  // number of words of the block holding characters and the 0x80 byte
+  unsigned dataWords() const { return _dataWords; }
+
+ private:
+  void init(unsigned length, ByteOrder order);
+
+  // write the character of the current digit at this position into the
+  // word and into the block
+  void setChar(unsigned position);
+
+  // characters and their number for every position
+  const char* _alphabets[kMaxLength];
+  unsigned _bases[kMaxLength];
+  unsigned _length;
+
+  // words of the block holding characters (including the 0x80 byte)
+  unsigned _dataWords;
+
+  // bit offset of every byte position inside its block word
+  unsigned _shift[kMaxLength + 1];
+
+  // index of the character at every position
+  unsigned _digits[kMaxLength];
+
+  char _word[kMaxLength];
+  uint32_t _block[16];
+};
+
+#endif  // PROJEKT_CANDIDATEGENERATOR_H_
@@ -0,0 +1,116 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./Checkpoint.h"
+
+// first line of every state file, the version is raised if the format or
+// the order of the chunks changes
+static const char* kHeader = "hashfinder-checkpoint 1";
+
+// Constructor, nothing done yet
+Checkpoint::Checkpoint() : _first(0) {
+}
+
+void Checkpoint::start(const string& search) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _search = search;
+  _first = 0;
+  _done.clear();
+}
+
+bool Checkpoint::load(const char* fileName, string* error) {
+  std::ifstream file(fileName);
+  if (!file.is_open()) {
+    *error = "cannot be opened";
+    return false;
+  }
+  string header;
+  string search;
+  string first;
+  string done;
+  std::getline(file, header);
+  std::getline(file, search);
+  std::getline(file, first);
+  std::getline(file, done);
+  if (header != kHeader || search.compare(0, 7, "search ") != 0
+      || first.compare(0, 5, "next ") != 0
+      || done.compare(0, 4, "done") != 0) {
+    *error = "is no checkpoint";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (search.substr(7) != _search) {
+    *error = "belongs to a different search";
+    return false;
+  }
+  std::istringstream next(first.substr(5));
+  if (!(next >> _first)) {
+    *error = "is no checkpoint";
+    return false;
+  }
+  _done.clear();
+  std::istringstream indices(done.substr(4));
+  uint64_t index;
+  while (indices >> index) {
+    if (index > _first) _done.insert(index);
+  }
+  return true;
+}
+
+void Checkpoint::complete(uint64_t index) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (index != _first) {
+    _done.insert(index);
+    return;
+  }
+  // move the first open chunk over the done ones directly after it
+  _first++;
+  while (!_done.empty() && *_done.begin() == _first) {
+    _done.erase(_done.begin());
+    _first++;
+  }
+}
+
+uint64_t Checkpoint::first() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _first;
+}
+
+vector<uint64_t> Checkpoint::done() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return vector<uint64_t>(_done.begin(), _done.end());
+}
+
+bool Checkpoint::save(const char* fileName) const {
+  std::ostringstream state;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    state << kHeader << "\nsearch " << _search << "\nnext " << _first
+        << "\ndone";
+    for (std::set<uint64_t>::const_iterator it = _done.begin();
+        it != _done.end(); ++it) {
+      state << ' ' << *it;
+    }
+    state << '\n';
+  }
+  const string kTemporary = string(fileName) + ".tmp";
+  FILE* file = fopen(kTemporary.c_str(), "w");
+  if (file == NULL) return false;
+  const string kState = state.str();
+  // the data has to be on disk before the rename replaces the old state
+  bool ok = fwrite(kState.data(), 1, kState.size(), file) == kState.size()
+      && fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(kTemporary.c_str(), fileName) != 0) {
+    remove(kTemporary.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,56 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_CHECKPOINT_H_
+#define PROJEKT_CHECKPOINT_H_
+
+#include <stdint.h>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// The chunks of the Scheduler which are done, so that an interrupted
+// search can be continued. The threads finish their chunks out of order,
+// so the state is the first chunk not done yet plus the done chunks after
+// it. The set stays small: there is at most about one chunk per thread
+// after the first open one.
+//
+// usage: 1) start() a search or load() the state of an earlier run
+//        2) every worker calls complete() after each chunk
+//        3) save() now and then, the file is replaced atomically
+class Checkpoint {
+ public:
+  Checkpoint();
+
+  // Start with no chunk done. The search describes what is searched, a
+  // state file of a different search cannot be loaded.
+  void start(const string& search);
+
+  // Read the state of the search given to start() from a file. Returns
+  // false and sets error if it cannot be read or is for another search.
+  bool load(const char* fileName, string* error);
+
+  // Mark the chunk with this index as done.
+  void complete(uint64_t index);
+
+  // The first chunk which is not done and the done chunks after it.
+  uint64_t first() const;
+  vector<uint64_t> done() const;
+
+  // Write the state to fileName.tmp and rename it to fileName, so the file
+  // is either the old or the new state. Returns false if it fails.
+  bool save(const char* fileName) const;
+
+ private:
+  mutable std::mutex _mutex;
+  string _search;
+  uint64_t _first;
+  std::set<uint64_t> _done;
+};
+
+#endif  // PROJEKT_CHECKPOINT_H_
@@ -0,0 +1,469 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <sstream>
+#include <utility>
+#include "./Daemon.h"
+#include "./Topology.h"
+
+namespace {
+// The options of a job which would write files or take the hashes from a
+// file, they are refused before the parser opens the files
+const char* const kRefused[] = {
+  "stream", "hash-file", "status-json", "checkpoint", "restore",
+  "generate-table", "build-index"
+};
+const size_t kRefusedCount = sizeof(kRefused) / sizeof(kRefused[0]);
+const char kRefusedReason[] = "<daemon> jobs cannot stream a dictionary, "
+    "read a hash file or write a JSON status, a checkpoint, a table or an "
+    "index.";
+
+// The options which only change the speed or the output of a search, the
+// values of the job which created a search are kept
+const char* const kIgnored[] = { "kernel", "pin", "no-smt", "status" };
+const size_t kIgnoredCount = sizeof(kIgnored) / sizeof(kIgnored[0]);
+
+// Whether an option "name=value" or "name" is one of the names
+bool isOneOf(const string& option, const char* const* names, size_t count) {
+  const string kName = option.substr(0, option.find('='));
+  for (size_t i = 0; i < count; i++) {
+    if (kName == names[i]) return true;
+  }
+  return false;
+}
+
+bool isRefused(const string& option) {
+  return isOneOf(option, kRefused, kRefusedCount);
+}
+}  // namespace
+
+// Constructor, not listening yet
+Daemon::Daemon() : _socket(-1), _stopping(false), _readers(0),
+    _maxFinders(kMaxFinders), _lookups(0), _batchWindow(kBatchWindow),
+    _readTimeout(kReadTimeout), _passes(0), _holdUntil(0), _round(0),
+    _busy(0), _quit(false) {
+}
+
+// Destructor
+Daemon::~Daemon() {
+  if (_socket >= 0) {
+    close(_socket);
+    unlink(_path.c_str());
+  }
+}
+
+Daemon::Resident::Resident() : used(0) {
+  void* memory = NULL;
+  if (posix_memalign(&memory, alignof(HashFinder), sizeof(HashFinder)) != 0) {
+    throw std::bad_alloc();
+  }
+  hashfinder = new(memory) HashFinder();
+}
+
+Daemon::Resident::~Resident() {
+  hashfinder->~HashFinder();
+  free(hashfinder);
+}
+
+bool Daemon::listen(const char* path, string* error) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    *error = "is too long for a socket path";
+    return false;
+  }
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+  _socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (_socket < 0) {
+    *error = "cannot be created";
+    return false;
+  }
+  // a daemon which did not shut down left its socket file behind
+  unlink(path);
+  if (bind(_socket, reinterpret_cast<struct sockaddr*>(&address),
+      sizeof(address)) != 0 || ::listen(_socket, SOMAXCONN) != 0) {
+    close(_socket);
+    _socket = -1;
+    *error = "cannot be bound";
+    return false;
+  }
+  // jobs read any file the daemon can read, so only its user may send them
+  if (chmod(path, S_IRUSR | S_IWUSR) != 0) {
+    close(_socket);
+    _socket = -1;
+    unlink(path);
+    *error = "cannot be restricted to its user";
+    return false;
+  }
+  _path = path;
+  return true;
+}
+
+void Daemon::serve() {
+  // the workers are started once, like the threads of a single search
+  Topology topology;
+  topology.detect();
+  const size_t kWorkers = std::max<size_t>(1, topology.workers(false).size());
+  for (size_t i = 1; i <= kWorkers; i++) {
+    _workers.push_back(std::thread(&Daemon::work, this, i));
+  }
+  _runner = std::thread(&Daemon::runJobs, this);
+
+  while (!_stopping.load()) {
+    int fd = accept(_socket, NULL, NULL);
+    if (fd < 0) {
+      // e.g. out of file descriptors, the jobs running will free some
+      if (!_stopping.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      continue;
+    }
+    // a slow client must not hold up the next ones or the batch window
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _readers++;
+    }
+    std::thread(&Daemon::receive, this, fd).detach();
+  }
+
+  _queued.notify_one();
+  _runner.join();
+  {
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    _quit = true;
+  }
+  _poolWake.notify_all();
+  for (size_t i = 0; i < _workers.size(); i++) _workers[i].join();
+  _workers.clear();
+}
+
+void Daemon::stop() {
+  _stopping.store(true);
+  // wakes up accept()
+  shutdown(_socket, SHUT_RDWR);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _queued.notify_one();
+}
+
+void Daemon::receive(int fd) {
+  Job job;
+  job.fd = fd;
+  const bool kValid = readJob(fd, _readTimeout, &job);
+  if (!kValid) {
+    answer(&job, "error: a job is the options and at least one hash\n");
+  }
+  // notified under the lock, the daemon may be gone once it is released
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (kValid) _jobs.push_back(job);
+  _readers--;
+  _queued.notify_one();
+}
+
+bool Daemon::readJob(int fd, int timeout, Job* job) {
+  // a client which never sends its line cannot block the daemon
+  struct timeval limit = { timeout, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+  string line;
+  char buffer[4096];
+  while (line.find('\n') == string::npos && line.size() < kMaxJob) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) break;
+    line.append(buffer, n);
+  }
+  line = line.substr(0, line.find('\n'));
+
+  vector<string> words;
+  std::istringstream stream(line);
+  string word;
+  while (stream >> word) words.push_back(word);
+  // the hashes are the hex strings of 32 (MD5) or 40 (SHA-1) digits at
+  // the end, the options before them may be written as on the command line
+  size_t first = words.size();
+  while (first > 0 && (words[first - 1].size() == 32
+      || words[first - 1].size() == 40) && std::all_of(
+      words[first - 1].begin(), words[first - 1].end(), ::isxdigit)) {
+    first--;
+  }
+  job->options.assign(words.begin(), words.begin() + first);
+  job->hashes.assign(words.begin() + first, words.end());
+  return !job->hashes.empty();
+}
+
+void Daemon::runJobs() {
+  while (true) {
+    vector<Job> jobs;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      // the jobs still being read are answered before stopping
+      _queued.wait(lock, [&]() {
+        return (!_jobs.empty() && _jobs.size() >= _holdUntil)
+            || (_stopping.load() && _readers == 0);
+      });
+      if (_jobs.empty()) return;
+      // clients sending their jobs at the same time get the same pass
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(_batchWindow));
+      lock.lock();
+      jobs.swap(_jobs);
+    }
+    std::map<string, vector<Job> > batches;
+    for (size_t i = 0; i < jobs.size(); i++) {
+      batches[key(jobs[i].options)].push_back(jobs[i]);
+    }
+    // The batches run one after the other, each on all workers: running
+    // two sources at once would only split the cores between them. A long
+    // batch therefore holds up the jobs queued behind it, which is
+    // intended, and the jobs arriving meanwhile share the next pass.
+    for (std::map<string, vector<Job> >::iterator it = batches.begin();
+        it != batches.end(); ++it) {
+      runBatch(&it->second);
+    }
+  }
+}
+
+void Daemon::runBatch(vector<Job>* jobs) {
+  string error;
+  HashFinder* hashfinder = finder(jobs->front().options,
+      jobs->front().hashes.front(), &error);
+  if (hashfinder == NULL) {
+    for (size_t i = 0; i < jobs->size(); i++) {
+      answer(&(*jobs)[i], "error: " + error + "\n");
+    }
+    return;
+  }
+  // a job with an invalid hash does not spoil the others
+  vector<string> hashes;
+  vector<Job*> valid;
+  for (size_t i = 0; i < jobs->size(); i++) {
+    Job& job = (*jobs)[i];
+    if (!hashfinder->checkTargets(job.hashes, &error)) {
+      answer(&job, "error: " + error + "\n");
+      continue;
+    }
+    hashes.insert(hashes.end(), job.hashes.begin(), job.hashes.end());
+    valid.push_back(&job);
+  }
+  if (valid.empty()) return;
+
+  printf("[Daemon] Searching %zu hashes of %zu jobs.\n", hashes.size(),
+      valid.size());
+  if (!hashfinder->retarget(hashes, &error)) {
+    error = error.substr(0, error.find('\n'));
+    for (size_t i = 0; i < valid.size(); i++) {
+      answer(valid[i], "error: " + error + "\n");
+    }
+    return;
+  }
+  _passes++;
+  const unsigned kThreads = hashfinder->threadCount();
+  runWorkers([&](unsigned threadnumber) {
+    if (threadnumber <= kThreads) hashfinder->process(threadnumber);
+  });
+  // no reporter runs beside the workers, the results are drained here
+  hashfinder->stopReport();
+  hashfinder->report();
+  hashfinder->printSummary();
+
+  std::map<string, vector<string> > found;
+  vector<std::pair<string, string> > collisions = hashfinder->collisions();
+  for (size_t i = 0; i < collisions.size(); i++) {
+    found[collisions[i].first].push_back(collisions[i].second);
+  }
+  for (size_t i = 0; i < valid.size(); i++) {
+    string text;
+    for (size_t j = 0; j < valid[i]->hashes.size(); j++) {
+      const string& hash = valid[i]->hashes[j];
+      string lower = hash;
+      std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+      const vector<string>& words = found[lower];
+      if (words.empty()) text += hash + "\n";
+      for (size_t k = 0; k < words.size(); k++) {
+        text += hash + ":" + words[k] + "\n";
+      }
+    }
+    answer(valid[i], text);
+  }
+}
+
+HashFinder* Daemon::finder(const vector<string>& options,
+    const string& hash, string* error) {
+  const string kKey = key(options);
+  std::map<string, std::unique_ptr<Resident> >::iterator it =
+      _finders.find(kKey);
+  _lookups++;
+  if (it != _finders.end()) {
+    it->second->used = _lookups;
+    return it->second->hashfinder;
+  }
+
+  // an invalid job gets the reason, the daemon keeps running
+  vector<string> canonical;
+  if (canonicalize(options, &canonical)
+      && std::any_of(canonical.begin(), canonical.end(), isRefused)) {
+    *error = kRefusedReason;
+    return NULL;
+  }
+  std::unique_ptr<Resident> resident(new Resident());
+  resident->args = arguments(options, hash);
+  if (!parse(resident->args, resident->hashfinder, error)) {
+    // the first line says what is wrong (or starts the usage)
+    *error = error->substr(0, error->find('\n'));
+    return NULL;
+  }
+  if (!resident->hashfinder->isReusable()) {
+    *error = kRefusedReason;
+    return NULL;
+  }
+  if (!resident->hashfinder->readDictionary()) {
+    *error = "the dictionary cannot be read";
+    return NULL;
+  }
+  resident->hashfinder->printConfiguration();
+  // the batches run one after the other, so the search dropped is idle
+  if (_finders.size() >= _maxFinders) {
+    std::map<string, std::unique_ptr<Resident> >::iterator oldest =
+        _finders.begin();
+    for (it = _finders.begin(); it != _finders.end(); ++it) {
+      if (it->second->used < oldest->second->used) oldest = it;
+    }
+    _finders.erase(oldest);
+  }
+  resident->used = _lookups;
+  HashFinder* result = resident->hashfinder;
+  _finders[kKey] = std::move(resident);
+  return result;
+}
+
+string Daemon::key(const vector<string>& options) {
+  string result;
+  vector<string> canonical;
+  if (!canonicalize(options, &canonical)) {
+    // the jobs get the reason of the invalid options, they are kept as given
+    for (size_t i = 0; i < options.size(); i++) result += options[i] + " ";
+    return result;
+  }
+  // the last value of an option counts, like in the parser
+  std::map<string, string> byName;
+  for (size_t i = 0; i < canonical.size(); i++) {
+    if (isOneOf(canonical[i], kIgnored, kIgnoredCount)) continue;
+    byName[canonical[i].substr(0, canonical[i].find('='))] = canonical[i];
+  }
+  for (std::map<string, string>::iterator it = byName.begin();
+      it != byName.end(); ++it) {
+    result += it->second + " ";
+  }
+  return result;
+}
+
+vector<string> Daemon::arguments(const vector<string>& options,
+    const string& hash) {
+  vector<string> args;
+  args.push_back("HashFinderMain");
+  args.insert(args.end(), options.begin(), options.end());
+  args.push_back(hash);
+  return args;
+}
+
+bool Daemon::parse(const vector<string>& args, HashFinder* hashfinder,
+    string* error) {
+  vector<char*> argv = pointers(args);
+  return hashfinder->parseArguments(args.size(), &argv[0], error);
+}
+
+bool Daemon::canonicalize(const vector<string>& options,
+    vector<string>* result) {
+  vector<string> args(1, "HashFinderMain");
+  args.insert(args.end(), options.begin(), options.end());
+  vector<char*> argv = pointers(args);
+  return HashFinder::canonicalOptions(args.size(), &argv[0], result);
+}
+
+vector<char*> Daemon::pointers(const vector<string>& args) {
+  vector<char*> argv;
+  for (size_t i = 0; i < args.size(); i++) {
+    argv.push_back(const_cast<char*>(args[i].c_str()));
+  }
+  argv.push_back(NULL);
+  return argv;
+}
+
+void Daemon::runWorkers(std::function<void(unsigned)> task) {
+  std::unique_lock<std::mutex> lock(_poolMutex);
+  _task = task;
+  _busy = _workers.size();
+  _round++;
+  _poolWake.notify_all();
+  _poolDone.wait(lock, [&]() { return _busy == 0; });
+}
+
+void Daemon::work(unsigned threadnumber) {
+  uint64_t done = 0;
+  std::unique_lock<std::mutex> lock(_poolMutex);
+  while (true) {
+    _poolWake.wait(lock, [&]() { return _quit || _round != done; });
+    if (_quit) return;
+    done = _round;
+    std::function<void(unsigned)> task = _task;
+    lock.unlock();
+    task(threadnumber);
+    lock.lock();
+    if (--_busy == 0) _poolDone.notify_all();
+  }
+}
+
+void Daemon::answer(Job* job, const string& text) {
+  size_t sent = 0;
+  while (sent < text.size()) {
+    // a client which went away must not kill the daemon with SIGPIPE
+    ssize_t n = send(job->fd, text.data() + sent, text.size() - sent,
+        MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += n;
+  }
+  close(job->fd);
+}
+
+bool Daemon::submit(const char* path, const string& job, string* answer,
+    string* error) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    *error = "is too long for a socket path";
+    return false;
+  }
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+      sizeof(address)) != 0) {
+    if (fd >= 0) close(fd);
+    *error = "cannot be reached";
+    return false;
+  }
+  const string kLine = job + "\n";
+  bool sent = send(fd, kLine.data(), kLine.size(), MSG_NOSIGNAL)
+      == static_cast<ssize_t>(kLine.size());
+  answer->clear();
+  char buffer[4096];
+  ssize_t n;
+  while (sent && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+    answer->append(buffer, n);
+  }
+  close(fd);
+  if (!sent) *error = "cannot be reached";
+  return sent;
+}
@@ -0,0 +1,183 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_DAEMON_H_
+#define PROJEKT_DAEMON_H_
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "./HashFinder.h"
+
+using std::string;
+using std::vector;
+
+// Serves search jobs over a Unix domain socket, so many small jobs do not
+// pay for starting the program, mapping the dictionary and loading tables
+// or indexes every time.
+//
+// A job is one line: the options of the command line followed by one or
+// more hashes, separated by blanks. The daemon answers with one line per
+// hash, <hash>:<word> if it was found and <hash> alone if not, or a single
+// line "error: <reason>", and closes the connection.
+//
+// Jobs may read the files of their options (the dictionary, rules, a
+// table or an index) with the rights of the daemon, so the socket is only
+// open to the user of the daemon. They must not write files or take their
+// hashes from a file, see HashFinder::isReusable().
+//
+// Jobs are queued. All jobs waiting when a pass starts are batched by
+// their options, the candidate source, so a single pass over the
+// dictionary or the combinations answers all hashes of the batch. The
+// search of every candidate source stays resident for the next batches,
+// and the worker threads are started once.
+//
+// usage: 1) listen() on a socket path
+//        2) serve() until stop() is called from another thread
+//        and submit() jobs from a client
+class Daemon {
+ public:
+  Daemon();
+  ~Daemon();
+
+  // Bind the socket, a stale socket file is replaced. Returns false with
+  // the reason if this fails.
+  bool listen(const char* path, string* error);
+
+  // Accept jobs and answer them until stop().
+  void serve();
+  FRIEND_TEST(DaemonTest, serve);
+
+  // Stop serving, the jobs already accepted are answered first.
+  void stop();
+
+  // Send a job to the daemon at path and read its answer. Returns false
+  // with the reason if the daemon cannot be reached.
+  static bool submit(const char* path, const string& job, string* answer,
+      string* error);
+
+ private:
+  // time the first job of a batch waits for the jobs sent with it
+  static const int kBatchWindow = 20;
+  // seconds a client has to send its job
+  static const int kReadTimeout = 5;
+  // longest job line accepted
+  static const size_t kMaxJob = 1 << 16;
+  // searches kept resident, each may hold a dictionary, a table or an index
+  static const size_t kMaxFinders = 8;
+
+  // A search kept for the next batches, it points into its arguments. The
+  // search has members aligned to cache lines, which new does not do, so
+  // it gets memory of its own alignment.
+  struct Resident {
+    Resident();
+    ~Resident();
+    vector<string> args;
+    HashFinder* hashfinder;
+    // the lookup it was last used by, the least recently used one goes
+    uint64_t used;
+  };
+
+  struct Job {
+    int fd;
+    // the options decide the candidate source, the hashes are searched
+    vector<string> options;
+    vector<string> hashes;
+  };
+
+  // Read the job of a connection and queue it, runs in a thread of its own.
+  void receive(int fd);
+
+  // Read the line of a job from the connection, false if there is none
+  // within timeout seconds.
+  static bool readJob(int fd, int timeout, Job* job);
+
+  // Take the batches of jobs from the queue until stop().
+  void runJobs();
+
+  // Answer the jobs which all have the same options with one pass.
+  void runBatch(vector<Job>* jobs);
+
+  // The resident search for the options, created on the first job. NULL
+  // and the reason if the options are invalid.
+  HashFinder* finder(const vector<string>& options, const string& hash,
+      string* error);
+  FRIEND_TEST(DaemonTest, finder);
+
+  // The options as the key of their batch and of their search: by their
+  // long names in a fixed order and without the options which only change
+  // the speed or the output of a search, so e.g. "-i a.txt" and
+  // "--input-file=a.txt --status=0" share a search.
+  static string key(const vector<string>& options);
+
+  // The arguments of the command line for the options and the hash.
+  static vector<string> arguments(const vector<string>& options,
+      const string& hash);
+
+  // Parse the arguments into the search, they must outlive it. Returns
+  // false with the reason if they are invalid.
+  static bool parse(const vector<string>& args, HashFinder* hashfinder,
+      string* error);
+
+  // The options by their long names, see HashFinder::canonicalOptions().
+  static bool canonicalize(const vector<string>& options,
+      vector<string>* result);
+
+  // The argv of the arguments, ending with NULL.
+  static vector<char*> pointers(const vector<string>& args);
+
+  // Run task(threadnumber) on every worker and wait for all of them.
+  void runWorkers(std::function<void(unsigned)> task);
+  void work(unsigned threadnumber);
+
+  // Write the answer and close the connection.
+  static void answer(Job* job, const string& text);
+
+  int _socket;
+  string _path;
+  std::atomic<bool> _stopping;
+
+  // jobs accepted and not taken by a batch yet, and connections whose job
+  // is still being read
+  std::mutex _mutex;
+  std::condition_variable _queued;
+  vector<Job> _jobs;
+  unsigned _readers;
+  std::thread _runner;
+
+  // the searches by the key of their options, at most _maxFinders
+  std::map<string, std::unique_ptr<Resident> > _finders;
+  size_t _maxFinders;
+  uint64_t _lookups;
+
+  // milliseconds of the batch window, seconds of the read timeout, and the
+  // passes run so far (read by the tests while serving)
+  int _batchWindow;
+  int _readTimeout;
+  std::atomic<uint64_t> _passes;
+
+  // a batch is only taken once this many jobs are queued (or on stop()),
+  // so the tests decide which jobs share a pass instead of the window
+  size_t _holdUntil;
+
+  // the workers wait for the next task, a new round number starts it
+  vector<std::thread> _workers;
+  std::mutex _poolMutex;
+  std::condition_variable _poolWake;
+  std::condition_variable _poolDone;
+  std::function<void(unsigned)> _task;
+  uint64_t _round;
+  unsigned _busy;
+  bool _quit;
+};
+
+#endif  // PROJEKT_DAEMON_H_
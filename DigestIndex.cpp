@@ -0,0 +1,157 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include "./DigestIndex.h"
+
+// The start of an index file, followed by the records.
+struct DigestIndex::Header {
+  char magic[8];
+  uint64_t md5;
+  uint64_t dictionarySize;
+  uint64_t records;
+};
+
+static const char kMagic[8] = { 'H', 'F', 'D', 'I', 'N', 'D', 'X', '1' };
+
+// interpolation steps before a lookup falls back to binary search
+static const unsigned kInterpolationSteps = 32;
+
+// Constructor, an empty index
+DigestIndex::DigestIndex() : _md5(true), _dictionarySize(0), _data(NULL),
+    _size(0), _records(NULL), _nRecords(0) {
+}
+
+// Destructor
+DigestIndex::~DigestIndex() {
+  unmap();
+}
+
+void DigestIndex::start(bool md5, uint64_t dictionarySize) {
+  unmap();
+  _md5 = md5;
+  _dictionarySize = dictionarySize;
+  _building.clear();
+  _nRecords = 0;
+}
+
+void DigestIndex::add(const vector<Record>& records) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _building.insert(_building.end(), records.begin(), records.end());
+}
+
+bool DigestIndex::save(const char* fileName, string* error) {
+  std::sort(_building.begin(), _building.end(),
+      [](const Record& a, const Record& b) {
+    return a.prefix < b.prefix || (a.prefix == b.prefix
+        && a.offset < b.offset);
+  });
+  _nRecords = _building.size();
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.md5 = _md5;
+  header.dictionarySize = _dictionarySize;
+  header.records = _nRecords;
+
+  FILE* file = fopen(fileName, "wb");
+  if (file == NULL) {
+    *error = "cannot be written";
+    return false;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+      && (_building.empty() || fwrite(&_building[0], sizeof(Record),
+      _building.size(), file) == _building.size());
+  if (fclose(file) != 0) written = false;
+  if (!written) *error = "cannot be written";
+  return written;
+}
+
+bool DigestIndex::load(const char* fileName, string* error) {
+  start(true, 0);
+  int fd = ::open(fileName, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    if (fd >= 0) ::close(fd);
+    *error = "cannot be read";
+    return false;
+  }
+  if (static_cast<size_t>(info.st_size) < sizeof(Header)) {
+    ::close(fd);
+    *error = "is no digest index";
+    return false;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid without the file descriptor
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    *error = "cannot be mapped";
+    return false;
+  }
+  _data = data;
+  _size = info.st_size;
+
+  Header header;
+  memcpy(&header, _data, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || _size != sizeof(Header) + header.records * sizeof(Record)) {
+    unmap();
+    *error = "is no digest index or it is damaged";
+    return false;
+  }
+  _md5 = header.md5 != 0;
+  _dictionarySize = header.dictionarySize;
+  _records = reinterpret_cast<const Record*>(
+      static_cast<const char*>(_data) + sizeof(Header));
+  _nRecords = header.records;
+  // every lookup reads a few records somewhere in the file
+  madvise(_data, _size, MADV_RANDOM);
+  return true;
+}
+
+void DigestIndex::unmap() {
+  if (_data != NULL) munmap(_data, _size);
+  _data = NULL;
+  _size = 0;
+  _records = NULL;
+  _nRecords = 0;
+}
+
+uint64_t DigestIndex::lowerBound(uint64_t prefix) const {
+  // the result is in [low, high]: records before low are smaller than the
+  // prefix, the record at high (if any) is not
+  uint64_t low = 0;
+  uint64_t high = _nRecords;
+  for (unsigned step = 0; step < kInterpolationSteps && high - low > 8;
+      step++) {
+    const uint64_t kFirst = _records[low].prefix;
+    const uint64_t kLast = _records[high - 1].prefix;
+    if (kFirst >= prefix) return low;
+    if (kLast < prefix) return high;
+    // where the prefix would be if the prefixes were evenly spread
+    const uint64_t kGuess = low + static_cast<uint64_t>(
+        static_cast<unsigned __int128>(prefix - kFirst) * (high - 1 - low)
+        / (kLast - kFirst));
+    if (_records[kGuess].prefix < prefix) {
+      low = kGuess + 1;
+    } else {
+      high = kGuess;
+    }
+  }
+  return std::lower_bound(_records + low, _records + high, prefix,
+      [](const Record& r, uint64_t p) { return r.prefix < p; }) - _records;
+}
+
+void DigestIndex::find(uint64_t prefix, vector<uint64_t>* offsets) const {
+  for (uint64_t i = lowerBound(prefix);
+      i < _nRecords && _records[i].prefix == prefix; i++) {
+    offsets->push_back(_records[i].offset);
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_DIGESTINDEX_H_
+#define PROJEKT_DIGESTINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// The MD5 or SHA-1 digests of all words of a dictionary, hashed once and
+// looked up by every later search. A record holds the first 64 bits of a
+// digest and the byte offset of its word in the dictionary, the records
+// are sorted by the digest bits. The digests are uniformly distributed, so
+// a lookup interpolates the position of a prefix and needs only a few
+// reads even in a file of billions of records.
+//
+// The prefix only finds candidates: the words at the offsets are hashed
+// again and compared with the whole digest, so a changed dictionary never
+// gives a wrong word.
+//
+// usage: 1) start() an index of a dictionary, add() the records from any
+//           thread and save() it
+//        or 2) load() a file and find() the offsets of a digest
+class DigestIndex {
+ public:
+  struct Record {
+    uint64_t prefix;
+    uint64_t offset;
+  };
+
+  DigestIndex();
+  ~DigestIndex();
+
+  // the first 64 bits of a digest as they are sorted in the index
+  static uint64_t prefix(const uint32_t* digest) {
+    return static_cast<uint64_t>(digest[0]) << 32 | digest[1];
+  }
+
+  // Start building the index of a dictionary with this many bytes.
+  void start(bool md5, uint64_t dictionarySize);
+
+  // Append records of the dictionary, thread-safe.
+  void add(const vector<Record>& records);
+
+  // Sort the records and write the index. Returns false with the reason if
+  // it cannot be written.
+  bool save(const char* fileName, string* error);
+
+  // Map an index file. Returns false with the reason if it is no index.
+  bool load(const char* fileName, string* error);
+
+  // the algorithm, the size of the dictionary and the number of records
+  bool md5() const { return _md5; }
+  uint64_t dictionarySize() const { return _dictionarySize; }
+  uint64_t size() const { return _nRecords; }
+
+  // Append the offsets of the words whose digest starts with prefix.
+  void find(uint64_t prefix, vector<uint64_t>* offsets) const;
+
+ private:
+  struct Header;
+
+  // index of the first record with at least this prefix
+  uint64_t lowerBound(uint64_t prefix) const;
+
+  void unmap();
+
+  bool _md5;
+  uint64_t _dictionarySize;
+
+  // the records while building
+  std::mutex _mutex;
+  vector<Record> _building;
+
+  // the records of a loaded index in the mapped file
+  void* _data;
+  size_t _size;
+  const Record* _records;
+  uint64_t _nRecords;
+};
+
+#endif  // PROJEKT_DIGESTINDEX_H_
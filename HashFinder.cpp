@@ -4,59 +4,238 @@
 
 #include <unistd.h>
 #include <getopt.h>
+#include <stdarg.h>
 #include <stdio.h>
-#include <math.h>
 
 // This define is needed to make the code portable
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <sys/time.h>  // for time measurement
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <string>
+#include <thread>
+#include "./algorithms/CpuFeatures.h"
 #include "./algorithms/MD5.h"
+#include "./algorithms/MD5Simd.h"
+#include "./algorithms/SHA1Simd.h"
 #include "./algorithms/SHA1.h"
+#include "./CandidateGenerator.h"
 #include "./HashFinder.h"
 
+// The usage, printf it with the checkpoint interval and the default chains
+static const char kUsage[] =
+    "Usage: ./HashFinderMain [options] <hashToFind>\n"
+    "       ./HashFinderMain [options] --hash-file=<file>\n"
+    "       ./HashFinderMain [options] --generate-table=<file>\n"
+    "       ./HashFinderMain [options] -i <dictionary> "
+    "--build-index=<file>\n"
+    "       ./HashFinderMain --daemon=<socket>\n"
+    "       ./HashFinderMain --submit=<socket> [options] <hash>...\n"
+    "Options:\n"
+    " -i, --input-file: read words from a dictionary file\n"
+    " -a, --min-length: minimal length of the generated combinations\n"
+    "                   Default: 8\n"
+    " -z, --max-length: maximum length of the generated combinations\n"
+    "                   Default: 8\n"
+    " -c, --characters: chars used to generate combinations\n"
+    "                   Default: abcdefghijklmnopqrstuvwxyz0123456789\n"
+    " -h, --hash-algo : can either be sha-1 or md5\n"
+    "                   Default: md5\n"
+    " -k, --kernel    : scalar, sse2, avx2, avx512 or sha-ni (SHA-1)\n"
+    "                   Default: the fastest one the CPU supports\n"
+    " -f, --hash-file : search all hashes of a file, one per line\n"
+    " -A, --find-all  : report every matching word and search the\n"
+    "                   whole keyspace\n"
+    " -s, --stream    : read the dictionary while hashing instead of\n"
+    "                   mapping it, - as input file is stdin\n"
+    " -m, --mask      : characters for every position, e.g. ?u?l?l?d?d\n"
+    "                   ?l ?u ?d ?s ?a ?h ?H built-in, ?1 - ?4 custom\n"
+    " -1 - -4, --charset1 - --charset4: the custom charsets of a mask\n"
+    " -r, --rules     : apply every rule of the file to every word of\n"
+    "                   the dictionary\n"
+    " -S, --status    : seconds between two status lines, 0 for none\n"
+    "                   Default: 10\n"
+    " -J, --status-json: append the status as JSON lines to a file\n"
+    " -C, --checkpoint: save the progress to a file every %d s\n"
+    " -R, --restore   : continue the search saved in a checkpoint\n"
+    "                   file and keep saving to it\n"
+    " -x, --shard     : search part i of n of the keyspace, e.g. 2/8\n"
+    " -o, --skip      : skip the first candidates (dictionary: bytes)\n"
+    " -l, --limit     : search at most this many candidates after\n"
+    "                   them, --shard splits what is left\n"
+    " -G, --generate-table: build a rainbow table of the combinations\n"
+    " -N, --chains    : chains of the table, chain i starts at\n"
+    "                   combination i\n"
+    "                   Default: the combinations, at most %u\n"
+    " -L, --chain-length: columns of every chain\n"
+    "                   Default: 1000\n"
+    " -T, --table     : look the hashes up in a rainbow table, it\n"
+    "                   decides the characters and the lengths\n"
+    " -I, --build-index: hash every word of the dictionary once and\n"
+    "                   save the digests to a file\n"
+    " -X, --index     : look the hashes up in the index of the\n"
+    "                   dictionary instead of hashing it\n";
+
+// Format the message of an invalid argument into error, returns false
+static bool fail(string* error, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  char buffer[4096];
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  *error = buffer;
+  return false;
+}
+
 // Constructor without arguments
-HashFinder::HashFinder() {
+HashFinder::HashFinder() : _statusJson(NULL) {
   reset();
 }
 
 // Set the default values
 void HashFinder::reset() {
   _collision = NULL;
+  _stop = false;
+  _findAll = false;
+  _reporting = true;
+  // results of an earlier search refer to targets which are gone now
+  Result result;
+  while (_resultQueue.pop(&result)) {}
+  _results.clear();
   _inputFileName = NULL;
   _hashToFind = NULL;
+  _hashFileName = NULL;
+  _mappedDictionary.close();
+  _targets.clear(4);
   _minLength = 8;
   _maxLength = 8;
   _allowedCharacters = "abcdefghijklmnopqrstuvwxyz0123456789";
+  _maskString = NULL;
+  _rulesFileName = NULL;
+  _rules.clear();
+  _rejectedWords = 0;
+  for (unsigned i = 0; i < Mask::kCustomCharsets; i++) {
+    _customCharsets[i] = NULL;
+  }
   _md5 = true;
-  _dictionary.clear();
+  _kernel = MD5Simd::best();
+  _sha1Kernel = SHA1Simd::best();
+  _kernelSelected = false;
+  _stream = false;
+  _wordStream.close();
+  _statusInterval = 10;
+  _statusJsonFileName = NULL;
+  if (_statusJson != NULL) fclose(_statusJson);
+  _statusJson = NULL;
+  _checkpointFileName = NULL;
+  _restoreFileName = NULL;
+  _shard = 1;
+  _shards = 1;
+  _skip = 0;
+  _limit = ~static_cast<uint128_t>(0);
+  _pin = false;
+  _noSmt = false;
+  _replicas.reset();
+  _generateTableName = NULL;
+  _tableFileName = NULL;
+  _chainCount = 0;
+  _chainLength = 1000;
+  _chains.clear();
+  _buildIndexName = NULL;
+  _indexFileName = NULL;
 }
 
 // Deconstructor
 HashFinder::~HashFinder() {
-  delete[] _collision;
+  delete[] _collision.load();
+  if (_statusJson != NULL) fclose(_statusJson);
   _inputFileName = NULL;
   _hashToFind = NULL;
   _allowedCharacters = NULL;
-  _dictionary.clear();
 }
 
+// The options of the command line, the short ones have the same letters
+static const struct option kOptions[] = {
+  { "input-file", 1, NULL, 'i' },
+  { "min-length", 1, NULL, 'a' },
+  { "max-length", 1, NULL, 'z' },
+  { "characters", 1, NULL, 'c' },
+  { "hash-algo", 1, NULL, 'h' },
+  { "kernel", 1, NULL, 'k' },
+  { "hash-file", 1, NULL, 'f' },
+  { "find-all", 0, NULL, 'A' },
+  { "stream", 0, NULL, 's' },
+  { "mask", 1, NULL, 'm' },
+  { "rules", 1, NULL, 'r' },
+  { "charset1", 1, NULL, '1' },
+  { "charset2", 1, NULL, '2' },
+  { "charset3", 1, NULL, '3' },
+  { "charset4", 1, NULL, '4' },
+  { "status", 1, NULL, 'S' },
+  { "status-json", 1, NULL, 'J' },
+  { "checkpoint", 1, NULL, 'C' },
+  { "restore", 1, NULL, 'R' },
+  { "shard", 1, NULL, 'x' },
+  { "skip", 1, NULL, 'o' },
+  { "limit", 1, NULL, 'l' },
+  { "pin", 0, NULL, 'p' },
+  { "no-smt", 0, NULL, 'n' },
+  { "generate-table", 1, NULL, 'G' },
+  { "chains", 1, NULL, 'N' },
+  { "chain-length", 1, NULL, 'L' },
+  { "table", 1, NULL, 'T' },
+  { "build-index", 1, NULL, 'I' },
+  { "index", 1, NULL, 'X' },
+  { NULL, 0, NULL, 0 }
+};
+static const char kShortOptions[] =
+    "i:a:z:c:h:k:f:Asm:1:2:3:4:r:S:J:C:R:x:o:l:pnG:N:L:T:I:X:";
+
 void HashFinder::parseCommandLineArguments(int argc, char** argv) {
+  string error;
+  if (!parseArguments(argc, argv, &error)) {
+    fprintf(stderr, "%s", error.c_str());
+    exit(1);
+  }
+}
+
+bool HashFinder::canonicalOptions(int argc, char** argv,
+    vector<string>* result) {
+  result->clear();
+  // the problems are reported when the arguments are parsed
+  const int kReportErrors = opterr;
+  opterr = 0;
+  optind = 1;
+  while (true) {
+    int c = getopt_long(argc, argv, kShortOptions, kOptions, NULL);
+    if (c == -1) break;
+    const struct option* option = kOptions;
+    while (option->name != NULL && option->val != c) option++;
+    if (option->name == NULL) {
+      opterr = kReportErrors;
+      return false;
+    }
+    result->push_back(option->name);
+    if (option->has_arg) result->back() += string("=") + optarg;
+  }
+  opterr = kReportErrors;
+  // the hashes or other words not belonging to an option
+  for (int i = optind; i < argc; i++) result->push_back(argv[i]);
+  return true;
+}
+
+bool HashFinder::parseArguments(int argc, char** argv, string* error) {
+  delete[] _collision.load();
   reset();
-  struct option options[] = {
-    { "input-file", 1, NULL, 'i' },
-    { "min-length", 1, NULL, 'a' },
-    { "max-length", 1, NULL, 'z' },
-    { "characters", 1, NULL, 'c' },
-    { "hash-algo", 1, NULL, 'h' },
-    { NULL, 0, NULL, 0 }
-  };
+  // the kernel names depend on the algorithm, resolved after all options
+  const char* kernelName = NULL;
   optind = 1;
   while (true) {
-    char c = getopt_long(argc, argv, "i:a:z:c:h:", options, NULL);
+    char c = getopt_long(argc, argv, kShortOptions, kOptions, NULL);
     if (c == -1) break;
     switch (c) {
       case 'i':
@@ -68,8 +247,7 @@ void HashFinder::parseCommandLineArguments(int argc, char** argv) {
         } else {
           _minLength = atoi(optarg);
           if ( _minLength <= 0 ) {
-            fprintf(stderr, "<min-length> must be greater than 0.\n");
-            exit(1);
+            return fail(error, "<min-length> must be greater than 0.\n");
           }
         }
         break;
@@ -79,8 +257,7 @@ void HashFinder::parseCommandLineArguments(int argc, char** argv) {
         } else {
           _maxLength = atoi(optarg);
           if ( _maxLength <= 0 ) {
-            fprintf(stderr, "<max-length> must be greater than 0.\n");
-            exit(1);
+            return fail(error, "<max-length> must be greater than 0.\n");
           }
         }
         break;
@@ -91,6 +268,98 @@ void HashFinder::parseCommandLineArguments(int argc, char** argv) {
           _allowedCharacters = optarg;
         }
         break;
+      case 'k':
+        kernelName = optarg;
+        break;
+      case 'f':
+        _hashFileName = optarg;
+        break;
+      case 'A':
+        _findAll = true;
+        break;
+      case 's':
+        _stream = true;
+        break;
+      case 'm':
+        _maskString = optarg;
+        break;
+      case 'r':
+        _rulesFileName = optarg;
+        break;
+      case 'S':
+        _statusInterval = atoi(optarg);
+        if (_statusInterval < 0) {
+          return fail(error, "<status> must not be negative.\n");
+        }
+        break;
+      case 'J':
+        _statusJsonFileName = optarg;
+        break;
+      case 'C':
+        _checkpointFileName = optarg;
+        break;
+      case 'R':
+        _restoreFileName = optarg;
+        break;
+      case 'p':
+        _pin = true;
+        break;
+      case 'n':
+        _noSmt = true;
+        break;
+      case 'G':
+        _generateTableName = optarg;
+        break;
+      case 'T':
+        _tableFileName = optarg;
+        break;
+      case 'I':
+        _buildIndexName = optarg;
+        break;
+      case 'X':
+        _indexFileName = optarg;
+        break;
+      case 'N': {
+        uint128_t chains;
+        if (!parseCount(optarg, &chains) || chains == 0
+            || chains > UINT32_MAX) {
+          return fail(error, "<chains> must be greater than 0 and less than "
+              "2^32.\n");
+        }
+        _chainCount = chains;
+        break;
+      }
+      case 'L':
+        _chainLength = atoi(optarg);
+        if (atoi(optarg) <= 0) {
+          return fail(error, "<chain-length> must be greater than 0.\n");
+        }
+        break;
+      case 'x': {
+        int end = 0;
+        if (sscanf(optarg, "%" SCNu64 "/%" SCNu64 "%n", &_shard, &_shards,
+            &end) != 2 || optarg[end] != '\0' || _shard == 0
+            || _shard > _shards) {
+          return fail(error, "<shard> must be i/n with 1 <= i <= n.\n");
+        }
+        break;
+      }
+      case 'o':
+        if (!parseCount(optarg, &_skip)) {
+          return fail(error, "<skip> must be a number.\n");
+        }
+        break;
+      case 'l':
+        if (!parseCount(optarg, &_limit) || _limit == 0) {
+          return fail(error, "<limit> must be greater than 0.\n");
+        }
+        break;
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+        _customCharsets[c - '1'] = optarg;
+        break;
       case 'h':
         char test1[] = "sha1";
         char test2[] = "sha-1";
@@ -102,74 +371,478 @@ void HashFinder::parseCommandLineArguments(int argc, char** argv) {
         break;
     }
   }
-  if (optind + 1 != argc) printUsageAndExit();
-  _hashToFind = argv[optind];
+  // the hash can only be omitted if the hashes come from a file or a
+  // table or an index is built
+  const bool kBuilding = _generateTableName != NULL
+      || _buildIndexName != NULL;
+  if (optind + 1 == argc) {
+    _hashToFind = argv[optind];
+  } else if (optind != argc || (_hashFileName == NULL && !kBuilding)) {
+    return fail(error, kUsage, kCheckpointInterval,
+        static_cast<unsigned>(kDefaultChains));
+  }
+  if (kBuilding && (_hashToFind != NULL || _hashFileName != NULL)) {
+    fprintf(stderr, "<hashToFind> will be ignored, building a %s.\n",
+        _buildIndexName != NULL ? "digest index" : "rainbow table");
+    _hashToFind = NULL;
+    _hashFileName = NULL;
+  }
+
+  // verify the kernel exists for the algorithm and runs on this CPU
+  if (kernelName != NULL) {
+    bool supported;
+    if (_md5) {
+      if (!MD5Simd::parseKernel(kernelName, &_kernel)) {
+        return fail(error, "<kernel> must be scalar, sse2, avx2 or avx512.\n");
+      }
+      supported = MD5Simd::supported(_kernel);
+    } else {
+      if (!SHA1Simd::parseKernel(kernelName, &_sha1Kernel)) {
+        return fail(error, "<kernel> must be scalar, sse2, avx2, avx512 or "
+            "sha-ni.\n");
+      }
+      supported = SHA1Simd::supported(_sha1Kernel);
+    }
+    if (!supported) {
+      return fail(error, "<kernel> %s is not supported by this CPU.\n",
+          kernelName);
+    }
+    _kernelSelected = true;
+  }
+
+  // the mask decides the characters and the length
+  if (_maskString != NULL && _inputFileName != NULL) {
+    fprintf(stderr, "<mask> will be ignored, using dictionary.\n");
+    _maskString = NULL;
+  }
+  if (_maskString != NULL) {
+    string reason;
+    if (!_mask.parse(_maskString, _customCharsets, &reason)) {
+      return fail(error, "<mask> is invalid: %s.\n", reason.c_str());
+    }
+    if (_mask.length() > CandidateGenerator::kMaxLength) {
+      return fail(error, "<mask> must not be longer than %u.\n",
+          CandidateGenerator::kMaxLength);
+    }
+    _minLength = _mask.length();
+    _maxLength = _mask.length();
+  }
+
+  // rules mangle the words of a dictionary
+  if (_rulesFileName != NULL) {
+    string reason;
+    if (_inputFileName == NULL) {
+      fprintf(stderr, "<rules> will be ignored, using combinations.\n");
+    } else if (!_rules.read(_rulesFileName, &reason)) {
+      return fail(error, "<rules> %s.\n", reason.c_str());
+    }
+  }
+
+  // monitoring tails the file, so it is appended to and never truncated
+  if (_statusJsonFileName != NULL) {
+    _statusJson = fopen(_statusJsonFileName, "a");
+    if (_statusJson == NULL) {
+      return fail(error, "<status-json> %s cannot be written.\n",
+          _statusJsonFileName);
+    }
+  }
+
+  // a restored search goes on saving where it came from
+  if (_restoreFileName != NULL && _checkpointFileName == NULL) {
+    _checkpointFileName = _restoreFileName;
+  }
+  if (_checkpointFileName != NULL && _stream) {
+    return fail(error, "<checkpoint> cannot be used with a streamed "
+        "dictionary.\n");
+  }
+  if (isPartial() && _stream) {
+    return fail(error, "<shard> cannot be used with a streamed dictionary.\n");
+  }
 
   // verify min-length is not greater than max-length
   if (_minLength > _maxLength) _minLength = _maxLength;
 
-  // verify length of the hash to find
-  if (_md5) {
-    if (strlen(_hashToFind) != 32) {
-      fprintf(stderr, "<hashToFind> must be a hex string with length = 32.\n");
-      exit(1);
+  // a rainbow table only covers combinations of its characters
+  if (useTable() && !setupTable(error)) return false;
+
+  // a digest index only covers the words of its dictionary
+  if (useIndex() && !setupIndex(error)) return false;
+
+  // every combination has to fit into a single message block
+  if (_maxLength > static_cast<int>(CandidateGenerator::kMaxLength)) {
+    return fail(error, "<max-length> must not be greater than %u.\n",
+        CandidateGenerator::kMaxLength);
+  }
+
+  // the hex strings are only needed for printing, compare binary digests
+  _targets.clear(_md5 ? 4 : 5);
+  if (_hashToFind != NULL && !addTarget(_hashToFind)) {
+    return fail(error, "<hashToFind> must be a hex string with length = %u.\n",
+        _md5 ? 32 : 40);
+  }
+  if (_hashFileName != NULL && !readHashFile(error)) return false;
+  _targets.build();
+  if (_targets.size() == 0 && !kBuilding) {
+    return fail(error, "<hash-file> does not contain any hash.\n");
+  }
+
+  // one worker per CPU we may use, pinned workers of a multi-socket host
+  // get a copy of the targets and the dictionary on their own node
+  _topology.detect();
+  _workers = _topology.workers(_noSmt);
+  if (_pin && _topology.nodes() > 1) {
+    _replicas.reset(new NodeReplica[_topology.nodes()]);
+  }
+  return planWork(error);
+}
+
+bool HashFinder::setupTable(string* error) {
+  if (_generateTableName != NULL && _tableFileName != NULL) {
+    return fail(error, "<table> cannot be used while generating a table.\n");
+  }
+  if (_inputFileName != NULL || _maskString != NULL) {
+    return fail(error, "<table> only works with --characters, not with a "
+        "dictionary or a mask.\n");
+  }
+  if (_checkpointFileName != NULL || isPartial()) {
+    return fail(error, "<table> cannot be used with a checkpoint or a "
+        "shard.\n");
+  }
+  string reason;
+  if (_tableFileName != NULL) {
+    if (!_table.load(_tableFileName, &reason)) {
+      return fail(error, "<table> %s %s.\n", _tableFileName, reason.c_str());
     }
-  } else {
-    if (strlen(_hashToFind) != 40) {
-      fprintf(stderr, "<hashToFind> must be a hex string with length = 40.\n");
-      exit(1);
+    if (_table.md5() != _md5) {
+      return fail(error, "<table> %s is a table of %s.\n", _tableFileName,
+          _table.md5() ? "MD5" : "SHA-1");
     }
+    // the table knows the keyspace it covers
+    _allowedCharacters = _table.characters().c_str();
+    _minLength = _table.minLength();
+    _maxLength = _table.maxLength();
+    return true;
+  }
+  if (_maxLength > static_cast<int>(CandidateGenerator::kMaxLength)) {
+    return fail(error, "<max-length> must not be greater than %u.\n",
+        CandidateGenerator::kMaxLength);
+  }
+  if (_allowedCharacters[0] == '\0') {
+    return fail(error, "<characters> must not be empty.\n");
+  }
+  if (!_table.init(_md5, _allowedCharacters, _minLength, _maxLength,
+      _chainLength)) {
+    return fail(error, "<generate-table> must have less than 2^%u "
+        "combinations.\n", RainbowTable::kMaxKeyspaceBits);
+  }
+  if (_chainCount == 0) {
+    _chainCount = std::min(_table.keyspace(), kDefaultChains);
+  }
+  // chain i starts at combination i
+  if (_chainCount > _table.keyspace()) {
+    return fail(error, "<chains> must not be more than the %" PRIu64
+        " combinations.\n", _table.keyspace());
+  }
+  _chains.assign(_chainCount, RainbowTable::Chain());
+  return true;
+}
+
+bool HashFinder::setupIndex(string* error) {
+  if (_buildIndexName != NULL && _indexFileName != NULL) {
+    return fail(error, "<index> cannot be used while building an index.\n");
+  }
+  if (_inputFileName == NULL) {
+    return fail(error, "<index> needs the dictionary (--input-file).\n");
+  }
+  if (_stream || _rules.size() > 0 || _checkpointFileName != NULL
+      || isPartial()) {
+    return fail(error, "<index> cannot be used with a streamed dictionary, "
+        "rules, a checkpoint or a shard.\n");
+  }
+  if (_indexFileName == NULL) return true;
+  string reason;
+  if (!_index.load(_indexFileName, &reason)) {
+    return fail(error, "<index> %s %s.\n", _indexFileName, reason.c_str());
+  }
+  if (_index.md5() != _md5) {
+    return fail(error, "<index> %s is an index of %s.\n", _indexFileName,
+        _index.md5() ? "MD5" : "SHA-1");
+  }
+  return true;
+}
+
+bool HashFinder::addTarget(const char* hex) {
+  uint32_t digest[5];
+  if (strlen(hex) != (_md5 ? 32u : 40u)) return false;
+  if (!parseDigest(hex, _md5, digest)) return false;
+  _targets.add(digest);
+  return true;
+}
+
+bool HashFinder::readHashFile(string* error) {
+  std::ifstream hashFile(_hashFileName, std::ios_base::in);
+  if (!hashFile.is_open()) {
+    return fail(error, "<hash-file> %s cannot be read.\n", _hashFileName);
+  }
+  std::string line;
+  unsigned lineNumber = 0;
+  while (getline(hashFile, line)) {
+    lineNumber++;
+    // tolerate files with windows line endings and trailing blanks
+    size_t end = line.find_last_not_of(" \t\r");
+    if (end == std::string::npos) continue;
+    line.erase(end + 1);
+    if (!addTarget(line.c_str())) {
+      return fail(error, "<hash-file> line %u must be a hex string with "
+          "length = %u.\n", lineNumber, _md5 ? 32 : 40);
+    }
+  }
+  return true;
+}
+
+// Convert the decimal string into a count
+bool HashFinder::parseCount(const char* decimal, uint128_t* count) {
+  const uint128_t kMax = ~static_cast<uint128_t>(0);
+  *count = 0;
+  if (*decimal == '\0') return false;
+  for (; *decimal != '\0'; decimal++) {
+    if (*decimal < '0' || *decimal > '9') return false;
+    const unsigned kDigit = *decimal - '0';
+    if (*count > (kMax - kDigit) / 10) return false;
+    *count = *count * 10 + kDigit;
   }
+  return true;
+}
+
+// Convert the hex string into state words
+bool HashFinder::parseDigest(const char* hex, bool md5, uint32_t* digest) {
+  const unsigned kWords = md5 ? 4 : 5;
+  for (unsigned i = 0; i < kWords; i++) {
+    digest[i] = 0;
+    for (unsigned j = 0; j < 8; j++) {
+      char c = hex[i * 8 + j];
+      uint32_t nibble;
+      if (c >= '0' && c <= '9') {
+        nibble = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        nibble = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        nibble = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      if (md5) {
+        // MD5 writes its state words byte by byte in little endian order
+        digest[i] |= nibble << ((j ^ 1) * 4);
+      } else {
+        digest[i] = (digest[i] << 4) | nibble;
+      }
+    }
+  }
+  return true;
+}
+
+// Inverse of parseDigest
+string HashFinder::formatDigest(const uint32_t* digest, bool md5) {
+  static const char kHex[] = "0123456789abcdef";
+  const unsigned kWords = md5 ? 4 : 5;
+  string hex(kWords * 8, '0');
+  for (unsigned i = 0; i < kWords; i++) {
+    for (unsigned j = 0; j < 8; j++) {
+      unsigned shift = md5 ? (j ^ 1) * 4 : (7 - j) * 4;
+      hex[i * 8 + j] = kHex[(digest[i] >> shift) & 15];
+    }
+  }
+  return hex;
 }
 
 // Read the dictionary file into our vector
 bool HashFinder::readDictionary() {
   if (_inputFileName == NULL) return true;
 
-  // first empty the dictionary vector
-  _dictionary.clear();
+  // regular files are mapped, everything else (e.g. a pipe) is streamed
+  if (!_stream && _mappedDictionary.open(_inputFileName)) {
+    if (_indexFileName != NULL
+        && _index.dictionarySize() != _mappedDictionary.size()) {
+      fprintf(stderr, "<index> %s is the index of another dictionary.\n",
+          _indexFileName);
+      return false;
+    }
+    if (_buildIndexName != NULL) {
+      _index.start(_md5, _mappedDictionary.size());
+    }
+    string error;
+    if (!planWork(&error)) {
+      fprintf(stderr, "%s", error.c_str());
+      return false;
+    }
+    return true;
+  }
+  // the offsets of an index are bytes of the mapped file
+  if (useIndex()) {
+    fprintf(stderr, "<index> %s cannot be mapped.\n", _inputFileName);
+    return false;
+  }
+  // a streamed dictionary has no known size, so it cannot be split
+  if (isPartial()) {
+    fprintf(stderr, "<shard> %s cannot be mapped and split.\n",
+        _inputFileName);
+    return false;
+  }
+  // and it has no chunks to restore
+  if (_checkpointFileName != NULL) {
+    fprintf(stderr, "<checkpoint> will be ignored, %s cannot be mapped.\n",
+        _inputFileName);
+    _checkpointFileName = NULL;
+    _restoreFileName = NULL;
+  }
+  _stats.start(0);
+  return _wordStream.open(_inputFileName);
+}
+
+// Split the dictionary or the combinations of every length into chunks
+bool HashFinder::planWork(string* error) {
+  vector<uint64_t> segments;
+  uint64_t chunkSize = kMappedChunk;
+  if (_generateTableName != NULL) {
+    segments.push_back(_chainCount);
+    chunkSize = kChainChunk;
+  } else if (_tableFileName != NULL) {
+    // one item looks for one target in one block of columns
+    segments.push_back(_targets.size() * columnBlocks());
+    chunkSize = 1;
+  } else if (_indexFileName != NULL && _mappedDictionary.isOpen()) {
+    // one item looks up one target
+    segments.push_back(_targets.size());
+    chunkSize = 1;
+  } else if (_mappedDictionary.isOpen()) {
+    segments.push_back(_mappedDictionary.size());
+  } else if (_inputFileName == NULL) {
+    for (int wlen = _minLength; wlen <= _maxLength; wlen++) {
+      const uint64_t kKeyspace = generator(wlen).keyspace();
+      if (kKeyspace == CandidateGenerator::kOverflow) {
+        return fail(error, "<max-length> %d has 2^64 or more combinations.\n",
+            wlen);
+      }
+      segments.push_back(kKeyspace);
+    }
+    chunkSize = kCombinationChunk;
+  }
+  // the same integer range on every machine, no doubles involved
+  _keyspace = Scheduler::total(segments);
+  _rangeBegin = std::min(_skip, _keyspace);
+  _rangeEnd = _rangeBegin + std::min(_limit, _keyspace - _rangeBegin);
+  Scheduler::shard(_shard, _shards, &_rangeBegin, &_rangeEnd);
+  if (_rangeEnd - _rangeBegin > UINT64_MAX) {
+    return fail(error, "<shard> must have less than 2^64 candidates, use more "
+        "shards or a limit.\n");
+  }
+  _scheduler.plan(segments, chunkSize, _rangeBegin, _rangeEnd);
+  _checkpoint.start(describeSearch());
+  // a dictionary is planned again once it is mapped
+  uint64_t restored = 0;
+  if (_checkpointFileName != NULL
+      && (_inputFileName == NULL || _mappedDictionary.isOpen())) {
+    string reason;
+    if (_restoreFileName != NULL
+        && !_checkpoint.load(_restoreFileName, &reason)) {
+      return fail(error, "<restore> %s %s.\n", _restoreFileName,
+          reason.c_str());
+    }
+    restored = _scheduler.restore(_checkpoint.first(), _checkpoint.done());
+    if (!_checkpoint.save(_checkpointFileName)) {
+      return fail(error, "<checkpoint> %s cannot be written.\n",
+          _checkpointFileName);
+    }
+  }
+  // the status counts the same items as the scheduler
+  _stats.start(_scheduler.size(), restored);
+  return true;
+}
 
-  std::string line;
+// The algorithm, the keyspace, the targets and the chunks
+string HashFinder::describeSearch() const {
+  std::ostringstream search;
+  search << (_md5 ? "md5" : "sha1");
+  if (_mappedDictionary.isOpen()) {
+    search << " dictionary " << _mappedDictionary.size() << " bytes inode "
+        << _mappedDictionary.inode() << " modified "
+        << _mappedDictionary.modified();
+    if (_rules.size() > 0) {
+      search << " rules " << _rules.size() << " " << std::hex
+          << _rules.checksum() << std::dec;
+    }
+  } else if (_maskString != NULL) {
+    search << " mask " << _maskString;
+    for (unsigned i = 0; i < Mask::kCustomCharsets; i++) {
+      if (_customCharsets[i] != NULL) {
+        search << " charset" << i + 1 << " " << _customCharsets[i];
+      }
+    }
+  } else {
+    search << " characters " << _allowedCharacters << " length "
+        << _minLength << "-" << _maxLength;
+  }
+  // FNV-1a over the sorted digests, new targets need a new search
+  uint64_t targets = 14695981039346656037ULL;
+  for (size_t i = 0; i < _targets.size(); i++) {
+    for (unsigned j = 0; j < _targets.words(); j++) {
+      targets = (targets ^ _targets.digest(i)[j]) * 1099511628211ULL;
+    }
+  }
+  search << " targets " << _targets.size() << " " << std::hex << targets
+      << std::dec << " range " << Scheduler::format(_rangeBegin) << "-"
+      << Scheduler::format(_rangeEnd) << " chunks " << _scheduler.chunks();
+  return search.str();
+}
 
-  // open the dictionary and read line by line into our vector
-  std::ifstream dictionaryFile(_inputFileName, std::ios_base::in);
-  if (dictionaryFile.is_open()) {
-    while ( dictionaryFile.good() ) {
-      // read the file line by line
-      getline(dictionaryFile, line);
-      // save the line string into the _dictionary vector
-      _dictionary.push_back(line);
-    }
-    // close the file handle
-    dictionaryFile.close();
-    return true;
+void HashFinder::saveCheckpoint() {
+  if (!_checkpoint.save(_checkpointFileName)) {
+    fprintf(stderr, "[Main] Checkpoint %s cannot be written.\n",
+        _checkpointFileName);
   }
-  return false;
 }
 
-// Print the usage and exit
-void HashFinder::printUsageAndExit() const {
-  fprintf(stderr,
-          "Usage: ./HashFinderMain [options] <hashToFind>\n"
-          "Options:\n"
-          " -i, --input-file: read words from a dictionary file\n"
-          " -a, --min-length: minimal length of the generated combinations\n"
-          "                   Default: 8\n"
-          " -z, --max-length: maximum length of the generated combinations\n"
-          "                   Default: 8\n"
-          " -c, --characters: chars used to generate combinations\n"
-          "                   Default: abcdefghijklmnopqrstuvwxyz0123456789\n"
-          " -h, --hash-algo : can either be sha-1 or md5\n"
-          "                   Default: md5\n");
-  exit(1);
+// The mask or the characters for every position
+CandidateGenerator HashFinder::generator(unsigned length) const {
+  const CandidateGenerator::ByteOrder kOrder = _md5
+      ? CandidateGenerator::kLittleEndian : CandidateGenerator::kBigEndian;
+  if (_maskString != NULL) {
+    return CandidateGenerator(_mask.alphabets(), length, kOrder);
+  }
+  return CandidateGenerator(_allowedCharacters, length, kOrder);
 }
 
 // prints the configuration
 void HashFinder::printConfiguration() const {
   printf("[Main] HashFinder version %s.\n", HASHFINDER_VERSION);
   printf("[Main] Hashing-Algorithm: %s.\n", _md5 ? "MD5" : "SHA-1");
-  printf("[Main] Hash: %s.\n", _hashToFind);
-  if (_inputFileName == NULL) {
+  printf("[Main] Kernel: %s (%u lanes, %s, CPU features: %s).\n",
+      _md5 ? MD5Simd::name(_kernel) : SHA1Simd::name(_sha1Kernel),
+      laneCount(), _kernelSelected ? "set by --kernel" : "fastest supported",
+      CpuFeatures::describe().c_str());
+  if (_hashToFind != NULL) {
+    printf("[Main] Hash: %s.\n", _hashToFind);
+  } else if (_hashFileName != NULL) {
+    printf("[Main] Hashes: %zu from %s.\n", _targets.size(), _hashFileName);
+  }
+  if (useTable()) {
+    if (_generateTableName != NULL) {
+      printf("[Main] Generating rainbow table %s:\n", _generateTableName);
+    } else {
+      printf("[Main] Using rainbow table %s:\n", _tableFileName);
+    }
+    printf("       - %s\n", _table.describe().c_str());
+    printf("       - chains: %" PRIu64 " of %u columns\n",
+        _generateTableName != NULL ? _chainCount : _table.chains(),
+        _table.chainLength());
+    printf("[Main] Combinations: %" PRIu64 "\n", _table.keyspace());
+  } else if (_maskString != NULL) {
+    printf("[Main] Using mask attack:\n");
+    printf("       - mask: %s\n", _maskString);
+    printf("       - word length: %u\n", _mask.length());
+    printf("[Main] Combinations: %s\n", Scheduler::format(_keyspace).c_str());
+  } else if (_inputFileName == NULL) {
     printf("[Main] Using combination attack:\n");
     if (_minLength != _maxLength) {
       printf("       - word length: %d - %d\n", _minLength, _maxLength);
@@ -177,17 +850,365 @@ void HashFinder::printConfiguration() const {
       printf("       - word length: %d\n", _maxLength);
     }
     printf("       - characters: %s\n", _allowedCharacters);
-    uint64_t nCombinations = 0;
-    for (int i = _minLength; i <= _maxLength; i++) {
-      nCombinations += pow(strlen(_allowedCharacters), i);
+    printf("[Main] Combinations: %s\n", Scheduler::format(_keyspace).c_str());
+  } else if (_mappedDictionary.isOpen()) {
+    printf("[Main] Using dictionary attack: %" PRIu64 " bytes mapped\n",
+        _mappedDictionary.size());
+  } else {
+    printf("[Main] Using dictionary attack: streaming %s\n", _inputFileName);
+  }
+  if (_buildIndexName != NULL) {
+    printf("[Main] Building digest index %s.\n", _buildIndexName);
+  } else if (_indexFileName != NULL) {
+    printf("[Main] Using digest index %s: %" PRIu64 " words.\n",
+        _indexFileName, _index.size());
+  }
+  if (_inputFileName != NULL && _rules.size() > 0) {
+    printf("[Main] Rules: %u from %s\n", _rules.size(), _rulesFileName);
+  }
+  printf("[Main] CPUs: %zu allowed, %u cores, %u NUMA nodes",
+      _topology.cpus().size(), _topology.cores(), _topology.nodes());
+  if (_topology.quota() > 0) printf(", quota %.2f", _topology.quota());
+  printf("\n[Main] Workers: %u%s%s\n", threadCount(),
+      _noSmt ? ", one per core" : "", _pin ? ", pinned" : "");
+  if (isPartial()) {
+    printf("[Main] Range: %s - %s (shard %" PRIu64 "/%" PRIu64 ")\n",
+        Scheduler::format(_rangeBegin).c_str(),
+        Scheduler::format(_rangeEnd).c_str(), _shard, _shards);
+  }
+}
+
+// prints how many hashes have been found
+void HashFinder::printSummary() const {
+  // there are no hashes while building a table or an index
+  if (_targets.size() > 0) {
+    printf("[Main] Found %zu of %zu hashes.\n",
+        _targets.size() - _targets.remaining(), _targets.size());
+  }
+  if (_findAll) printf("[Main] Matching words: %zu.\n", _results.size());
+  if (_rejectedWords > 0) {
+    printf("[Main] Skipped %" PRIu64 " candidates of the rules longer than "
+        "%zu characters.\n", _rejectedWords.load(), RuleEngine::kMaxWord);
+  }
+  Stats::Sample sample = _stats.sample();
+  if (sample.seconds > 0) {
+    printf("[Main] Hashed %" PRIu64 " candidates in %.1f s, %s.\n",
+        sample.hashes, sample.seconds,
+        Stats::formatRate(sample.hashes / sample.seconds).c_str());
+  }
+}
+
+bool HashFinder::saveTable() {
+  if (_generateTableName == NULL) return true;
+  const size_t kGenerated = _chains.size();
+  string error;
+  if (!_table.save(_generateTableName, &_chains, &error)) {
+    fprintf(stderr, "<generate-table> %s %s.\n", _generateTableName,
+        error.c_str());
+    return false;
+  }
+  printf("[Main] Saved %zu of %zu chains to %s, the others merged.\n",
+      _chains.size(), kGenerated, _generateTableName);
+  return true;
+}
+
+bool HashFinder::saveIndex() {
+  if (_buildIndexName == NULL) return true;
+  string error;
+  if (!_index.save(_buildIndexName, &error)) {
+    fprintf(stderr, "<build-index> %s %s.\n", _buildIndexName,
+        error.c_str());
+    return false;
+  }
+  printf("[Main] Saved the digests of %" PRIu64 " words to %s.\n",
+      _index.size(), _buildIndexName);
+  return true;
+}
+
+bool HashFinder::isReusable() const {
+  return !_stream && _hashFileName == NULL && _statusJsonFileName == NULL
+      && _checkpointFileName == NULL && _generateTableName == NULL
+      && _buildIndexName == NULL;
+}
+
+bool HashFinder::checkTargets(const vector<string>& hashes,
+    string* error) const {
+  uint32_t digest[5];
+  for (size_t i = 0; i < hashes.size(); i++) {
+    if (hashes[i].size() != (_md5 ? 32u : 40u)
+        || !parseDigest(hashes[i].c_str(), _md5, digest)) {
+      *error = hashes[i] + " must be a hex string with length = "
+          + (_md5 ? "32" : "40");
+      return false;
     }
-    printf("[Main] Combinations: %" PRIu64 "\n", nCombinations);
+  }
+  return true;
+}
+
+bool HashFinder::retarget(const vector<string>& hashes, string* error) {
+  _targets.clear(_md5 ? 4 : 5);
+  for (size_t i = 0; i < hashes.size(); i++) addTarget(hashes[i].c_str());
+  _targets.build();
+  _hashToFind = NULL;
+  _hashFileName = NULL;
+  delete[] _collision.load();
+  _collision = NULL;
+  _stop = false;
+  _reporting = true;
+  Result result;
+  while (_resultQueue.pop(&result)) {}
+  _results.clear();
+  // the copies on the NUMA nodes hold the old targets, the copies of the
+  // dictionary stay
+  for (unsigned i = 0; _replicas != NULL && i < _topology.nodes(); i++) {
+    _replicas[i].targetsBuilt.reset(new std::once_flag());
+  }
+  return planWork(error);
+}
+
+vector<std::pair<string, string> > HashFinder::collisions() const {
+  vector<std::pair<string, string> > result;
+  for (size_t i = 0; i < _results.size(); i++) {
+    result.push_back(std::make_pair(formatDigest(
+        _targets.digest(_results[i].target), _md5), _results[i].word));
+  }
+  return result;
+}
+
+bool HashFinder::useIndex() const {
+  return _buildIndexName != NULL || _indexFileName != NULL;
+}
+
+bool HashFinder::useTable() const {
+  return _generateTableName != NULL || _tableFileName != NULL;
+}
+
+uint64_t HashFinder::columnBlocks() const {
+  return (_table.chainLength() + laneCount() - 1) / laneCount();
+}
+
+// A mapped file is a dictionary, even if it is empty
+bool HashFinder::useDictionary() const {
+  return _mappedDictionary.isOpen() || _wordStream.isOpen();
+}
+
+bool HashFinder::isPartial() const {
+  return _shards > 1 || _skip > 0 || _limit != ~static_cast<uint128_t>(0);
+}
+
+// The reader stage of a streamed dictionary
+void HashFinder::readStream() {
+  _wordStream.read(_stop);
+  if (_wordStream.skippedLines() > 0) {
+    fprintf(stderr, "[Main] Skipped %" PRIu64 " lines longer than %zu "
+        "bytes.\n", _wordStream.skippedLines(), WordStream::kBufferSize);
+  }
+}
+
+bool HashFinder::isStreaming() const {
+  return _wordStream.isOpen();
+}
+
+// Number of candidates hashed at once by the selected kernel
+unsigned HashFinder::laneCount() const {
+  return _md5 ? MD5Simd::lanes(_kernel) : SHA1Simd::lanes(_sha1Kernel);
+}
+
+// The parts of a search which depend on MD5, the search loops are compiled
+// once for every algorithm and never branch on it.
+struct HashFinder::MD5Search {
+  typedef MD5Simd Simd;
+  typedef MD5Simd::Kernel Kernel;
+
+  // longest word hashed in a single block
+  static const size_t kMaxSingleBlock = MD5::kMaxSingleBlock;
+
+  static MD5Simd::Kernel kernel(const HashFinder& finder) {
+    return finder._kernel;
+  }
+
+  // the scalar MD5 kernel is no faster than MD5::digestSingleBlock
+  static bool useLanes(size_t length, unsigned lanes) {
+    return length <= kMaxSingleBlock && lanes > 1;
+  }
+
+  // The digest of a single block word which is not hashed in the lanes,
+  // it skips the streaming API.
+  const uint32_t* digest(const char* word, size_t length) {
+    MD5::digestSingleBlock(word, length, state);
+    return state;
+  }
+
+  // hashes the batches of long words
+  MD5 hash;
+  uint32_t state[4];
+};
+
+// The same for SHA-1, which always takes the batch kernel for single block
+// words.
+struct HashFinder::SHA1Search {
+  typedef SHA1Simd Simd;
+  typedef SHA1Simd::Kernel Kernel;
+
+  static const size_t kMaxSingleBlock = SHA1::kMaxSingleBlock;
+
+  static SHA1Simd::Kernel kernel(const HashFinder& finder) {
+    return finder._sha1Kernel;
+  }
+
+  static bool useLanes(size_t length, unsigned lanes) {
+    return length <= kMaxSingleBlock;
+  }
+
+  // only for the interface, the lanes take all single block words
+  const uint32_t* digest(const char* word, size_t length) {
+    HashAlgorithm::Message message = { word, length };
+    hash.SHA1::hashBatch(&message, 1, state);
+    return state;
+  }
+
+  SHA1 hash;
+  uint32_t state[5];
+};
+
+// Hash a batch with the SIMD kernel, only the first nFilled lanes count
+template <typename Search>
+uint32_t HashFinder::matchLanes(const TargetSet& lookup,
+    const LaneBlock& block, unsigned nFilled, int* targets,
+    const LanePrefix* prefix) const {
+  typedef typename Search::Simd Simd;
+  const typename Search::Kernel kKernel = Search::kernel(*this);
+  uint32_t mask = 0;
+  if (lookup.size() == 1) {
+    // a single target is compared inside the kernel, which can exit early
+    const uint32_t* target = lookup.digest(0);
+    mask = prefix != NULL ? Simd::matchPrefix(kKernel, *prefix, block, target)
+        : Simd::match(kKernel, block, target);
+    if (nFilled < kMaxLanes) mask &= (1u << nFilled) - 1;
+    for (uint32_t m = mask; m != 0; m &= m - 1) targets[__builtin_ctz(m)] = 0;
+    return mask;
+  }
+
+  LaneDigests digests;
+  if (prefix != NULL) {
+    Simd::digestPrefix(kKernel, *prefix, block, &digests);
   } else {
-    printf("[Main] Using dictionary attack: %zu words\n", _dictionary.size());
+    Simd::digest(kKernel, block, &digests);
+  }
+  for (unsigned lane = 0; lane < nFilled; lane++) {
+    if (!lookup.mayContain(digests.words[0][lane])) continue;
+    uint32_t digest[5];
+    for (unsigned i = 0; i < lookup.words(); i++) {
+      digest[i] = digests.words[i][lane];
+    }
+    targets[lane] = lookup.find(digest);
+    if (targets[lane] >= 0) mask |= 1u << lane;
+  }
+  return mask;
+}
+
+// Hand the word to the reporter, the first word is saved as _collision
+void HashFinder::foundCollision(unsigned threadnumber, const string& word,
+    int target) {
+  bool first = _targets.markFound(target);
+  if (!first && !_findAll) return;
+  if (first) {
+    char* collision = new char[word.size() + 1];
+    snprintf(collision, word.size() + 1, "%s", word.c_str());
+    char* expected = NULL;
+    if (!_collision.compare_exchange_strong(expected, collision)) {
+      delete[] collision;
+    }
+    if (!_findAll && _targets.allFound()) _stop.store(true);
+  }
+  Result result = { threadnumber, target, word };
+  _resultQueue.push(result);
+}
+
+// Print the collisions found so far, only called by one thread at a time
+void HashFinder::drainResults() {
+  Result result;
+  while (_resultQueue.pop(&result)) {
+    if (_targets.size() == 1) {
+      printf("[Thread %d] Collision found => %s\n", result.threadnumber,
+          result.word.c_str());
+    } else {
+      printf("[Thread %d] Collision found => %s:%s\n", result.threadnumber,
+          formatDigest(_targets.digest(result.target), _md5).c_str(),
+          result.word.c_str());
+    }
+    fflush(stdout);
+    _results.push_back(result);
   }
 }
 
-void HashFinder::process(const unsigned threadnumber, const unsigned kThreads) {
+void HashFinder::report() {
+  Stats::Sample before = _stats.sample();
+  double saved = before.seconds;
+  while (_reporting.load()) {
+    drainResults();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (_statusInterval == 0 && _checkpointFileName == NULL) continue;
+    Stats::Sample now = _stats.sample();
+    if (_statusInterval > 0
+        && now.seconds - before.seconds >= _statusInterval) {
+      printStatus(before, now, true);
+      before = now;
+    }
+    if (_checkpointFileName != NULL
+        && now.seconds - saved >= kCheckpointInterval) {
+      saveCheckpoint();
+      saved = now.seconds;
+    }
+  }
+  // the workers are done, print what they pushed last
+  drainResults();
+  // the JSON file always ends with the averages of the whole search
+  printStatus(Stats::Sample(), _stats.sample(), false);
+  if (_checkpointFileName != NULL) saveCheckpoint();
+}
+
+void HashFinder::printStatus(const Stats::Sample& before,
+    const Stats::Sample& now, bool print) {
+  if (print) {
+    printf("%s", _stats.format(before, now).c_str());
+    fflush(stdout);
+  }
+  if (_statusJson != NULL) {
+    fprintf(_statusJson, "%s\n", _stats.formatJson(before, now).c_str());
+    fflush(_statusJson);
+  }
+}
+
+void HashFinder::stopReport() {
+  _reporting.store(false);
+}
+
+HashFinder::NodeReplica* HashFinder::placeWorker(unsigned threadnumber) {
+  if (!_pin) return NULL;
+  const Topology::Cpu& cpu = _workers[(threadnumber - 1) % _workers.size()];
+  if (!Topology::pin(cpu.id)) {
+    fprintf(stderr, "[Thread %d] Cannot be pinned to CPU %u.\n",
+        threadnumber, cpu.id);
+    return NULL;
+  }
+  if (_replicas == NULL) return NULL;
+  // pages belong to the node of the thread touching them first, so the
+  // pinned worker copies the data itself
+  NodeReplica& replica = _replicas[cpu.node];
+  std::call_once(*replica.targetsBuilt, [&]() {
+    replica.targets.replicate(_targets);
+  });
+  std::call_once(replica.dictionaryBuilt, [&]() {
+    if (_mappedDictionary.isOpen()) {
+      replica.dictionary.reset(new char[_mappedDictionary.size()]);
+      _mappedDictionary.copy(replica.dictionary.get());
+    }
+  });
+  return &replica;
+}
+
+void HashFinder::process(const unsigned threadnumber) {
   // when the thread starts print start message once
   printf("[Thread %d] Started...\n", threadnumber);
 
@@ -195,121 +1216,422 @@ void HashFinder::process(const unsigned threadnumber, const unsigned kThreads) {
   struct timeval start_t, end_t;
   gettimeofday(&start_t, NULL);
 
+  // the algorithm is dispatched once, the search loops are compiled for it
+  const uint64_t kTried = _md5 ? search<MD5Search>(threadnumber)
+      : search<SHA1Search>(threadnumber);
+
+  gettimeofday(&end_t, NULL);
+  uint64_t endtime = (end_t.tv_sec * (unsigned int)1e6 +   end_t.tv_usec);
+  uint64_t starttime = (start_t.tv_sec * (unsigned int)1e6 + start_t.tv_usec);
+  printf("[Thread %d] Tried %" PRIu64 " strings.\n", threadnumber,
+            kTried);
+  printf("[Thread %d] Stopped after %" PRIu64 " microseconds.\n", threadnumber,
+    (endtime - starttime));
+}
+
+// Take chunks or buffers of the dictionary until all work is done
+template <typename Search>
+uint64_t HashFinder::search(unsigned threadnumber) {
+  if (useTable()) return searchTable<Search>(threadnumber);
+  if (_indexFileName != NULL) return searchIndex<Search>(threadnumber);
+
   // how many combinations have been tried by this thread
   uint64_t nCombinationsTried = 0;
-  // the work start at index 0, there we will add one,
-  // if this is the first thread
-  if (threadnumber == 1) nCombinationsTried++;
-
-  // are we performing a dictionary attack
-  if (_dictionary.size() > 0) {
-    // this is the number of possible entries from the dictionary
-    const uint64_t nEntries = _dictionary.size();
-    // this is the start number of the entries this thread will compute
-    uint64_t start = ((threadnumber - 1) * nEntries) / kThreads;
-    // this is the stop number of combinations this thread will compute
-    uint64_t stop = (threadnumber * nEntries) / kThreads;
-    // this is the overhead, if we've got 2 threads and 3 combinations,
-    // we need to put the third combination on one of those two threads
-    // in this case we will put the overhead on the last thread
-    if (threadnumber == kThreads) stop += nEntries % kThreads;
-
-    // Now initialize the HashAlgorithm object
-    HashAlgorithm * test;
-    if (_md5) {
-      test = new MD5();
-    } else {
-      test = new SHA1();
-    }
 
-    uint64_t k = start;
-    for (; k < (stop - 1); ++k) {
-      if (_collision != NULL) break;
+  // the hash for long dictionary words
+  Search hasher;
 
-      test->reset();
-      if (_md5) {
-        test->update(_dictionary.at(k).c_str(), _dictionary.at(k).size());
+  // pinned workers look up the copies on their own NUMA node
+  NodeReplica* replica = placeWorker(threadnumber);
+  const TargetSet& lookup = replica != NULL ? replica->targets : _targets;
+  const char* dictionary = replica != NULL ? replica->dictionary.get() : NULL;
+
+  vector<WordRef> words;
+  if (_wordStream.isOpen()) {
+    // take buffers from the reader until the end of the dictionary
+    WordBuffer* buffer;
+    while (!_stop.load(std::memory_order_relaxed)
+        && (buffer = _wordStream.take()) != NULL) {
+      words.clear();
+      MappedDictionary::lines(buffer->data, buffer->used, 0, buffer->used,
+          &words);
+      uint64_t nTried = searchDictionary(threadnumber, lookup, words,
+          &hasher);
+      _stats.add(threadnumber, nTried, buffer->used);
+      nCombinationsTried += nTried;
+      _wordStream.recycle(buffer);
+    }
+  }
+
+  // take chunks until all work is done or every target is found
+  Chunk chunk;
+  while (!_wordStream.isOpen() && !_stop.load(std::memory_order_relaxed)
+      && _scheduler.next(&chunk)) {
+    uint64_t nTried;
+    if (useDictionary()) {
+      // a chunk of the mapped file is a byte range, find its lines
+      words.clear();
+      if (dictionary != NULL) {
+        MappedDictionary::lines(dictionary, _mappedDictionary.size(),
+            chunk.begin, chunk.end, &words);
       } else {
-        test->update(_dictionary.at(k));
+        _mappedDictionary.words(chunk.begin, chunk.end, &words);
       }
-      test->finalize();
-
-      if (strcmp(_hashToFind, test->hexdigest().c_str()) == 0) {
-        _collision = new char[_dictionary.at(k).size()+1];
-        snprintf(_collision, _dictionary.at(k).size()+1,
-            _dictionary.at(k).c_str());
-        printf("[Thread %d] Collision found => %s\n", threadnumber,
-          _dictionary.at(k).c_str());
-        break;
+      if (_buildIndexName != NULL) {
+        nTried = indexWords(words, dictionary != NULL ? dictionary
+            : _mappedDictionary.data(), &hasher);
+      } else {
+        nTried = searchDictionary(threadnumber, lookup, words, &hasher);
       }
+    } else {
+      nTried = searchCombinations<Search>(threadnumber, lookup,
+          _minLength + chunk.segment, chunk.begin, chunk.end);
     }
-    nCombinationsTried += (k - start);
-    delete test;
-  } else {
-    // divide the number of combinations for every thread for
-    // the whole range of word lengths, ex. 5-6 or 3-8...
-    for (int wlen = _minLength; wlen <= _maxLength; wlen++) {
-      const unsigned kCharLength = wlen;
-      char combination[kCharLength];
-      uint64_t l;
-      div_t x;
-
-      // this is the number of possible combinations for this word length
-      const uint64_t nCombinations = pow(strlen(_allowedCharacters),
-          kCharLength);
-      // this is the start number of the combinations this thread will compute
-      uint64_t start = ((threadnumber - 1) * nCombinations) / kThreads;
-      // this is the stop number of combinations this thread will compute
-      uint64_t stop = (threadnumber * nCombinations) / kThreads;
-      // this is the overhead, if we've got 2 threads and 3 combinations,
-      // we need to put the third combination on one of those two threads
-      // in this case we will put the overhead on the last thread
-      if (threadnumber == kThreads) stop += nCombinations % kThreads;
-
-      // Now initialize the HashAlgorithm object
-      HashAlgorithm * test;
-      if (_md5) {
-        test = new MD5();
-      } else {
-        test = new SHA1();
+    // the status counts chunks, never single hashes
+    _stats.add(threadnumber, nTried, chunk.end - chunk.begin);
+    // a chunk cut short by the stop is not done
+    if (_checkpointFileName != NULL && !_stop.load()) {
+      _checkpoint.complete(chunk.index);
+    }
+    nCombinationsTried += nTried;
+  }
+  return nCombinationsTried;
+}
+
+// Take chunks of chains to generate or of columns to look up
+template <typename Search>
+uint64_t HashFinder::searchTable(unsigned threadnumber) {
+  placeWorker(threadnumber);
+  RainbowWalker<typename Search::Simd> walker(_table,
+      Search::kernel(*this));
+  const uint64_t kBlocks = columnBlocks();
+  const size_t kTargets = _targets.size();
+  uint64_t nHashes = 0;
+  Chunk chunk;
+  while (!_stop.load(std::memory_order_relaxed) && _scheduler.next(&chunk)) {
+    uint64_t nChunk = 0;
+    if (_generateTableName != NULL) {
+      nChunk = walker.generate(chunk.begin, chunk.end,
+          &_chains[chunk.begin]);
+      _stats.add(threadnumber, nChunk, chunk.end - chunk.begin);
+      nHashes += nChunk;
+      continue;
+    }
+    for (uint64_t item = chunk.begin; item < chunk.end; item++) {
+      // the last columns need the fewest hashes, they are looked up for
+      // all targets before the columns in front of them
+      const int kTarget = item % kTargets;
+      const unsigned kFirst = (kBlocks - 1 - item / kTargets) * walker.lanes();
+      if (!_findAll && _targets.isFound(kTarget)) continue;
+      string word;
+      if (walker.lookup(_targets.digest(kTarget), kFirst, &word, &nChunk)) {
+        foundCollision(threadnumber, word, kTarget);
       }
+    }
+    _stats.add(threadnumber, nChunk, chunk.end - chunk.begin);
+    nHashes += nChunk;
+  }
+  return nHashes;
+}
 
-      uint64_t k = start;
-      for (; k <= stop; ++k) {
-        if (_collision != NULL) break;
-        l = k;
-        for (int i = (kCharLength-1); i >= 0; --i) {
-          x = div(l, pow(strlen(_allowedCharacters), i));
-          combination[i] = _allowedCharacters[x.quot];
-          l = x.rem;
+// Hash every word of the chunk once for the digest index
+template <typename Search>
+uint64_t HashFinder::indexWords(const vector<WordRef>& words,
+    const char* base, Search* hasher) {
+  const size_t kWords = words.size();
+  if (kWords == 0) return 0;
+  const unsigned kDigestWords = _targets.words();
+  vector<HashAlgorithm::Message> messages(kWords);
+  for (size_t i = 0; i < kWords; i++) {
+    messages[i].data = words[i].data;
+    messages[i].length = words[i].length;
+  }
+  vector<uint32_t> digests(kWords * kDigestWords);
+  hasher->hash.hashBatch(&messages[0], kWords, &digests[0]);
+  vector<DigestIndex::Record> records(kWords);
+  for (size_t i = 0; i < kWords; i++) {
+    records[i].prefix = DigestIndex::prefix(&digests[i * kDigestWords]);
+    records[i].offset = words[i].data - base;
+  }
+  _index.add(records);
+  return kWords;
+}
+
+// Look the targets up in the digest index and hash the words found again
+template <typename Search>
+uint64_t HashFinder::searchIndex(unsigned threadnumber) {
+  Search hasher;
+  const unsigned kDigestWords = _targets.words();
+  vector<uint64_t> offsets;
+  vector<WordRef> words;
+  uint32_t digest[5];
+  uint64_t nHashes = 0;
+  Chunk chunk;
+  while (!_stop.load(std::memory_order_relaxed) && _scheduler.next(&chunk)) {
+    uint64_t nChunk = 0;
+    for (uint64_t target = chunk.begin; target < chunk.end; target++) {
+      const uint32_t* kTarget = _targets.digest(target);
+      offsets.clear();
+      _index.find(DigestIndex::prefix(kTarget), &offsets);
+      // the prefix may match other words, or the word may have changed
+      for (size_t i = 0; i < offsets.size(); i++) {
+        words.clear();
+        _mappedDictionary.words(offsets[i], offsets[i] + 1, &words);
+        if (words.empty()) continue;
+        HashAlgorithm::Message message = { words[0].data, words[0].length };
+        hasher.hash.hashBatch(&message, 1, digest);
+        nChunk++;
+        if (memcmp(digest, kTarget, kDigestWords * sizeof(uint32_t)) != 0) {
+          continue;
         }
+        foundCollision(threadnumber, string(words[0].data, words[0].length),
+            target);
+        if (!_findAll) break;
+      }
+    }
+    _stats.add(threadnumber, nChunk, chunk.end - chunk.begin);
+    nHashes += nChunk;
+  }
+  return nHashes;
+}
 
-        test->reset();
-        if (_md5) {
-          const char * temp = combination;
-          test->update(temp, sizeof(combination));
-        } else {
-          test->update(std::string(combination, kCharLength));
+// Hash the dictionary words of one chunk, with every rule if there are any
+template <typename Search>
+uint64_t HashFinder::searchDictionary(unsigned threadnumber,
+    const TargetSet& lookup, const vector<WordRef>& words, Search* hasher) {
+  // short words are collected in the lanes of the SIMD kernel
+  const unsigned kLanes = Search::Simd::lanes(Search::kernel(*this));
+  LaneBlock block;
+  size_t laneWord[kMaxLanes];
+  unsigned laneRule[kMaxLanes];
+  unsigned nFilled = 0;
+  int targets[kMaxLanes];
+  // longer words are collected back to back for hashBatch()
+  string longWords;
+  size_t longLengths[kLongBatch];
+  unsigned nLong = 0;
+
+  // all rules are applied to a block of words small enough to stay in the
+  // cache, without rules every word is hashed as it is
+  const bool kUseRules = _rules.size() > 0;
+  const unsigned kRules = kUseRules ? _rules.size() : 1;
+  const size_t kWords = words.size();
+  char mangled[RuleEngine::kMaxWord];
+  uint64_t nTried = 0;
+  uint64_t nRejected = 0;
+
+  for (size_t first = 0; first < kWords; first += kRuleBlock) {
+    const size_t kLast = std::min(first + kRuleBlock, kWords);
+    for (unsigned rule = 0; rule < kRules; rule++) {
+      for (size_t k = first; k < kLast; ++k) {
+        const char* word = words[k].data;
+        size_t length = words[k].length;
+        // a word too long for the rules is still hashed as it is by ':'
+        if (kUseRules && (length <= RuleEngine::kMaxWord
+            || !_rules.isIdentity(rule))) {
+          length = _rules.apply(rule, word, length, mangled);
+          if (length == RuleEngine::kRejected) {
+            nRejected++;
+            continue;
+          }
+          word = mangled;
+        }
+        nTried++;
+
+        if (Search::useLanes(length, kLanes)) {
+          Search::Simd::setLane(&block, nFilled, word, length);
+          laneWord[nFilled] = k;
+          laneRule[nFilled++] = rule;
+          if (nFilled == kLanes) {
+            uint32_t mask = matchLanes<Search>(lookup, block, nFilled, targets);
+            for (; mask != 0; mask &= mask - 1) {
+              unsigned lane = __builtin_ctz(mask);
+              foundCollision(threadnumber,
+                  candidate(words[laneWord[lane]], laneRule[lane]),
+                  targets[lane]);
+            }
+            nFilled = 0;
+            // cancellation is checked once per batch
+            if (_stop.load(std::memory_order_relaxed)) {
+              _rejectedWords += nRejected;
+              return nTried;
+            }
+          }
+          continue;
+        }
+
+        if (length > Search::kMaxSingleBlock) {
+          longWords.append(word, length);
+          longLengths[nLong++] = length;
+          if (nLong == kLongBatch) {
+            matchLong(threadnumber, lookup, longWords, longLengths, nLong,
+                hasher);
+            longWords.clear();
+            nLong = 0;
+          }
+          continue;
         }
-        test->finalize();
-
-        if (strcmp(_hashToFind, test->hexdigest().c_str()) == 0) {
-          _collision = new char[kCharLength + 1];
-          snprintf(_collision, kCharLength + 1, combination);
-          printf("[Thread %d] Collision found => %.*s\n", threadnumber,
-              kCharLength, _collision);
-          break;
+
+        const uint32_t* digest = hasher->digest(word, length);
+        int target = lookup.find(digest);
+        if (target >= 0) {
+          foundCollision(threadnumber, string(word, length), target);
         }
       }
-      nCombinationsTried += (k - (start+1));
-      delete test;
     }
   }
-  gettimeofday(&end_t, NULL);
-  uint64_t endtime = (end_t.tv_sec * (unsigned int)1e6 +   end_t.tv_usec);
-  uint64_t starttime = (start_t.tv_sec * (unsigned int)1e6 + start_t.tv_usec);
-  printf("[Thread %d] Tried %" PRIu64 " strings.\n", threadnumber,
-            nCombinationsTried);
-  printf("[Thread %d] Stopped after %" PRIu64 " microseconds.\n", threadnumber,
-    (endtime - starttime));
+  if (nLong > 0) {
+    matchLong(threadnumber, lookup, longWords, longLengths, nLong, hasher);
+  }
+  _rejectedWords += nRejected;
+  // hash the words left over in a partially filled batch
+  if (nFilled > 0) {
+    uint32_t mask = matchLanes<Search>(lookup, block, nFilled, targets);
+    for (; mask != 0; mask &= mask - 1) {
+      unsigned lane = __builtin_ctz(mask);
+      foundCollision(threadnumber,
+          candidate(words[laneWord[lane]], laneRule[lane]), targets[lane]);
+    }
+  }
+  return nTried;
+}
+
+template <typename Search>
+void HashFinder::matchLong(unsigned threadnumber, const TargetSet& lookup,
+    const string& arena, const size_t* lengths, unsigned n,
+    Search* hasher) {
+  const unsigned kWords = lookup.words();
+  uint32_t digests[kLongBatch * 5];
+  hasher->hash.hashBatch(arena.data(), lengths, n, digests);
+  size_t offset = 0;
+  for (unsigned i = 0; i < n; offset += lengths[i++]) {
+    int target = lookup.find(digests + i * kWords);
+    if (target >= 0) {
+      foundCollision(threadnumber, arena.substr(offset, lengths[i]), target);
+    }
+  }
+}
+
+// Apply the rule again to get the word of a lane
+string HashFinder::candidate(const WordRef& word, unsigned rule) const {
+  if (_rules.size() == 0) return string(word.data, word.length);
+  char mangled[RuleEngine::kMaxWord];
+  size_t length = _rules.apply(rule, word.data, word.length, mangled);
+  return string(mangled, length);
+}
+
+// Hash the combinations start to stop - 1 of the given length
+template <typename Search>
+uint64_t HashFinder::searchCombinations(unsigned threadnumber,
+    const TargetSet& lookup, unsigned length, uint64_t start, uint64_t stop) {
+  const unsigned kLanes = Search::Simd::lanes(Search::kernel(*this));
+  CandidateGenerator words = generator(length);
+  words.seek(start);
+
+  // The combinations of a run only differ in the last word holding
+  // characters. Batches which stay inside a run are hashed as a prefix
+  // batch: the kernel only loads that word and the steps before its first
+  // use are done once per run.
+  const unsigned kWord = length > 0 ? words.lastWord() : 0;
+  const uint64_t kRun = length > 0 ? words.lastWordKeyspace() : 1;
+  if (length > 0 && kWord <= kMaxPrefixWord
+      && kRun >= kPrefixBatches * kLanes) {
+    switch (kWord) {
+      case 0: return searchRuns<Search, 0>(threadnumber, lookup, &words,
+          start, stop);
+      case 1: return searchRuns<Search, 1>(threadnumber, lookup, &words,
+          start, stop);
+      case 2: return searchRuns<Search, 2>(threadnumber, lookup, &words,
+          start, stop);
+      default: return searchRuns<Search, 3>(threadnumber, lookup, &words,
+          start, stop);
+    }
+  }
+
+  // the number of words copied per combination is a constant of the loop
+#define SEARCH_BATCHES(n) case n: return searchBatches<Search, n>( \
+    threadnumber, lookup, &words, start, stop);
+  switch (words.dataWords()) {
+    SEARCH_BATCHES(1) SEARCH_BATCHES(2) SEARCH_BATCHES(3) SEARCH_BATCHES(4)
+    SEARCH_BATCHES(5) SEARCH_BATCHES(6) SEARCH_BATCHES(7) SEARCH_BATCHES(8)
+    SEARCH_BATCHES(9) SEARCH_BATCHES(10) SEARCH_BATCHES(11)
+    SEARCH_BATCHES(12) SEARCH_BATCHES(13)
+    default: return searchBatches<Search, 14>(threadnumber, lookup, &words,
+        start, stop);
+  }
+#undef SEARCH_BATCHES
+}
+
+// Prefix batches: only word kWord differs between the lanes
+template <typename Search, unsigned kWord>
+uint64_t HashFinder::searchRuns(unsigned threadnumber,
+    const TargetSet& lookup, CandidateGenerator* words, uint64_t start,
+    uint64_t stop) {
+  const unsigned kLanes = Search::Simd::lanes(Search::kernel(*this));
+  const uint64_t kRun = words->lastWordKeyspace();
+  LanePrefix prefix;
+  uint64_t leftInRun = 0;
+  LaneBlock block;
+  unsigned nFilled = 0;
+  int targets[kMaxLanes];
+
+  for (uint64_t k = start; k < stop; ++k) {
+    if (leftInRun == 0) {
+      Search::Simd::prepare(words->block(), kWord, &prefix);
+      leftInRun = kRun - k % kRun;
+    }
+    block.words[kWord][nFilled++] = words->block()[kWord];
+    const bool kEndOfRun = --leftInRun == 0;
+    if (nFilled == kLanes || k + 1 == stop || kEndOfRun) {
+      uint32_t mask = matchLanes<Search>(lookup, block, nFilled, targets,
+          &prefix);
+      foundInLanes(threadnumber, mask, targets, words->length(),
+          k + 1 - nFilled);
+      nFilled = 0;
+      // cancellation is checked once per batch
+      if (_stop.load(std::memory_order_relaxed)) return k + 1 - start;
+    }
+    words->next();
+  }
+  return stop - start;
+}
+
+// Whole blocks: the kDataWords words holding characters are copied
+template <typename Search, unsigned kDataWords>
+uint64_t HashFinder::searchBatches(unsigned threadnumber,
+    const TargetSet& lookup, CandidateGenerator* words, uint64_t start,
+    uint64_t stop) {
+  const unsigned kLanes = Search::Simd::lanes(Search::kernel(*this));
+  // consecutive combinations go into the lanes of the kernel, the
+  // generator only decodes the start index and counts up from there
+  LaneBlock block;
+  words->fillLanes(&block);
+  unsigned nFilled = 0;
+  int targets[kMaxLanes];
+
+  for (uint64_t k = start; k < stop; ++k) {
+    words->copyToLane<kDataWords>(&block, nFilled++);
+    if (nFilled == kLanes || k + 1 == stop) {
+      uint32_t mask = matchLanes<Search>(lookup, block, nFilled, targets);
+      foundInLanes(threadnumber, mask, targets, words->length(),
+          k + 1 - nFilled);
+      nFilled = 0;
+      // cancellation is checked once per batch
+      if (_stop.load(std::memory_order_relaxed)) return k + 1 - start;
+    }
+    words->next();
+  }
+  return stop - start;
+}
+
+// The lanes hold the combinations first to first + nFilled - 1, decode
+// the hits with a second generator to keep the one of the loop counting
+void HashFinder::foundInLanes(unsigned threadnumber, uint32_t mask,
+    const int* targets, unsigned length, uint64_t first) {
+  for (; mask != 0; mask &= mask - 1) {
+    unsigned lane = __builtin_ctz(mask);
+    CandidateGenerator hit = generator(length);
+    hit.seek(first + lane);
+    foundCollision(threadnumber, string(hit.word(), length), targets[lane]);
+  }
 }
@@ -7,8 +7,29 @@
 #define HASHFINDER_VERSION "1.0"
 
 #include <gtest/gtest.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
+#include "./algorithms/HashAlgorithm.h"
+#include "./algorithms/MD5Simd.h"
+#include "./algorithms/SHA1Simd.h"
+#include "./CandidateGenerator.h"
+#include "./Checkpoint.h"
+#include "./DigestIndex.h"
+#include "./MappedDictionary.h"
+#include "./Mask.h"
+#include "./RainbowTable.h"
+#include "./ResultQueue.h"
+#include "./RuleEngine.h"
+#include "./Scheduler.h"
+#include "./Stats.h"
+#include "./Topology.h"
+#include "./WordStream.h"
+#include "./TargetSet.h"
 
 using std::string;
 using std::vector;
@@ -29,47 +50,357 @@ class HashFinder {
   void reset();
 
   // Parse the command line arguments. The hash is specified as a non-option
-  // argument and cannot be omitted. Apart from that, the following options
-  // should be supported:
+  // argument and can only be omitted if a hash file is given. Apart from
+  // that, the following options should be supported:
   // --hash-algorithm, -h : specifies whether SHA-1 or MD5 should be used
   // --input-file, -i  : read from a dictionary file.
   // --min-length, -a  : minimal length of the generated combinations
   // --max-length, -z  : maximum length of the generated combinations
   // --characters, -c  : characters which can be used to generate combinations
+  // --kernel, -k      : scalar, sse2, avx2, avx512 or sha-ni (SHA-1 only)
+  // --hash-file, -f   : read the hashes to find from a file, one per line
+  // --find-all, -A    : report every matching word, never stop early
+  // --stream, -s      : read the dictionary while hashing, - is stdin
+  // --mask, -m        : characters for every position, e.g. ?u?l?l?d?d
+  // --charset1-4, -1-4: custom charsets for ?1 to ?4 in the mask
+  // --rules, -r       : apply every rule of the file to every word
+  // --status, -S      : seconds between two status lines, 0 for none
+  // --status-json, -J : append the status as JSON lines to a file
+  // --checkpoint, -C  : save the chunks done to a file now and then
+  // --restore, -R     : continue the search of a checkpoint file
+  // --shard, -x       : search part i of n of the keyspace, e.g. 2/8
+  // --skip, -o        : skip the first candidates (bytes of a dictionary)
+  // --limit, -l       : search at most this many candidates after them
+  // --pin, -p         : pin every worker to its own CPU
+  // --no-smt, -n      : one worker per core, no SMT siblings
+  // --generate-table, -G: build a rainbow table of the combinations
+  // --chains, -N      : number of chains of the table
+  // --chain-length, -L: columns of every chain
+  // --table, -T       : look the hashes up in a rainbow table
+  // --build-index, -I : hash the dictionary once into a digest index
+  // --index, -X       : look the hashes up in the index of the dictionary
   // Defaults will be:
   // --hash-algorithm=md5
   // --min-length=8
   // --max-length=8
   // --characters=abcdefghijklmnopqrstuvwxyz0123456789
+  // --kernel=<the fastest one supported by the CPU>
+  // --status=10
+  // --chains=<the combinations, at most 2^20>
+  // --chain-length=1000
+  // Prints the usage or what is wrong and exits if the arguments are
+  // invalid.
   void parseCommandLineArguments(int argc, char** argv);
   FRIEND_TEST(HashFinderTest, parseCommandLineArguments);
 
+  // Like parseCommandLineArguments(), but returns false with the message
+  // (the usage or what is wrong) instead of exiting, e.g. for the jobs of
+  // the daemon.
+  bool parseArguments(int argc, char** argv, string* error);
+  FRIEND_TEST(HashFinderTest, parseArguments);
+
+  // The options of the arguments by their long names, "name=value" or just
+  // "name", in the order given, followed by the other arguments. Nothing
+  // is opened or read. Returns false if an option is unknown or misses its
+  // value, parseArguments() tells what is wrong.
+  static bool canonicalOptions(int argc, char** argv,
+      vector<string>* result);
+
   // Read words from a dictionary.
   bool readDictionary();
   FRIEND_TEST(HashFinderTest, readDictionary);
 
   // Do the actual work, that is, create an MD5 or SHA1 hash
   // of a new word (if no dictionary is used, generate one)
-  // Do all of this until a hash collision is found.
-  void process(const unsigned threadnumber, const unsigned nThreads);
+  // Do all of this until every hash has a collision. Every thread calls
+  // this and takes chunks of the work until none is left.
+  void process(const unsigned threadnumber);
   FRIEND_TEST(HashFinderTest, process);
+  FRIEND_TEST(HashFinderTest, processKernels);
+  FRIEND_TEST(HashFinderTest, processHashFile);
+  FRIEND_TEST(HashFinderTest, processFindAll);
 
   // Print configuration info.
   void printConfiguration() const;
+
+  // Number of workers: the allowed CPUs limited by the cgroup quota.
+  unsigned threadCount() const { return _workers.size(); }
+
+  // Print how many of the hashes have been found.
+  void printSummary() const;
+
+  // Merge the chains of a generated rainbow table and write it, called
+  // after all workers have finished. Returns false if it cannot be
+  // written, true if no table is generated.
+  bool saveTable();
+  FRIEND_TEST(HashFinderTest, processTable);
+
+  // Sort the records of a digest index built of the dictionary and write
+  // it, like saveTable().
+  bool saveIndex();
+  FRIEND_TEST(HashFinderTest, processIndex);
+
+  // Whether the search can be run again for other hashes: it does not
+  // consume its input (a stream), take its hashes from a file or write
+  // files (a JSON status, a checkpoint, a table or an index).
+  bool isReusable() const;
+
+  // Returns false with the reason if one of the hex strings is no hash of
+  // the algorithm of the search.
+  bool checkTargets(const vector<string>& hashes, string* error) const;
+
+  // Search the same candidates for other hashes, e.g. the next batch of
+  // jobs of the daemon: the dictionary stays mapped and a table or an
+  // index stays loaded. The hashes must pass checkTargets(). Returns false
+  // with the reason if the work cannot be planned again.
+  bool retarget(const vector<string>& hashes, string* error);
+  FRIEND_TEST(HashFinderTest, retarget);
+
+  // The hex hash and the word of every collision after report().
+  vector<std::pair<string, string> > collisions() const;
+
+  // The reader stage of a streamed dictionary, run by one thread next to
+  // the workers. Only needed if isStreaming().
+  void readStream();
+  bool isStreaming() const;
+  FRIEND_TEST(HashFinderTest, processStream);
+
+  // Print the collisions pushed by the workers and the status every
+  // _statusInterval seconds, run by one reporter thread until stopReport()
+  // is called after all workers have finished.
+  void report();
+  void stopReport();
+  FRIEND_TEST(HashFinderTest, processStatus);
+  FRIEND_TEST(HashFinderTest, processCheckpoint);
+  FRIEND_TEST(HashFinderTest, processPinned);
  private:
-  // Print usage info and exit.
-  void printUsageAndExit() const;
+  // The read-only data of the search copied to the memory of one NUMA
+  // node, built by the first worker on the node. The dictionary is copied
+  // once, the targets again after every retarget().
+  struct NodeReplica {
+    NodeReplica() : targetsBuilt(new std::once_flag()) {}
+    std::once_flag dictionaryBuilt;
+    std::unique_ptr<std::once_flag> targetsBuilt;
+    TargetSet targets;
+    std::unique_ptr<char[]> dictionary;
+  };
+
+  // Number of combinations in one chunk of work. Big
+  // enough to keep the shared cursor cold, small enough that threads are
+  // done about the same time and notice quickly that all targets are found.
+  static const uint64_t kCombinationChunk = 1 << 16;
+  // bytes of a mapped dictionary in one chunk
+  static const uint64_t kMappedChunk = 1 << 20;
+  // words which get all rules before the next words, about 16 KB
+  static const size_t kRuleBlock = 1 << 11;
+  // words too long for a single block which are hashed in one hashBatch()
+  static const unsigned kLongBatch = 64;
+  // Prefix batches end where the positions before the last word change,
+  // they are only used if that leaves at most one partial batch in this
+  // many full ones.
+  static const uint64_t kPrefixBatches = 32;
+  // seconds between two saves of the checkpoint
+  static const int kCheckpointInterval = 10;
+  // chains generated in one chunk and at most by default
+  static const uint64_t kChainChunk = 1 << 10;
+  static const uint64_t kDefaultChains = 1 << 20;
+
+  // Convert a hex string into the native state words of the algorithm,
+  // little endian words for MD5 and big endian words for SHA-1.
+  // Returns false if the string contains a non-hex character.
+  static bool parseDigest(const char* hex, bool md5, uint32_t* digest);
+
+  // Parse a decimal count, returns false if it is no number or does not
+  // fit into 128 bits.
+  static bool parseCount(const char* decimal, uint128_t* count);
+
+  // Convert state words back into the hex string of the hash.
+  static string formatDigest(const uint32_t* digest, bool md5);
+
+  // Parse a hex hash of the selected algorithm and add it to the targets.
+  // Returns false if it has the wrong length or is not a hex string.
+  bool addTarget(const char* hex);
+
+  // Add every line of the hash file to the targets, empty lines are
+  // skipped. Returns false with the line number of the first invalid hash.
+  bool readHashFile(string* error);
+
+  // Plan the chunks of the dictionary or the combinations for process(),
+  // skip the chunks of the checkpoint to restore and start counting the
+  // status, called after parsing the arguments and after reading the
+  // dictionary. Returns false with the reason if it cannot be planned.
+  bool planWork(string* error);
+  FRIEND_TEST(HashFinderTest, planWork);
+  FRIEND_TEST(HashFinderTest, processShard);
+
+  // What is searched, the chunks of a checkpoint only fit the same search.
+  string describeSearch() const;
+
+  // Write the checkpoint, a failure is printed but the search goes on.
+  void saveCheckpoint();
+
+  // Pin the worker to its CPU if requested. Returns the replica of its
+  // node, NULL if the data is not replicated.
+  NodeReplica* placeWorker(unsigned threadnumber);
+
+  // The algorithm specific parts of search(), defined in HashFinder.cpp.
+  struct MD5Search;
+  struct SHA1Search;
+
+  // The work of a worker thread with the loops compiled for the algorithm.
+  // Returns the number of candidates tried.
+  template <typename Search>
+  uint64_t search(unsigned threadnumber);
+
+  // Search the dictionary words of a chunk with every rule, long words are
+  // hashed by the hasher. The targets are looked up in lookup. Returns the
+  // number of words tried.
+  template <typename Search>
+  uint64_t searchDictionary(unsigned threadnumber, const TargetSet& lookup,
+      const vector<WordRef>& words, Search* hasher);
+  FRIEND_TEST(HashFinderTest, processRules);
+
+  // The word with the rule applied.
+  string candidate(const WordRef& word, unsigned rule) const;
+
+  // Whether we search a dictionary or combinations.
+  bool useDictionary() const;
+
+  // Whether a rainbow table is generated or looked up.
+  bool useTable() const;
+
+  // Init the table to generate or load the table to look up, which
+  // decides the characters and the lengths. Returns false with the reason
+  // if this fails.
+  bool setupTable(string* error);
+
+  // Whether a digest index is built or looked up.
+  bool useIndex() const;
+
+  // Check the options of a digest index and load the index to look up.
+  // Returns false with the reason if this fails.
+  bool setupIndex(string* error);
+
+  // Hash the words of a chunk for the digest index, base is the start of
+  // the dictionary they are in. Returns the number of words.
+  template <typename Search>
+  uint64_t indexWords(const vector<WordRef>& words, const char* base,
+      Search* hasher);
+
+  // Look the targets up in the digest index, one target per item. Returns
+  // the number of hashes.
+  template <typename Search>
+  uint64_t searchIndex(unsigned threadnumber);
+
+  // Number of work items per target of a lookup, every item looks for the
+  // target in as many columns as the kernel has lanes.
+  uint64_t columnBlocks() const;
+
+  // Generate the chunks of chains or look up the targets in the table.
+  // Returns the number of hashes.
+  template <typename Search>
+  uint64_t searchTable(unsigned threadnumber);
+
+  // Whether only a part of the keyspace is searched.
+  bool isPartial() const;
+
+  // The generator for the combinations of this length, from the mask or
+  // from the allowed characters.
+  CandidateGenerator generator(unsigned length) const;
+  FRIEND_TEST(HashFinderTest, processMask);
+
+  // Search the combinations start to stop - 1 of the given length.
+  // Returns the number of combinations tried. The loops below are chosen
+  // once per chunk, they have the word layout as template arguments.
+  template <typename Search>
+  uint64_t searchCombinations(unsigned threadnumber, const TargetSet& lookup,
+      unsigned length, uint64_t start, uint64_t stop);
+
+  // Prefix batches of the combinations of words (at start), only word
+  // kWord differs between the lanes.
+  template <typename Search, unsigned kWord>
+  uint64_t searchRuns(unsigned threadnumber, const TargetSet& lookup,
+      CandidateGenerator* words, uint64_t start, uint64_t stop);
+
+  // Batches of whole blocks, kDataWords words hold the characters.
+  template <typename Search, unsigned kDataWords>
+  uint64_t searchBatches(unsigned threadnumber, const TargetSet& lookup,
+      CandidateGenerator* words, uint64_t start, uint64_t stop);
+
+  // Report the lanes set in mask of a batch of the combinations from first
+  // on.
+  void foundInLanes(unsigned threadnumber, uint32_t mask, const int* targets,
+      unsigned length, uint64_t first);
+
+  // Number of candidates hashed at once by the selected kernel.
+  unsigned laneCount() const;
+
+  // Hash the first nFilled lanes of the block with the selected kernel.
+  // Bit j of the result is set if lane j is one of the targets in lookup,
+  // its index is stored in targets[j]. With a prefix only its varying word
+  // is read from the block.
+  template <typename Search>
+  uint32_t matchLanes(const TargetSet& lookup, const LaneBlock& block,
+      unsigned nFilled, int* targets, const LanePrefix* prefix = NULL) const;
+
+  // Hash the n long words stored back to back in arena with hashBatch() of
+  // the algorithm and report the ones in lookup.
+  template <typename Search>
+  void matchLong(unsigned threadnumber, const TargetSet& lookup,
+      const string& arena, const size_t* lengths, unsigned n,
+      Search* hasher);
+
+  // Push the word for the target to the reporter, the first word found is
+  // saved as _collision. Unless we find all words, targets found by another
+  // thread before are ignored and the threads stop after the last target.
+  void foundCollision(unsigned threadnumber, const string& word, int target);
+
+  // Print the results in the queue and move them to _results.
+  void drainResults();
+
+  // Print the status since the sample before and append it to the JSON
+  // file.
+  void printStatus(const Stats::Sample& before, const Stats::Sample& now,
+      bool print);
 
   // The hash string we will be searching for.
   const char* _hashToFind;
 
+  // The file with the hashes to find, one per line.
+  const char* _hashFileName;
+
+  // All hashes as raw state words, compared after the last transform.
+  TargetSet _targets;
+
   // If we are not searching for an MD5 collision we want to try SHA1.
   bool _md5;
 
+  // The MD5 kernel, hashing 1, 4, 8 or 16 candidates at once.
+  MD5Simd::Kernel _kernel;
+
+  // The SHA-1 kernel, multi-lane or SHA extensions.
+  SHA1Simd::Kernel _sha1Kernel;
+
+  // Whether the kernel was chosen with --kernel instead of detected.
+  bool _kernelSelected;
+
   // Save the allowed characters into the following string.
   // If empty, we will try words from the dictionary.
   const char* _allowedCharacters;
 
+  // The mask, its custom charsets and the characters of every position.
+  const char* _maskString;
+  const char* _customCharsets[Mask::kCustomCharsets];
+  Mask _mask;
+
+  // The rules applied to every word of the dictionary.
+  const char* _rulesFileName;
+  RuleEngine _rules;
+
+  // Candidates of the rules dropped for being longer than
+  // RuleEngine::kMaxWord.
+  std::atomic<uint64_t> _rejectedWords;
+
   // Specify the length of the word to search for.
   int _minLength;
   int _maxLength;
@@ -77,12 +408,87 @@ class HashFinder {
   // The filename of the dictionary to use.
   const char* _inputFileName;
 
-  // The words from the dictionary (if specified).
-  vector<string> _dictionary;
+  // Read the dictionary while hashing instead of mapping it.
+  bool _stream;
+
+  // The dictionary if it is streamed, also used if it cannot be mapped.
+  WordStream _wordStream;
+
+  // The dictionary file mapped into memory.
+  MappedDictionary _mappedDictionary;
+
+  // Hands out the chunks of work to the threads.
+  Scheduler _scheduler;
+
+  // The part of the keyspace searched by this process: the candidates
+  // after _skip, at most _limit of them, cut into _shards parts.
+  uint64_t _shard;
+  uint64_t _shards;
+  uint128_t _skip;
+  uint128_t _limit;
+
+  // The whole keyspace and the planned range, set by planWork().
+  uint128_t _keyspace;
+  uint128_t _rangeBegin;
+  uint128_t _rangeEnd;
+
+  // This variable is filled with the first collision found.
+  std::atomic<char*> _collision;
+
+  // Set once all targets are found, the threads check it once per batch.
+  std::atomic<bool> _stop;
+
+  // Whether to search the whole keyspace for every matching word.
+  bool _findAll;
+
+  // The workers push their collisions, the reporter prints them.
+  ResultQueue _resultQueue;
+  std::atomic<bool> _reporting;
+
+  // All results printed by the reporter.
+  vector<Result> _results;
+
+  // Hashes and work done by every worker, sampled by the reporter.
+  Stats _stats;
+
+  // Seconds between two status lines, 0 if there are none.
+  int _statusInterval;
+
+  // The file the status is appended to as JSON lines, or NULL.
+  const char* _statusJsonFileName;
+  FILE* _statusJson;
+
+  // The file the checkpoint is saved to and the file it is restored from,
+  // restoring saves to the same file unless another one is given.
+  const char* _checkpointFileName;
+  const char* _restoreFileName;
+
+  // The chunks done by the workers.
+  Checkpoint _checkpoint;
+
+  // The CPUs of the machine and the ones the workers run on.
+  Topology _topology;
+  vector<Topology::Cpu> _workers;
+  bool _pin;
+  bool _noSmt;
+
+  // The rainbow table to generate and its size, or the one to look up.
+  const char* _generateTableName;
+  const char* _tableFileName;
+  uint64_t _chainCount;
+  unsigned _chainLength;
+  RainbowTable _table;
+
+  // The chains generated, one per item of the scheduler.
+  vector<RainbowTable::Chain> _chains;
+
+  // The digest index of the dictionary to build or to look up.
+  const char* _buildIndexName;
+  const char* _indexFileName;
+  DigestIndex _index;
 
-  // This variable is filled if a collision is found.
-  // The threads should be canceled at this time.
-  char* _collision;
+  // One copy of the read-only data per NUMA node, NULL on a single node.
+  std::unique_ptr<NodeReplica[]> _replicas;
 };
 
 #endif  // PROJEKT_HASHFINDER_H_
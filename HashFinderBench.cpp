@@ -0,0 +1,314 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+// Microbenchmarks of the hash functions, the batch kernels, the batch API
+// and the candidate generator. Every measurement is warmed up, calibrated
+// to take at least kMinRunTime and then repeated kRepetitions times, the
+// median and the spread of the repetitions are reported.
+//
+// usage: ./HashFinderBench [filter], only benchmarks whose name contains
+//        the filter are run
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "./CandidateGenerator.h"
+#include "./algorithms/MD5.h"
+#include "./algorithms/MD5Simd.h"
+#include "./algorithms/SHA1.h"
+#include "./algorithms/SHA1Simd.h"
+
+using std::string;
+using std::vector;
+
+// the shortest time a single repetition may take, in nanoseconds
+static const double kMinRunTime = 5e6;
+static const unsigned kRepetitions = 7;
+
+// multi-block lengths after the single block ones from 1 to 55
+static const size_t kLongLengths[] = { 64, 119, 256, 1024 };
+
+// results go here, so the compiler cannot drop the work
+static volatile uint32_t sink;
+
+// Statistics of the repetitions in nanoseconds per operation.
+struct Timing {
+  double median;
+  double min;
+  double max;
+};
+
+// Time body(n) for n operations: one warmup run, n is doubled until a run
+// takes kMinRunTime, then kRepetitions runs are measured.
+template <typename Body>
+static Timing measure(Body body) {
+  typedef std::chrono::steady_clock Clock;
+  uint64_t n = 1;
+  double elapsed = 0;
+  body(n);
+  while (true) {
+    Clock::time_point start = Clock::now();
+    body(n);
+    elapsed = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count();
+    if (elapsed >= kMinRunTime) break;
+    n *= 2;
+  }
+
+  vector<double> runs(kRepetitions);
+  for (unsigned r = 0; r < kRepetitions; r++) {
+    Clock::time_point start = Clock::now();
+    body(n);
+    runs[r] = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / n;
+  }
+  std::sort(runs.begin(), runs.end());
+  Timing timing = { runs[kRepetitions / 2], runs[0], runs[kRepetitions - 1] };
+  return timing;
+}
+
+static const char* filter = "";
+
+// Whether the benchmark is selected by the filter of the command line.
+static bool selected(const string& name) {
+  return name.find(filter) != string::npos;
+}
+
+// One line per measurement: name, ns per hash, hashes per second and the
+// spread of the repetitions relative to the median.
+template <typename Body>
+static void run(const string& name, Body body) {
+  if (!selected(name)) return;
+  Timing t = measure(body);
+  printf("%-36s %10.2f ns/hash %12.0f hashes/s  +-%4.1f%%\n", name.c_str(),
+      t.median, 1e9 / t.median, 50 * (t.max - t.min) / t.median);
+  fflush(stdout);
+}
+
+// the lengths of every per length benchmark
+static vector<size_t> lengths(bool multiBlock) {
+  vector<size_t> result;
+  for (size_t length = 1; length <= MD5::kMaxSingleBlock; length++) {
+    result.push_back(length);
+  }
+  if (multiBlock) {
+    result.insert(result.end(), kLongLengths,
+        kLongLengths + sizeof(kLongLengths) / sizeof(kLongLengths[0]));
+  }
+  return result;
+}
+
+static string named(const char* prefix, size_t length) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s/%zu", prefix, length);
+  return name;
+}
+
+// The compression function through the public interface: update() with
+// whole 64 byte blocks compresses every block once, only copying it into
+// the buffer of the hash first.
+static void benchBlock() {
+  char block[64];
+  memset(block, 'x', sizeof(block));
+  run("md5/block", [&](uint64_t n) {
+    MD5 md5;
+    for (uint64_t i = 0; i < n; i++) {
+      block[0] = i;
+      md5.update(block, sizeof(block));
+    }
+    sink = md5.finalize().rawdigest()[0];
+  });
+  run("sha1/block", [&](uint64_t n) {
+    SHA1 sha1;
+    for (uint64_t i = 0; i < n; i++) {
+      block[0] = i;
+      sha1.update(block, sizeof(block));
+    }
+    sink = sha1.finalize().rawdigest()[0];
+  });
+}
+
+// reset(), update() and finalize() through the HashAlgorithm interface,
+// like the dictionary search does for long words
+static void benchUpdate() {
+  vector<size_t> all = lengths(true);
+  for (size_t i = 0; i < all.size(); i++) {
+    const string message(all[i], 'x');
+    run(named("md5/update", all[i]), [&](uint64_t n) {
+      MD5 md5;
+      HashAlgorithm* hash = &md5;
+      for (uint64_t k = 0; k < n; k++) {
+        hash->reset();
+        hash->update(message.data(), message.size());
+        hash->finalize();
+      }
+      sink = hash->rawdigest()[0];
+    });
+  }
+  for (size_t i = 0; i < all.size(); i++) {
+    const string message(all[i], 'x');
+    run(named("sha1/update", all[i]), [&](uint64_t n) {
+      SHA1 sha1;
+      HashAlgorithm* hash = &sha1;
+      for (uint64_t k = 0; k < n; k++) {
+        hash->reset();
+        hash->update(message.data(), message.size());
+        hash->finalize();
+      }
+      sink = hash->rawdigest()[0];
+    });
+  }
+  for (size_t i = 0; i < MD5::kMaxSingleBlock; i++) {
+    const string message(i + 1, 'x');
+    run(named("md5/single-block", i + 1), [&](uint64_t n) {
+      uint32_t state[4];
+      for (uint64_t k = 0; k < n; k++) {
+        MD5::digestSingleBlock(message.data(), message.size(), state);
+      }
+      sink = state[0];
+    });
+  }
+}
+
+// hashBatch() with batches of kBatch messages of the same length, reported
+// per message
+static void benchBatch() {
+  const size_t kBatch = 64;
+  vector<size_t> all = lengths(true);
+  for (unsigned algorithm = 0; algorithm < 2; algorithm++) {
+    MD5 md5;
+    SHA1 sha1;
+    HashAlgorithm* hash = algorithm == 0 ? static_cast<HashAlgorithm*>(&md5)
+        : static_cast<HashAlgorithm*>(&sha1);
+    for (size_t i = 0; i < all.size(); i++) {
+      const string arena(kBatch * all[i], 'x');
+      const vector<size_t> sizes(kBatch, all[i]);
+      vector<uint32_t> digests(kBatch * hash->digestWords());
+      run(named(algorithm == 0 ? "md5/batch" : "sha1/batch", all[i]),
+          [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k += kBatch) {
+          hash->hashBatch(arena.data(), &sizes[0], kBatch, &digests[0]);
+        }
+        sink = digests[0];
+      });
+    }
+  }
+}
+
+// formatting the digest of a finalized hash
+static void benchHexdigest() {
+  MD5 md5("hexdigest");
+  SHA1 sha1("hexdigest");
+  run("md5/hexdigest", [&](uint64_t n) {
+    for (uint64_t k = 0; k < n; k++) sink = md5.hexdigest().size();
+  });
+  run("sha1/hexdigest", [&](uint64_t n) {
+    for (uint64_t k = 0; k < n; k++) sink = sha1.hexdigest().size();
+  });
+}
+
+// the batch kernels, reported per message and not per call
+static void benchKernels() {
+  const MD5Simd::Kernel kMD5[] = { MD5Simd::kScalar, MD5Simd::kSSE2,
+    MD5Simd::kAVX2, MD5Simd::kAVX512 };
+  const SHA1Simd::Kernel kSHA1[] = { SHA1Simd::kScalar, SHA1Simd::kSSE2,
+    SHA1Simd::kAVX2, SHA1Simd::kAVX512, SHA1Simd::kSHANI };
+  const uint32_t kTarget[5] = { 0, 0, 0, 0, 0 };
+  LaneBlock block;
+  for (unsigned i = 0; i < 4; i++) {
+    if (!MD5Simd::supported(kMD5[i])) continue;
+    const unsigned kLanes = MD5Simd::lanes(kMD5[i]);
+    for (unsigned j = 0; j < kMaxLanes; j++) {
+      MD5Simd::setLane(&block, j, "password", 8);
+    }
+    run(string("md5/match/") + MD5Simd::name(kMD5[i]), [&](uint64_t n) {
+      uint32_t mask = 0;
+      for (uint64_t k = 0; k < n; k += kLanes) {
+        block.words[0][0] = k;
+        mask |= MD5Simd::match(kMD5[i], block, kTarget);
+      }
+      sink = mask;
+    });
+    LanePrefix prefix;
+    uint32_t shared[16];
+    for (unsigned w = 0; w < 16; w++) shared[w] = block.words[w][0];
+    MD5Simd::prepare(shared, 1, &prefix);
+    run(string("md5/match-prefix/") + MD5Simd::name(kMD5[i]),
+        [&](uint64_t n) {
+      uint32_t mask = 0;
+      for (uint64_t k = 0; k < n; k += kLanes) {
+        block.words[1][0] = k;
+        mask |= MD5Simd::matchPrefix(kMD5[i], prefix, block, kTarget);
+      }
+      sink = mask;
+    });
+  }
+  for (unsigned i = 0; i < 5; i++) {
+    if (!SHA1Simd::supported(kSHA1[i])) continue;
+    const unsigned kLanes = SHA1Simd::lanes(kSHA1[i]);
+    for (unsigned j = 0; j < kMaxLanes; j++) {
+      SHA1Simd::setLane(&block, j, "password", 8);
+    }
+    run(string("sha1/match/") + SHA1Simd::name(kSHA1[i]), [&](uint64_t n) {
+      uint32_t mask = 0;
+      for (uint64_t k = 0; k < n; k += kLanes) {
+        block.words[0][0] = k;
+        mask |= SHA1Simd::match(kSHA1[i], block, kTarget);
+      }
+      sink = mask;
+    });
+    LanePrefix prefix;
+    uint32_t shared[16];
+    for (unsigned w = 0; w < 16; w++) shared[w] = block.words[w][0];
+    SHA1Simd::prepare(shared, 1, &prefix);
+    run(string("sha1/match-prefix/") + SHA1Simd::name(kSHA1[i]),
+        [&](uint64_t n) {
+      uint32_t mask = 0;
+      for (uint64_t k = 0; k < n; k += kLanes) {
+        block.words[1][0] = k;
+        mask |= SHA1Simd::matchPrefix(kSHA1[i], prefix, block, kTarget);
+      }
+      sink = mask;
+    });
+  }
+}
+
+// The generator steps of HashFinder::searchCombinations without hashing:
+// next() and copying the combination into the lanes of a batch.
+static void benchGenerator() {
+  const char* kCharacters = "abcdefghijklmnopqrstuvwxyz0123456789";
+  vector<size_t> single = lengths(false);
+  for (size_t i = 0; i < single.size(); i++) {
+    CandidateGenerator words(kCharacters, single[i],
+        CandidateGenerator::kLittleEndian);
+    LaneBlock block;
+    words.fillLanes(&block);
+    run(named("generator/next", single[i]), [&](uint64_t n) {
+      unsigned lane = 0;
+      for (uint64_t k = 0; k < n; k++) {
+        words.copyToLane(&block, lane);
+        lane = (lane + 1) & (kMaxLanes - 1);
+        words.next();
+      }
+      sink = block.words[0][0];
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) filter = argv[1];
+  printf("%d repetitions of at least %.0f ms each, median and spread "
+      "(generator/ counts candidates instead of hashes)\n",
+      kRepetitions, kMinRunTime / 1e6);
+  benchBlock();
+  benchKernels();
+  benchUpdate();
+  benchBatch();
+  benchHexdigest();
+  benchGenerator();
+  return 0;
+}
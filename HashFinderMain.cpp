@@ -3,32 +3,46 @@
 // Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
 
 
+#include <string.h>
+#include <string>
 #include <thread>
-#include <sys/sysinfo.h>
+#include "./Daemon.h"
 #include "./HashFinder.h"
 
-unsigned possibleThreadCount() {
-  #if defined(PTW32_VERSION) || defined(__hpux)
-  return pthread_num_processors_np();
-  #elif defined(__APPLE__) || defined(__FreeBSD__)
-  int count;
-  size_t size = sizeof(count);
-  return sysctlbyname("hw.ncpu", &count, &size, NULL, 0) ? 0 : count;
-  #elif defined(BOOST_HAS_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
-  int const count = sysconf(_SC_NPROCESSORS_ONLN);
-  return (count > 0) ? count : 1;
-  #elif defined(_GNU_SOURCE)
-  return get_nprocs();
-  #else
-  return 1;
-  #endif
-}
-
 // Main function.
 int main(int argc, char** argv) {
+  // a daemon keeps the searches resident and takes jobs from a socket
+  if (argc == 2 && strncmp(argv[1], "--daemon=", 9) == 0) {
+    Daemon daemon;
+    std::string error;
+    if (!daemon.listen(argv[1] + 9, &error)) {
+      fprintf(stderr, "<daemon> %s %s.\n", argv[1] + 9, error.c_str());
+      return 1;
+    }
+    printf("[Main] Waiting for jobs on %s.\n", argv[1] + 9);
+    fflush(stdout);
+    daemon.serve();
+    return 0;
+  }
+  // the other arguments are sent to the daemon as a job
+  if (argc > 2 && strncmp(argv[1], "--submit=", 9) == 0) {
+    std::string job;
+    for (int i = 2; i < argc; i++) {
+      if (i > 2) job += " ";
+      job += argv[i];
+    }
+    std::string answer, error;
+    if (!Daemon::submit(argv[1] + 9, job, &answer, &error)) {
+      fprintf(stderr, "<submit> %s %s.\n", argv[1] + 9, error.c_str());
+      return 1;
+    }
+    printf("%s", answer.c_str());
+    return answer.compare(0, 6, "error:") == 0 ? 1 : 0;
+  }
+
   HashFinder hashfinder;
   hashfinder.parseCommandLineArguments(argc, argv);
-  // we must read the dictionary in to a vector,
+  // we must map or open the dictionary,
   // before being able to distribute the work to the different threads
   if (!hashfinder.readDictionary()) {
     printf("[Main] Error reading the dictionary file.\n");
@@ -37,22 +51,37 @@ int main(int argc, char** argv) {
 
   hashfinder.printConfiguration();
 
-  static const unsigned kThreadCount = possibleThreadCount();
-  // static const unsigned kThreadCount = 1;
+  // the CPUs we may use, not all CPUs of the machine
+  const unsigned kThreadCount = hashfinder.threadCount();
   std::thread t[kThreadCount];
   std::cout << "[Main] I will start " << kThreadCount << " threads now.\n";
 
+  // the reporter prints the collisions while the workers keep searching
+  std::thread reporter(&HashFinder::report, std::ref(hashfinder));
+
+  // a streamed dictionary is read by its own thread while the workers hash
+  std::thread streamReader;
+  if (hashfinder.isStreaming()) {
+    streamReader = std::thread(&HashFinder::readStream, std::ref(hashfinder));
+  }
+
   // launch as many threads as possible, start with threadnumber 1
   for (unsigned i = 1; i <= kThreadCount; ++i) {
     // let's make these threads execute the processing...
-    t[i-1] = std::thread(&HashFinder::process, std::ref(hashfinder), i,
-      kThreadCount);
+    t[i-1] = std::thread(&HashFinder::process, std::ref(hashfinder), i);
   }
 
   // join the threads with the main thread
   for (unsigned i = 0; i < kThreadCount; ++i) {
     t[i].join();
   }
+  if (streamReader.joinable()) streamReader.join();
+  hashfinder.stopReport();
+  reporter.join();
+  hashfinder.printSummary();
+  // the chains of a rainbow table are merged once all are generated, the
+  // records of a digest index are sorted once all are hashed
+  if (!hashfinder.saveTable() || !hashfinder.saveIndex()) return 1;
   std::cout << "[Main] Regular shutdown.\n";
   std::cout << "[Main] Thank you for using this program!\n";
   return 0;
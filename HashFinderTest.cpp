@@ -2,12 +2,31 @@
 // Chair of Algorithms and Data Structures.
 // Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
 
+#include <fcntl.h>
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include "./BoundedQueue.h"
+#include "./CandidateGenerator.h"
+#include "./Checkpoint.h"
+#include "./Daemon.h"
+#include "./DigestIndex.h"
 #include "./HashFinder.h"
+#include "./Mask.h"
+#include "./RuleEngine.h"
+#include "./Stats.h"
+#include "./Topology.h"
+#include "./WordStream.h"
 
 // Test parsing the command line arguments
 TEST(HashFinderTest, parseCommandLineArguments) {
@@ -35,6 +54,10 @@ TEST(HashFinderTest, parseCommandLineArguments) {
     ASSERT_STREQ("abcdefghijklmnopqrstuvwxyz0123456789",
         hashfinder._allowedCharacters);
     ASSERT_STREQ("35e5d160921d131d9114f1b4ee5f9d55", hashfinder._hashToFind);
+    // MD5 state words are little endian
+    ASSERT_EQ(4, hashfinder._targets.words());
+    ASSERT_EQ(0x60d1e535u, hashfinder._targets.digest(0)[0]);
+    ASSERT_EQ(0x559d5feeu, hashfinder._targets.digest(0)[3]);
   }
 
   // Regular call with input-file option and a valid SHA-1-Hash
@@ -53,6 +76,21 @@ TEST(HashFinderTest, parseCommandLineArguments) {
         hashfinder._allowedCharacters);
     ASSERT_STREQ("586b64caacfbdfd67d2a8d323510ed5b72a61e0b",
         hashfinder._hashToFind);
+    // SHA-1 state words are big endian
+    ASSERT_EQ(5, hashfinder._targets.words());
+    ASSERT_EQ(0x586b64cau, hashfinder._targets.digest(0)[0]);
+    ASSERT_EQ(0x72a61e0bu, hashfinder._targets.digest(0)[4]);
+  }
+
+  // Call with a hash which is not a hex string
+  {
+    int argc = 2;
+    char* argv[2] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("35e5d160921d131d9114f1b4ee5f9dxx")
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*hex string.*");
   }
 
   // Regular call with algorithm option, characters and SHA-1
@@ -71,6 +109,92 @@ TEST(HashFinderTest, parseCommandLineArguments) {
     ASSERT_STREQ("586b64caacfbdfd67d2a8d323510ed5b72a61e0b",
         hashfinder._hashToFind);
   }
+
+  // Call with the scalar kernel and an unknown kernel
+  {
+    int argc = 3;
+    char* argv[3] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--kernel=scalar"),
+      const_cast<char*>("35e5d160921d131d9114f1b4ee5f9d55")
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(MD5Simd::kScalar, hashfinder._kernel);
+    argv[1] = const_cast<char*>("--kernel=mmx");
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*<kernel>.*");
+  }
+}
+
+// Test parsing invalid arguments without exiting
+TEST(HashFinderTest, parseArguments) {
+  HashFinder hashfinder;
+  string error;
+  {
+    int argc = 1;
+    char* argv[2] = { const_cast<char*>("HashFinderMain") };
+    ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+    ASSERT_EQ(0u, error.find("Usage:"));
+  }
+  int argc = 3;
+  char* argv[3] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--min-length=0"),
+    const_cast<char*>("35e5d160921d131d9114f1b4ee5f9d55")
+  };
+  ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+  ASSERT_EQ("<min-length> must be greater than 0.\n", error);
+  argv[1] = const_cast<char*>("--hash-file=notExisting.txt");
+  ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+  ASSERT_EQ("<hash-file> notExisting.txt cannot be read.\n", error);
+  argv[1] = const_cast<char*>("--shard=2/3");
+  ASSERT_TRUE(hashfinder.parseArguments(argc, argv, &error));
+  ASSERT_EQ(2u, hashfinder._shard);
+
+  // the options by their long names, without opening anything
+  {
+    int argc = 6;
+    char* argv[6] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("-i"),
+      const_cast<char*>("notExisting.txt"),
+      const_cast<char*>("35e5d160921d131d9114f1b4ee5f9d55"),
+      const_cast<char*>("--status-json=notExisting.json"),
+      const_cast<char*>("-A")
+    };
+    vector<string> options;
+    ASSERT_TRUE(HashFinder::canonicalOptions(argc, argv, &options));
+    ASSERT_EQ(4u, options.size());
+    ASSERT_EQ("input-file=notExisting.txt", options[0]);
+    ASSERT_EQ("status-json=notExisting.json", options[1]);
+    ASSERT_EQ("find-all", options[2]);
+    ASSERT_EQ("35e5d160921d131d9114f1b4ee5f9d55", options[3]);
+    ASSERT_NE(0, access("notExisting.json", F_OK));
+    argv[5] = const_cast<char*>("--unknown");
+    ASSERT_FALSE(HashFinder::canonicalOptions(argc, argv, &options));
+  }
+
+  // each reason a table cannot be generated has its own message
+  {
+    int argc = 4;
+    char* argv[4] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--generate-table=exampleTable.rt"),
+      const_cast<char*>("--max-length=56"),
+      const_cast<char*>("--characters=abc")
+    };
+    ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+    ASSERT_EQ("<max-length> must not be greater than 55.\n", error);
+    argv[2] = const_cast<char*>("--max-length=4");
+    argv[3] = const_cast<char*>("--characters=");
+    ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+    ASSERT_EQ("<characters> must not be empty.\n", error);
+    argv[2] = const_cast<char*>("--max-length=14");
+    argv[3] = const_cast<char*>("--characters=0123456789abcdef");
+    ASSERT_FALSE(hashfinder.parseArguments(argc, argv, &error));
+    ASSERT_EQ("<generate-table> must have less than 2^56 combinations.\n",
+        error);
+  }
 }
 
 // Test loading a dictionary-file
@@ -95,11 +219,44 @@ TEST(HashFinderTest, readDictionary) {
   ASSERT_TRUE(hashfinder.readDictionary());
   remove(testFileName);
 
+  // The file is mapped and not streamed
+  ASSERT_TRUE(hashfinder._mappedDictionary.isOpen());
+  ASSERT_FALSE(hashfinder.isStreaming());
+
   // Check if we have the same amount of entries as lines
-  ASSERT_EQ(hashfinder._dictionary.size(), 3);
+  vector<WordRef> words;
+  hashfinder._mappedDictionary.words(0, hashfinder._mappedDictionary.size(),
+      &words);
+  ASSERT_EQ(3u, words.size());
 
   // Check the first word of the dictionary
-  ASSERT_STREQ("Dauerschlaf", hashfinder._dictionary[0].c_str());
+  ASSERT_EQ("Dauerschlaf", string(words[0].data, words[0].length));
+  ASSERT_EQ("Schaufelrad", string(words[2].data, words[2].length));
+}
+
+// Test that every line is found in exactly one byte range
+TEST(MappedDictionaryTest, words) {
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  myfile << "a\nbc\n\ndef\nghij";
+  myfile.close();
+  MappedDictionary dictionary;
+  ASSERT_TRUE(dictionary.open(testFileName));
+  remove(testFileName);
+  ASSERT_EQ(14u, dictionary.size());
+
+  const char* kLines[] = { "a", "bc", "", "def", "ghij" };
+  for (uint64_t chunkSize = 1; chunkSize <= 15; chunkSize++) {
+    vector<WordRef> words;
+    for (uint64_t begin = 0; begin < dictionary.size(); begin += chunkSize) {
+      dictionary.words(begin, begin + chunkSize, &words);
+    }
+    ASSERT_EQ(5u, words.size());
+    for (unsigned i = 0; i < 5; i++) {
+      ASSERT_EQ(kLines[i], string(words[i].data, words[i].length));
+    }
+  }
+  ASSERT_FALSE(dictionary.open("notExisting.txt"));
 }
 
 // Test find MD5 and SHA1 in a dictionary file or in combinations
@@ -139,7 +296,7 @@ TEST(HashFinderTest, process) {
 
     // Now start processing and let's check if the _collision
     // variable has been filled with the right word
-    hashfinder.process(1, 1);
+    hashfinder.process(1);
     ASSERT_STREQ("hvl7", hashfinder._collision);
   }
 
@@ -163,8 +320,15 @@ TEST(HashFinderTest, process) {
 
     // Now start processing and let's check if the _collision
     // variable has been filled with the right word
-    hashfinder.process(1, 1);
+    hashfinder.process(1);
     ASSERT_STREQ("Radschaufel", hashfinder._collision);
+
+    // the last word of the dictionary is searched as well
+    argv[3] = const_cast<char*>("35eb43f62116728fb5f0eec48e77df6a");
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_TRUE(hashfinder.readDictionary());
+    hashfinder.process(1);
+    ASSERT_STREQ("Schaufelrad", hashfinder._collision);
   }
 
   {
@@ -187,7 +351,7 @@ TEST(HashFinderTest, process) {
 
     // Now start processing and let's check if the _collision
     // variable has been filled with the right word
-    hashfinder.process(1, 1);
+    hashfinder.process(1);
     ASSERT_STREQ("hvl7", hashfinder._collision);
   }
 
@@ -211,8 +375,1251 @@ TEST(HashFinderTest, process) {
 
     // Now start processing and let's check if the _collision
     // variable has been filled with the right word
-    hashfinder.process(1, 1);
+    hashfinder.process(1);
     ASSERT_STREQ("Radschaufel", hashfinder._collision);
   }
   remove(testFileName);
 }
+
+// Test counting up from a decoded index like an odometer
+TEST(CandidateGeneratorTest, seekAndNext) {
+  CandidateGenerator generator("abc", 5, CandidateGenerator::kLittleEndian);
+  ASSERT_EQ(243u, generator.keyspace());
+  ASSERT_EQ(1u, generator.lastWord());
+  ASSERT_EQ(3u, generator.lastWordKeyspace());
+  ASSERT_EQ("aaaaa", string(generator.word(), generator.length()));
+
+  // 1 * 27 + 2 * 3 + 2 = 35, the last position changes fastest
+  generator.seek(35);
+  ASSERT_EQ("abacc", string(generator.word(), 5));
+  ASSERT_TRUE(generator.next());
+  ASSERT_EQ("abbaa", string(generator.word(), 5));
+
+  // every combination once, then back to the start
+  generator.seek(0);
+  uint64_t n = 1;
+  while (generator.next()) n++;
+  ASSERT_EQ(generator.keyspace(), n);
+  ASSERT_EQ("aaaaa", string(generator.word(), 5));
+
+  // the block is padded, "ccccc" is 0x63 bytes followed by 0x80
+  generator.seek(242);
+  ASSERT_EQ(0x63636363u, generator.block()[0]);
+  ASSERT_EQ(0x8063u, generator.block()[1]);
+  ASSERT_EQ(40u, generator.block()[14]);
+  CandidateGenerator bigEndian("abc", 5, CandidateGenerator::kBigEndian);
+  bigEndian.seek(242);
+  ASSERT_EQ(0x63800000u, bigEndian.block()[1]);
+  ASSERT_EQ(40u, bigEndian.block()[15]);
+}
+
+// Test handing out chunks which never cross the end of a segment
+TEST(SchedulerTest, next) {
+  Scheduler scheduler;
+  Chunk chunk;
+  ASSERT_FALSE(scheduler.next(&chunk));
+
+  vector<uint64_t> segments;
+  segments.push_back(10);
+  segments.push_back(0);
+  segments.push_back(4);
+  scheduler.plan(segments, 4);
+  ASSERT_EQ(14u, scheduler.size());
+  const Chunk kExpected[] = { {0, 0, 4}, {0, 4, 8}, {0, 8, 10}, {2, 0, 4} };
+  for (unsigned i = 0; i < 4; i++) {
+    ASSERT_TRUE(scheduler.next(&chunk));
+    ASSERT_EQ(kExpected[i].segment, chunk.segment);
+    ASSERT_EQ(kExpected[i].begin, chunk.begin);
+    ASSERT_EQ(kExpected[i].end, chunk.end);
+  }
+  ASSERT_FALSE(scheduler.next(&chunk));
+}
+
+// Test skipping the chunks done by an earlier run
+TEST(SchedulerTest, restore) {
+  Scheduler scheduler;
+  vector<uint64_t> segments;
+  segments.push_back(10);
+  segments.push_back(0);
+  segments.push_back(4);
+  scheduler.plan(segments, 4);
+  ASSERT_EQ(4u, scheduler.chunks());
+  // chunks 0 and 2 are done, 1 and 3 are left
+  vector<uint64_t> done;
+  done.push_back(2);
+  ASSERT_EQ(4u + 2u, scheduler.restore(1, done));
+  Chunk chunk;
+  ASSERT_TRUE(scheduler.next(&chunk));
+  ASSERT_EQ(1u, chunk.index);
+  ASSERT_EQ(4u, chunk.begin);
+  ASSERT_TRUE(scheduler.next(&chunk));
+  ASSERT_EQ(3u, chunk.index);
+  ASSERT_EQ(2u, chunk.segment);
+  ASSERT_FALSE(scheduler.next(&chunk));
+
+  // planning again forgets the restored chunks
+  scheduler.plan(segments, 4);
+  ASSERT_EQ(14u, scheduler.restore(9, vector<uint64_t>()));
+  ASSERT_FALSE(scheduler.next(&chunk));
+}
+
+// Test planning a range of the keyspace and cutting it into shards
+TEST(SchedulerTest, shard) {
+  Scheduler scheduler;
+  vector<uint64_t> segments;
+  segments.push_back(10);
+  segments.push_back(0);
+  segments.push_back(4);
+  scheduler.plan(segments, 4, 8, 13);
+  ASSERT_EQ(5u, scheduler.size());
+  const Chunk kExpected[] = { {0, 8, 10}, {2, 0, 3} };
+  Chunk chunk;
+  for (unsigned i = 0; i < 2; i++) {
+    ASSERT_TRUE(scheduler.next(&chunk));
+    ASSERT_EQ(kExpected[i].segment, chunk.segment);
+    ASSERT_EQ(kExpected[i].begin, chunk.begin);
+    ASSERT_EQ(kExpected[i].end, chunk.end);
+  }
+  ASSERT_FALSE(scheduler.next(&chunk));
+
+  // the shards of 2^64 * 3 + 1 items cover it without gaps
+  const uint128_t kSize = (static_cast<uint128_t>(1) << 64) * 3 + 1;
+  uint128_t end = 0;
+  for (uint64_t i = 1; i <= 3; i++) {
+    uint128_t begin = 0;
+    uint128_t stop = kSize;
+    Scheduler::shard(i, 3, &begin, &stop);
+    ASSERT_TRUE(begin == end);
+    ASSERT_TRUE(stop - begin <= (static_cast<uint128_t>(1) << 64) + 1);
+    end = stop;
+  }
+  ASSERT_TRUE(end == kSize);
+
+  // with n close to 2^64 the shards of more than 2^64 items still meet,
+  // kSize * n would not fit into 128 bits
+  const uint64_t kN = UINT64_MAX;
+  const uint128_t kHuge = ~static_cast<uint128_t>(0) - 5;
+  const uint64_t kParts[] = { 1, 2, kN / 2, kN - 1, kN };
+  for (unsigned i = 0; i < 5; i++) {
+    uint128_t begin = 0;
+    uint128_t stop = kHuge;
+    Scheduler::shard(kParts[i], kN, &begin, &stop);
+    uint128_t nextBegin = 0;
+    uint128_t nextStop = kHuge;
+    if (kParts[i] < kN) {
+      Scheduler::shard(kParts[i] + 1, kN, &nextBegin, &nextStop);
+      ASSERT_TRUE(nextBegin == stop);
+    }
+    // the parts differ by at most one item
+    const uint128_t kPart = kHuge / kN;
+    ASSERT_TRUE(stop - begin == kPart || stop - begin == kPart + 1);
+  }
+  uint128_t begin = 0;
+  uint128_t stop = kHuge;
+  Scheduler::shard(kN, kN, &begin, &stop);
+  ASSERT_TRUE(stop == kHuge);
+  ASSERT_EQ("55340232221128654849", Scheduler::format(kSize));
+  ASSERT_EQ("0", Scheduler::format(0));
+}
+
+// Test completing chunks out of order and saving the state
+TEST(CheckpointTest, completeAndSave) {
+  const char* testFileName = "exampleCheckpoint.txt";
+  Checkpoint checkpoint;
+  checkpoint.start("md5 characters abc");
+  checkpoint.complete(2);
+  checkpoint.complete(4);
+  checkpoint.complete(1);
+  ASSERT_EQ(0u, checkpoint.first());
+  ASSERT_EQ(3u, checkpoint.done().size());
+  checkpoint.complete(0);
+  ASSERT_EQ(3u, checkpoint.first());
+  ASSERT_EQ(1u, checkpoint.done().size());
+  ASSERT_EQ(4u, checkpoint.done()[0]);
+  ASSERT_TRUE(checkpoint.save(testFileName));
+
+  Checkpoint restored;
+  string error;
+  restored.start("md5 characters abc");
+  ASSERT_TRUE(restored.load(testFileName, &error));
+  ASSERT_EQ(3u, restored.first());
+  ASSERT_EQ(checkpoint.done(), restored.done());
+  restored.complete(3);
+  ASSERT_EQ(5u, restored.first());
+  ASSERT_EQ(0u, restored.done().size());
+
+  // the state of another search is rejected
+  restored.start("sha1 characters abc");
+  ASSERT_FALSE(restored.load(testFileName, &error));
+  ASSERT_EQ("belongs to a different search", error);
+  remove(testFileName);
+  ASSERT_FALSE(restored.load(testFileName, &error));
+}
+
+// Test planning one segment per word length or for the dictionary
+TEST(HashFinderTest, planWork) {
+  HashFinder hashfinder;
+  int argc = 5;
+  char* argv[5] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--min-length=2"),
+    const_cast<char*>("--max-length=3"),
+    const_cast<char*>("--characters=abc"),
+    const_cast<char*>("35e5d160921d131d9114f1b4ee5f9d55")
+  };
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_EQ(9u + 27u, hashfinder._scheduler.size());
+
+  // a mapped dictionary is one segment of bytes
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  myfile << "word\nword\nword";
+  myfile.close();
+  hashfinder._inputFileName = testFileName;
+  ASSERT_TRUE(hashfinder.readDictionary());
+  remove(testFileName);
+  ASSERT_EQ(14u, hashfinder._scheduler.size());
+}
+
+// Test a different number of characters at every position
+TEST(CandidateGeneratorTest, mixedRadix) {
+  const char* kAlphabets[] = { "ab", "xyz", "01" };
+  CandidateGenerator generator(kAlphabets, 3,
+      CandidateGenerator::kLittleEndian);
+  ASSERT_EQ(12u, generator.keyspace());
+  // all three positions are in the first word of the block
+  ASSERT_EQ(0u, generator.lastWord());
+  ASSERT_EQ(12u, generator.lastWordKeyspace());
+
+  // 1 * 6 + 2 * 2 + 1 = 11, the last combination
+  generator.seek(11);
+  ASSERT_EQ("bz1", string(generator.word(), 3));
+  generator.seek(5);
+  ASSERT_EQ("az1", string(generator.word(), 3));
+  ASSERT_TRUE(generator.next());
+  ASSERT_EQ("bx0", string(generator.word(), 3));
+}
+
+// Test parsing masks with built-in and custom charsets
+TEST(MaskTest, parse) {
+  // repeated characters are only used once
+  const char* custom[Mask::kCustomCharsets] = { "?dab1", NULL, NULL, NULL };
+  Mask mask;
+  string error;
+  ASSERT_TRUE(mask.parse("?u?l-?1??", custom, &error));
+  ASSERT_EQ(5u, mask.length());
+  ASSERT_STREQ("ABCDEFGHIJKLMNOPQRSTUVWXYZ", mask.alphabets()[0]);
+  ASSERT_STREQ("-", mask.alphabets()[2]);
+  ASSERT_STREQ("0123456789ab", mask.alphabets()[3]);
+  ASSERT_STREQ("?", mask.alphabets()[4]);
+  ASSERT_EQ(26u * 26 * 12, mask.keyspace());
+
+  ASSERT_FALSE(mask.parse("?2", custom, &error));
+  ASSERT_FALSE(mask.parse("?x", custom, &error));
+  ASSERT_FALSE(mask.parse("ab?", custom, &error));
+  ASSERT_FALSE(mask.parse("", custom, &error));
+  ASSERT_FALSE(mask.parse("?a?a?a?a?a?a?a?a?a?a", custom, &error));
+}
+
+// Test finding a word in a mask with MD5 and SHA-1
+TEST(HashFinderTest, processMask) {
+  const char* kHashes[] = { "0567770265f0d889f49828f46b0d99cb",
+    "7abe407c0db7bcb8cdbaf087661e8d6b0b3c11ea" };  // Hv7!
+  for (unsigned i = 0; i < 2; i++) {
+    HashFinder hashfinder;
+    int argc = 5;
+    char* argv[5] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>(i == 0 ? "--hash-algo=md5" : "--hash-algo=sha1"),
+      const_cast<char*>("--mask=?u?l?d?1"),
+      const_cast<char*>("-1xyz!"),
+      const_cast<char*>(kHashes[i])
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(4, hashfinder._minLength);
+    ASSERT_EQ(4, hashfinder._maxLength);
+    ASSERT_EQ(26u * 26 * 10 * 4, hashfinder._scheduler.size());
+    hashfinder.process(1);
+    ASSERT_STREQ("Hv7!", hashfinder._collision);
+  }
+
+  // Call with an unknown charset
+  {
+    HashFinder hashfinder;
+    int argc = 3;
+    char* argv[3] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--mask=?u?2"),
+      const_cast<char*>(kHashes[0])
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*<mask>.*");
+  }
+}
+
+// Test MD5 and SHA-1 with every kernel the CPU supports
+TEST(HashFinderTest, processKernels) {
+  const char* kKernels[] = { "--kernel=scalar", "--kernel=sse2",
+    "--kernel=avx2", "--kernel=avx512" };
+  for (unsigned i = 0; i < 4; i++) {
+    MD5Simd::Kernel kernel;
+    ASSERT_TRUE(MD5Simd::parseKernel(kKernels[i] + 9, &kernel));
+    if (!MD5Simd::supported(kernel)) continue;
+
+    printf("Testing MD5 + combinations with %s...\n", kKernels[i] + 9);
+    HashFinder hashfinder;
+    int argc = 7;
+    char* argv[7] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--hash-algo=md5"),
+      const_cast<char*>("--min-length=3"),
+      const_cast<char*>("--max-length=4"),
+      const_cast<char*>("--characters=fhlvz79"),
+      const_cast<char*>(kKernels[i]),
+      const_cast<char*>("27b411b92e1ffa0250a1765b6fd152f2")  // hvl7
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(kernel, hashfinder._kernel);
+    hashfinder.process(1);
+    ASSERT_STREQ("hvl7", hashfinder._collision);
+  }
+
+  const char* kSHA1Kernels[] = { "--kernel=scalar", "--kernel=sse2",
+    "--kernel=avx2", "--kernel=avx512", "--kernel=sha-ni" };
+  for (unsigned i = 0; i < 5; i++) {
+    SHA1Simd::Kernel kernel;
+    ASSERT_TRUE(SHA1Simd::parseKernel(kSHA1Kernels[i] + 9, &kernel));
+    if (!SHA1Simd::supported(kernel)) continue;
+
+    printf("Testing SHA-1 + combinations with %s...\n", kSHA1Kernels[i] + 9);
+    HashFinder hashfinder;
+    int argc = 7;
+    char* argv[7] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>(kSHA1Kernels[i]),
+      const_cast<char*>("--hash-algo=sha1"),
+      const_cast<char*>("--min-length=3"),
+      const_cast<char*>("--max-length=4"),
+      const_cast<char*>("--characters=fhlvz79"),
+      const_cast<char*>("754174b26b4e39f5089da8a3fda7f752832b82a0")  // hvl7
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(kernel, hashfinder._sha1Kernel);
+    hashfinder.process(1);
+    ASSERT_STREQ("hvl7", hashfinder._collision);
+  }
+}
+
+// Test searching all hashes of a hash file in one pass
+TEST(HashFinderTest, processHashFile) {
+  // first write the test file, the last hash (zzzzz) is too long to be found
+  const char* testFileName = "exampleHashes.txt";
+  std::ofstream myfile(testFileName);
+  if (myfile.is_open()) {
+    myfile << "27b411b92e1ffa0250a1765b6fd152f2\n";  // hvl7
+    myfile << "ffb66116f90ad7f0e5047ce7381e3f91\n";  // f9z
+    myfile << "\n";
+    myfile << "d79c8788088c2193f0244d8f1f36d2db\r\n";  // 7777
+    myfile << "27b411b92e1ffa0250a1765b6fd152f2\n";  // hvl7 again
+    myfile << "95ebc3c7b3b9f1d2c40fec14415d3cb8\n";  // zzzzz
+    myfile.close();
+  } else {
+    printf("Unable to open exampleHashes for writing.\n");
+    FAIL();
+  }
+
+  const char* kKernels[] = { "--kernel=scalar", "--kernel=sse2",
+    "--kernel=avx2", "--kernel=avx512" };
+  for (unsigned i = 0; i < 4; i++) {
+    MD5Simd::Kernel kernel;
+    ASSERT_TRUE(MD5Simd::parseKernel(kKernels[i] + 9, &kernel));
+    if (!MD5Simd::supported(kernel)) continue;
+
+    printf("Testing MD5 + hash file with %s...\n", kKernels[i] + 9);
+    HashFinder hashfinder;
+    int argc = 6;
+    char* argv[6] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--hash-file=exampleHashes.txt"),
+      const_cast<char*>("--min-length=3"),
+      const_cast<char*>("--max-length=4"),
+      const_cast<char*>("--characters=fhlvz79"),
+      const_cast<char*>(kKernels[i])
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(4u, hashfinder._targets.size());
+    hashfinder.process(1);
+    // f9z has the shortest length and is found first
+    ASSERT_STREQ("f9z", hashfinder._collision);
+    ASSERT_EQ(1u, hashfinder._targets.remaining());
+  }
+
+  // Call with a line which is not a hash
+  {
+    std::ofstream badfile(testFileName);
+    badfile << "27b411b92e1ffa0250a1765b6fd152f2\nhvl7\n";
+    badfile.close();
+    HashFinder hashfinder;
+    int argc = 2;
+    char* argv[2] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--hash-file=exampleHashes.txt")
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*line 2.*");
+  }
+  remove(testFileName);
+}
+
+// Test reporting every matching word instead of stopping at the first one
+TEST(HashFinderTest, processFindAll) {
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  if (myfile.is_open()) {
+    myfile << "Radschaufel\n";
+    myfile << "Dauerschlaf\n";
+    myfile << "Radschaufel";
+    myfile.close();
+  } else {
+    printf("Unable to open exampleDictionary for writing.\n");
+    FAIL();
+  }
+
+  HashFinder hashfinder;
+  int argc = 4;
+  char* argv[4] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--input-file=exampleDictionary.txt"),
+    const_cast<char*>("--find-all"),
+    const_cast<char*>("af26c4895ba73daaf0c05c7700d13041")
+  };
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_TRUE(hashfinder._findAll);
+  ASSERT_TRUE(hashfinder.readDictionary());
+  hashfinder.process(1);
+  hashfinder.drainResults();
+  ASSERT_STREQ("Radschaufel", hashfinder._collision);
+  ASSERT_EQ(2u, hashfinder._results.size());
+  ASSERT_EQ("Radschaufel", hashfinder._results[1].word);
+  ASSERT_FALSE(hashfinder._stop);
+
+  // without --find-all the search stops after the first word
+  argv[2] = const_cast<char*>("--kernel=scalar");
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_TRUE(hashfinder.readDictionary());
+  hashfinder.process(1);
+  hashfinder.drainResults();
+  ASSERT_EQ(1u, hashfinder._results.size());
+  ASSERT_TRUE(hashfinder._stop);
+  remove(testFileName);
+}
+
+// Test the status of a search, the JSON file ends with the final numbers
+TEST(HashFinderTest, processStatus) {
+  const char* testFileName = "exampleStatus.json";
+  remove(testFileName);
+  HashFinder hashfinder;
+  int argc = 6;
+  char* argv[6] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--characters=abc"),
+    const_cast<char*>("--min-length=1"),
+    const_cast<char*>("--max-length=5"),
+    const_cast<char*>("--status-json=exampleStatus.json"),
+    const_cast<char*>("9dd4e461268c8034f5c8564e155c67a6")  // x
+  };
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_EQ(10, hashfinder._statusInterval);
+  std::thread reporter(&HashFinder::report, std::ref(hashfinder));
+  hashfinder.process(1);
+  hashfinder.stopReport();
+  reporter.join();
+  hashfinder.reset();
+
+  std::ifstream status(testFileName);
+  string line, last;
+  while (getline(status, line)) last = line;
+  // 3 + 9 + 27 + 81 + 243 combinations, all of them by thread 1
+  ASSERT_NE(string::npos, last.find("\"hashes\":363,"));
+  ASSERT_NE(string::npos, last.find("\"progress\":1.000000,\"eta\":0,"));
+  ASSERT_NE(string::npos, last.find("\"threads\":["));
+  remove(testFileName);
+
+  // a negative interval is an error
+  argv[4] = const_cast<char*>("--status=-1");
+  ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+      ".*<status>.*");
+}
+
+// Test continuing a search from a checkpoint
+TEST(HashFinderTest, processCheckpoint) {
+  const char* testFileName = "exampleCheckpoint.txt";
+  HashFinder hashfinder;
+  int argc = 6;
+  char* argv[6] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--characters=abc"),
+    const_cast<char*>("--min-length=1"),
+    const_cast<char*>("--max-length=5"),
+    const_cast<char*>("--checkpoint=exampleCheckpoint.txt"),
+    const_cast<char*>("9dd4e461268c8034f5c8564e155c67a6")  // x
+  };
+  // one chunk per length, a first run did lengths 1 and 4
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_EQ(5u, hashfinder._scheduler.chunks());
+  hashfinder._checkpoint.complete(3);
+  hashfinder._checkpoint.complete(0);
+  hashfinder.saveCheckpoint();
+
+  argv[4] = const_cast<char*>("--restore=exampleCheckpoint.txt");
+  hashfinder.parseCommandLineArguments(argc, argv);
+  std::thread reporter(&HashFinder::report, std::ref(hashfinder));
+  hashfinder.process(1);
+  hashfinder.stopReport();
+  reporter.join();
+  // only 9 + 27 + 243 combinations are left
+  ASSERT_EQ(279u, hashfinder._stats.sample().hashes);
+  ASSERT_EQ(5u, hashfinder._checkpoint.first());
+
+  // the checkpoint is saved when the search ends
+  Checkpoint saved;
+  string error;
+  saved.start(hashfinder.describeSearch());
+  ASSERT_TRUE(saved.load(testFileName, &error));
+  ASSERT_EQ(5u, saved.first());
+
+  // it does not fit other characters
+  argv[1] = const_cast<char*>("--characters=abcd");
+  ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+      ".*<restore>.*different search.*");
+  remove(testFileName);
+
+  // nor a dictionary or rules edited to the same size and count
+  const char* kDictionaryName = "exampleDictionary.txt";
+  const char* kRulesName = "exampleRules.txt";
+  std::ofstream(kDictionaryName) << "Dauerschlaf\nSchaufelrad\n";
+  std::ofstream(kRulesName) << "$1\n";
+  char* dictionaryArgv[5] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--input-file=exampleDictionary.txt"),
+    const_cast<char*>("--rules=exampleRules.txt"),
+    const_cast<char*>("--checkpoint=exampleCheckpoint.txt"),
+    const_cast<char*>("9dd4e461268c8034f5c8564e155c67a6")
+  };
+  hashfinder.parseCommandLineArguments(5, dictionaryArgv);
+  ASSERT_TRUE(hashfinder.readDictionary());
+  dictionaryArgv[3] = const_cast<char*>("--restore=exampleCheckpoint.txt");
+  hashfinder.parseCommandLineArguments(5, dictionaryArgv);
+  ASSERT_TRUE(hashfinder.readDictionary());
+
+  std::ofstream(kRulesName) << "$2\n";
+  hashfinder.parseCommandLineArguments(5, dictionaryArgv);
+  ASSERT_FALSE(hashfinder.readDictionary());
+
+  // the same size and inode, but another modification time
+  std::ofstream(kRulesName) << "$1\n";
+  std::ofstream(kDictionaryName) << "Schaufelrad\nDauerschlaf\n";
+  struct timespec times[2] = { { 0, UTIME_OMIT }, { 1, 0 } };
+  utimensat(AT_FDCWD, kDictionaryName, times, 0);
+  hashfinder.parseCommandLineArguments(5, dictionaryArgv);
+  ASSERT_FALSE(hashfinder.readDictionary());
+  remove(kDictionaryName);
+  remove(kRulesName);
+  remove(testFileName);
+}
+
+// Test searching shards and ranges of the keyspace
+TEST(HashFinderTest, processShard) {
+  HashFinder hashfinder;
+  int argc = 6;
+  char* argv[6] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--characters=abc"),
+    const_cast<char*>("--min-length=1"),
+    const_cast<char*>("--max-length=5"),
+    const_cast<char*>("--shard=1/3"),
+    const_cast<char*>("4124bc0a9335c27f086f24ba207a4912")  // aa
+  };
+  // 363 combinations in three shards of 121
+  const char* kShards[] = { "--shard=1/3", "--shard=2/3", "--shard=3/3" };
+  uint64_t total = 0;
+  for (unsigned i = 0; i < 3; i++) {
+    argv[4] = const_cast<char*>(kShards[i]);
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_TRUE(hashfinder._rangeBegin == total);
+    ASSERT_EQ(121u, hashfinder._scheduler.size());
+    total += hashfinder._scheduler.size();
+  }
+  ASSERT_EQ(363u, total);
+
+  // aa is the fourth of the length 2, after the 3 of length 1
+  argv[4] = const_cast<char*>("--skip=7");
+  hashfinder.parseCommandLineArguments(argc, argv);
+  hashfinder.process(1);
+  ASSERT_TRUE(hashfinder._collision.load() == NULL);
+  ASSERT_EQ(363u - 7u, hashfinder._stats.sample().hashes);
+  argv[4] = const_cast<char*>("--limit=4");
+  hashfinder.parseCommandLineArguments(argc, argv);
+  hashfinder.process(1);
+  ASSERT_STREQ("aa", hashfinder._collision.load());
+
+  argv[4] = const_cast<char*>("--shard=4/3");
+  ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+      ".*<shard>.*");
+  argv[4] = const_cast<char*>("--limit=0");
+  ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+      ".*<limit>.*");
+  // 36^13 combinations do not fit into 64 bits
+  argv[1] = const_cast<char*>("--min-length=13");
+  argv[2] = const_cast<char*>("--characters=abcdefghijklmnopqrstuvwxyz"
+      "0123456789");
+  argv[3] = const_cast<char*>("--max-length=13");
+  argv[4] = const_cast<char*>("--shard=1/1000");
+  ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+      ".*<max-length>.*");
+}
+
+// Write a file of a fake /sys or /proc tree, with all its directories.
+static void writeFakeFile(const string& path, const string& content) {
+  for (size_t slash = path.find('/'); slash != string::npos;
+      slash = path.find('/', slash + 1)) {
+    mkdir(path.substr(0, slash).c_str(), 0755);
+  }
+  std::ofstream file(path.c_str());
+  file << content << "\n";
+}
+
+// Test reading cores, nodes and quotas of two cores with two SMT siblings
+TEST(TopologyTest, detect) {
+  const string kRoot = "exampleTopology";
+  const char* kCores[] = { "0", "1", "0", "1" };
+  for (unsigned i = 0; i < 4; i++) {
+    const string kCpu = kRoot + "/sys/devices/system/cpu/cpu"
+        + string(1, '0' + i) + "/topology/";
+    writeFakeFile(kCpu + "core_id", kCores[i]);
+    writeFakeFile(kCpu + "physical_package_id", "0");
+  }
+  writeFakeFile(kRoot + "/sys/devices/system/node/node0/cpulist", "0,2");
+  writeFakeFile(kRoot + "/sys/devices/system/node/node1/cpulist", "1-1,3");
+  // a limit of 1.5 CPUs on the parent of our cgroup v2
+  writeFakeFile(kRoot + "/proc/self/cgroup", "0::/pod/worker");
+  writeFakeFile(kRoot + "/sys/fs/cgroup/pod/worker/cpu.max", "max 100000");
+  writeFakeFile(kRoot + "/sys/fs/cgroup/pod/cpu.max", "150000 100000");
+
+  vector<unsigned> allowed;
+  for (unsigned i = 0; i < 4; i++) allowed.push_back(3 - i);
+  Topology topology;
+  topology.detect(allowed, kRoot);
+  ASSERT_EQ(4u, topology.cpus().size());
+  ASSERT_EQ(2u, topology.cores());
+  ASSERT_EQ(2u, topology.nodes());
+  ASSERT_EQ(1u, topology.cpus()[3].node);
+  ASSERT_DOUBLE_EQ(1.5, topology.quota());
+  // the first CPU of both cores, the quota leaves no room for siblings
+  vector<Topology::Cpu> workers = topology.workers(false);
+  ASSERT_EQ(2u, workers.size());
+  ASSERT_EQ(0u, workers[0].id);
+  ASSERT_EQ(1u, workers[1].id);
+
+  // cgroup v1 without a quota, every CPU or one per core
+  writeFakeFile(kRoot + "/proc/self/cgroup", "4:cpu,cpuacct:/");
+  writeFakeFile(kRoot + "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "-1");
+  writeFakeFile(kRoot + "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us",
+      "100000");
+  topology.detect(allowed, kRoot);
+  ASSERT_EQ(0, topology.quota());
+  ASSERT_EQ(4u, topology.workers(false).size());
+  ASSERT_EQ(2u, topology.workers(true).size());
+  writeFakeFile(kRoot + "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us",
+      "300000");
+  topology.detect(allowed, kRoot);
+  ASSERT_DOUBLE_EQ(3, topology.quota());
+  ASSERT_EQ(3u, topology.workers(false).size());
+  ASSERT_EQ(2u, topology.workers(false)[2].id);
+  ASSERT_EQ(0, system(("rm -rf " + kRoot).c_str()));
+}
+
+// Test pinned workers searching the copies on their NUMA node
+TEST(HashFinderTest, processPinned) {
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  myfile << "first\nsecond\nthird";
+  myfile.close();
+  HashFinder hashfinder;
+  int argc = 4;
+  char* argv[4] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--input-file=exampleDictionary.txt"),
+    const_cast<char*>("--pin"),
+    const_cast<char*>("dd5c8bf51558ffcbe5007071908e9524")  // third
+  };
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_TRUE(hashfinder.readDictionary());
+  ASSERT_LE(1u, hashfinder.threadCount());
+  // pretend this is a multi-socket host
+  hashfinder._replicas.reset(new HashFinder::NodeReplica[
+      hashfinder._topology.nodes()]);
+  hashfinder.process(1);
+  remove(testFileName);
+  ASSERT_STREQ("third", hashfinder._collision.load());
+  const HashFinder::NodeReplica& replica =
+      hashfinder._replicas[hashfinder._workers[0].node];
+  ASSERT_EQ(1u, replica.targets.size());
+  ASSERT_EQ(0, memcmp("first\nsecond", replica.dictionary.get(), 12));
+
+  // new targets are copied again, the copy of the dictionary is kept
+  const char* dictionary = replica.dictionary.get();
+  vector<string> hashes;
+  hashes.push_back("8b04d5e3775d298e78455efc5ca404d5");  // first
+  hashes.push_back("dd5c8bf51558ffcbe5007071908e9524");  // third
+  string error;
+  ASSERT_TRUE(hashfinder.retarget(hashes, &error)) << error;
+  hashfinder.process(1);
+  ASSERT_EQ(2u, replica.targets.size());
+  ASSERT_EQ(dictionary, replica.dictionary.get());
+  hashfinder.stopReport();
+  hashfinder.report();
+  ASSERT_EQ(2u, hashfinder.collisions().size());
+}
+
+// Test counting the work of every thread and formatting the status
+TEST(StatsTest, sample) {
+  Stats stats;
+  stats.start(1000);
+  Stats::Sample before = stats.sample();
+  ASSERT_EQ(0u, before.hashes);
+  ASSERT_EQ(0u, before.threadHashes.size());
+
+  stats.add(1, 300, 100);
+  stats.add(3, 700, 400);
+  Stats::Sample now = stats.sample();
+  ASSERT_EQ(1000u, now.hashes);
+  ASSERT_EQ(500u, now.work);
+  ASSERT_EQ(3u, now.threadHashes.size());
+  ASSERT_EQ(300u, now.threadHashes[0]);
+  ASSERT_EQ(0u, now.threadHashes[1]);
+  ASSERT_EQ(700u, now.threadHashes[2]);
+
+  // half of the work is done
+  ASSERT_NE(string::npos, stats.format(before, now).find("50.0% done"));
+  ASSERT_NE(string::npos,
+      stats.formatJson(before, now).find("\"progress\":0.500000"));
+  ASSERT_EQ("12.34 MH/s", Stats::formatRate(12340000));
+  ASSERT_EQ("999.00 H/s", Stats::formatRate(999));
+
+  // without a total there is no progress
+  stats.start(0);
+  stats.add(1, 10, 10);
+  ASSERT_EQ(string::npos, stats.format(before, stats.sample()).find("%"));
+  ASSERT_NE(string::npos, stats.formatJson(before, stats.sample())
+      .find("\"progress\":null"));
+}
+
+// Test taking the results in the order they were pushed
+TEST(ResultQueueTest, pushAndPop) {
+  ResultQueue queue;
+  Result result;
+  ASSERT_FALSE(queue.pop(&result));
+  for (int i = 0; i < 3; i++) {
+    Result pushed = { 1, i, "word" };
+    queue.push(pushed);
+  }
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(queue.pop(&result));
+    ASSERT_EQ(i, result.target);
+    ASSERT_EQ("word", result.word);
+  }
+  ASSERT_FALSE(queue.pop(&result));
+}
+
+// Test reading the dictionary with a reader thread while hashing
+TEST(HashFinderTest, processStream) {
+  // more lines than fit into all buffers of the pool at once, a line longer
+  // than a buffer and one too long for a single block
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  for (unsigned i = 0; i < 4000000; i++) myfile << i << "\n";
+  myfile << string(WordStream::kBufferSize * 5 / 2, 'y') << "\n";
+  myfile << "Schaufelrad\n";
+  myfile << string(100, 'x');
+  myfile.close();
+
+  const char* kHashes[] = { "35eb43f62116728fb5f0eec48e77df6a",
+    "cd9749b6676c88510e205e65e027bd079abcbfba" };  // Schaufelrad
+  for (unsigned i = 0; i < 2; i++) {
+    HashFinder hashfinder;
+    int argc = 5;
+    char* argv[5] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--input-file=exampleDictionary.txt"),
+      const_cast<char*>(i == 0 ? "--hash-algo=md5" : "--hash-algo=sha1"),
+      const_cast<char*>("--stream"),
+      const_cast<char*>(kHashes[i])
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_TRUE(hashfinder.readDictionary());
+    ASSERT_TRUE(hashfinder.isStreaming());
+    std::thread reader(&HashFinder::readStream, std::ref(hashfinder));
+    hashfinder.process(1);
+    reader.join();
+    ASSERT_STREQ("Schaufelrad", hashfinder._collision);
+    ASSERT_EQ(1u, hashfinder._wordStream.skippedLines());
+  }
+  remove(testFileName);
+}
+
+// Test passing the lines of a pipe on before it is closed
+TEST(WordStreamTest, read) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  WordStream stream;
+  const string kPath = "/dev/fd/" + std::to_string(fds[0]);
+  ASSERT_TRUE(stream.open(kPath.c_str()));
+  std::atomic<bool> stop(false);
+  std::thread reader(&WordStream::read, &stream, std::cref(stop));
+  // a complete line comes through while the writer keeps the pipe open
+  ASSERT_EQ(15, write(fds[1], "Schaufelrad\nSch", 15));
+  WordBuffer* buffer = stream.take();
+  ASSERT_TRUE(buffer != NULL);
+  ASSERT_EQ("Schaufelrad\n", string(buffer->data, buffer->used));
+  stream.recycle(buffer);
+  // the incomplete line is passed on at the end
+  ASSERT_EQ(3, write(fds[1], "aft", 3));
+  close(fds[1]);
+  buffer = stream.take();
+  ASSERT_TRUE(buffer != NULL);
+  ASSERT_EQ("Schaft", string(buffer->data, buffer->used));
+  stream.recycle(buffer);
+  ASSERT_TRUE(stream.take() == NULL);
+  reader.join();
+  close(fds[0]);
+}
+
+// Test the ring buffer running full and empty
+TEST(BoundedQueueTest, pushAndPop) {
+  BoundedQueue<int> queue(3);
+  int value;
+  ASSERT_FALSE(queue.pop(&value));
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 4; i++) ASSERT_TRUE(queue.push(i));
+    ASSERT_FALSE(queue.push(4));
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(queue.pop(&value));
+      ASSERT_EQ(i, value);
+    }
+    ASSERT_FALSE(queue.pop(&value));
+  }
+}
+
+// Test compiling and applying every kind of rule
+TEST(RuleEngineTest, apply) {
+  RuleEngine rules;
+  string error;
+  const char* kRules[][2] = {
+    { ":", "Password" }, { "l", "password" }, { "u", "PASSWORD" },
+    { "c", "Password" }, { "C", "pASSWORD" }, { "t", "pASSWORD" },
+    { "T1", "PAssword" }, { "r", "drowssaP" }, { "d", "PasswordPassword" },
+    { "$1 $2", "Password12" }, { "^!", "!Password" }, { "'4", "Pass" },
+    { "[", "assword" }, { "]", "Passwor" }, { "sa@ so0 ss$", "P@$$w0rd" },
+    { "l sa@ u", "P@SSWORD" }, { "c so0 $1", "Passw0rd1" }
+  };
+  const unsigned kNumRules = sizeof(kRules) / sizeof(kRules[0]);
+  for (unsigned i = 0; i < kNumRules; i++) {
+    ASSERT_TRUE(rules.add(kRules[i][0], &error)) << error;
+  }
+  ASSERT_EQ(kNumRules, rules.size());
+  char out[RuleEngine::kMaxWord];
+  for (unsigned i = 0; i < kNumRules; i++) {
+    size_t length = rules.apply(i, "Password", 8, out);
+    ASSERT_EQ(kRules[i][1], string(out, length)) << kRules[i][0];
+  }
+
+  // words which would get too long are rejected
+  string longWord(RuleEngine::kMaxWord / 2 + 1, 'x');
+  ASSERT_EQ(RuleEngine::kRejected,
+      rules.apply(8, longWord.data(), longWord.size(), out));
+
+  ASSERT_FALSE(rules.add("x", &error));
+  ASSERT_FALSE(rules.add("$", &error));
+  ASSERT_FALSE(rules.add("T!", &error));
+  ASSERT_EQ(kNumRules, rules.size());
+}
+
+// Test applying a rule file to the dictionary
+TEST(HashFinderTest, processRules) {
+  const char* testFileName = "exampleDictionary.txt";
+  std::ofstream myfile(testFileName);
+  // the last word is too long for a single block
+  const string kLong =
+      "Donaudampfschifffahrtsgesellschaftskapitaenswitwenrentenauszahlung";
+  myfile << "Dauerschlaf\npassword\nSchaufelrad\n" << kLong;
+  myfile.close();
+  const char* rulesFileName = "exampleRules.txt";
+  std::ofstream rulesFile(rulesFileName);
+  rulesFile << "# leetspeak\n:\nc so0 $1\n\nr\n";
+  rulesFile.close();
+
+  const char* kHashes[] = { "c50c933b9c666a9b200170a1971ec5ab",  // Passw0rd1
+    "d50f3d3d525303997d705f86cd80182365f964ed",  // drowssap
+    "d17e70a1caa0bcbbff18be4a36b683fd",  // kLong reversed
+    "dd20f089e3175ea8db7316b62cd4ab6df4053018" };
+  const string kReversed(kLong.rbegin(), kLong.rend());
+  const string kWords[] = { "Passw0rd1", "drowssap", kReversed, kReversed };
+  for (unsigned i = 0; i < 4; i++) {
+    HashFinder hashfinder;
+    int argc = 5;
+    char* argv[5] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--input-file=exampleDictionary.txt"),
+      const_cast<char*>("--rules=exampleRules.txt"),
+      const_cast<char*>(i % 2 == 0 ? "--hash-algo=md5" : "--hash-algo=sha1"),
+      const_cast<char*>(kHashes[i])
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(3u, hashfinder._rules.size());
+    ASSERT_TRUE(hashfinder.readDictionary());
+    hashfinder.process(1);
+    ASSERT_STREQ(kWords[i].c_str(), hashfinder._collision);
+  }
+
+  // ':' passes a word longer than the rules take, the others count it
+  {
+    std::ofstream longFile(testFileName);
+    longFile << "Schaufelrad\n" << string(300, 'z') << "\n";
+    longFile.close();
+    std::ofstream longRules(rulesFileName);
+    longRules << ":\nr\n";
+    longRules.close();
+    HashFinder hashfinder;
+    int argc = 4;
+    char* argv[4] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--input-file=exampleDictionary.txt"),
+      const_cast<char*>("--rules=exampleRules.txt"),
+      const_cast<char*>("62a457719101124d52a9c4fe5211f52a")  // 300 z
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_TRUE(hashfinder.readDictionary());
+    hashfinder.process(1);
+    ASSERT_EQ(string(300, 'z'), hashfinder._collision.load());
+    ASSERT_EQ(1u, hashfinder._rejectedWords.load());
+  }
+
+  // Call with an invalid rule
+  {
+    std::ofstream badFile(rulesFileName);
+    badFile << ":\n$\n";
+    badFile.close();
+    HashFinder hashfinder;
+    int argc = 4;
+    char* argv[4] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--input-file=exampleDictionary.txt"),
+      const_cast<char*>("--rules=exampleRules.txt"),
+      const_cast<char*>(kHashes[0])
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*<rules> line 2.*");
+  }
+  remove(testFileName);
+  remove(rulesFileName);
+}
+
+// Test generating a rainbow table and looking hashes up in it
+TEST(HashFinderTest, processTable) {
+  const char* testFileName = "exampleTable.rt";
+  const char* kHashes[] = { "0cc175b9c0f1b6a831c399e269772661",
+    "86f7e437faa5a7fce15d1ddcb9eaeaea377667b8" };  // a
+  for (unsigned i = 0; i < 2; i++) {
+    HashFinder hashfinder;
+    int argc = 8;
+    char* argv[8] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>(i == 0 ? "--hash-algo=md5" : "--hash-algo=sha1"),
+      const_cast<char*>("--characters=abc"),
+      const_cast<char*>("--min-length=1"),
+      const_cast<char*>("--max-length=4"),
+      const_cast<char*>("--chain-length=20"),
+      const_cast<char*>("--generate-table=exampleTable.rt"),
+      const_cast<char*>("--chains=120")
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_EQ(120u, hashfinder._table.keyspace());
+    ASSERT_EQ(120u, hashfinder._scheduler.size());
+    hashfinder.process(1);
+    ASSERT_EQ(120u * 20, hashfinder._stats.sample().hashes);
+    ASSERT_TRUE(hashfinder.saveTable());
+    const size_t kChains = hashfinder._chains.size();
+    ASSERT_GE(120u, kChains);
+
+    // the table decides the characters and the lengths, chain 0 starting
+    // at the first combination is never merged away
+    argc = 4;
+    argv[2] = const_cast<char*>("--table=exampleTable.rt");
+    argv[3] = const_cast<char*>(kHashes[i]);
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_STREQ("abc", hashfinder._allowedCharacters);
+    ASSERT_EQ(4, hashfinder._maxLength);
+    ASSERT_EQ(kChains, hashfinder._table.chains());
+    hashfinder.process(1);
+    ASSERT_STREQ("a", hashfinder._collision);
+  }
+
+  // Call with a table of the other algorithm
+  {
+    HashFinder hashfinder;
+    int argc = 3;
+    char* argv[3] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--table=exampleTable.rt"),
+      const_cast<char*>(kHashes[0])
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*<table>.*SHA-1.*");
+  }
+  remove(testFileName);
+}
+
+// Test finding prefixes in an index of evenly spread and of equal digests
+TEST(DigestIndexTest, find) {
+  const char* testFileName = "exampleIndex.idx";
+  DigestIndex index;
+  index.start(false, 12345);
+  vector<DigestIndex::Record> records;
+  uint64_t prefix = 1;
+  for (uint64_t i = 0; i < 10000; i++) {
+    prefix = prefix * 6364136223846793005ULL + 1442695040888963407ULL;
+    DigestIndex::Record record = { prefix, i };
+    records.push_back(record);
+  }
+  // three words with the same digest
+  DigestIndex::Record same = { records[42].prefix, 10000 };
+  records.push_back(same);
+  same.offset = 10001;
+  records.push_back(same);
+  index.add(records);
+  string error;
+  ASSERT_TRUE(index.save(testFileName, &error));
+
+  DigestIndex loaded;
+  ASSERT_TRUE(loaded.load(testFileName, &error));
+  ASSERT_FALSE(loaded.md5());
+  ASSERT_EQ(12345u, loaded.dictionarySize());
+  ASSERT_EQ(10002u, loaded.size());
+  vector<uint64_t> offsets;
+  for (uint64_t i = 0; i < 10000; i++) {
+    offsets.clear();
+    loaded.find(records[i].prefix, &offsets);
+    ASSERT_EQ(i == 42 ? 3u : 1u, offsets.size());
+    ASSERT_EQ(i, offsets[0]);
+  }
+  offsets.clear();
+  loaded.find(0, &offsets);
+  loaded.find(~0ULL, &offsets);
+  ASSERT_EQ(0u, offsets.size());
+  remove(testFileName);
+}
+
+// Test building a digest index of a dictionary and looking hashes up in it
+TEST(HashFinderTest, processIndex) {
+  const char* testFileName = "exampleDictionary.txt";
+  const char* indexFileName = "exampleIndex.idx";
+  const string kLong(70, 'x');
+  std::ofstream dictionaryFile(testFileName);
+  dictionaryFile << "Dauerschlaf\nRadschaufel\n" << kLong << "\nSchaufelrad";
+  dictionaryFile.close();
+  const char* kHashes[] = { "35eb43f62116728fb5f0eec48e77df6a",  // Schaufelrad
+    "bbaad84b42630a80b935ff83a4804512d8ef59f3" };  // kLong
+  const string kWords[] = { "Schaufelrad", kLong };
+  for (unsigned i = 0; i < 2; i++) {
+    HashFinder hashfinder;
+    int argc = 4;
+    char* argv[4] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>(i == 0 ? "--hash-algo=md5" : "--hash-algo=sha1"),
+      const_cast<char*>("--input-file=exampleDictionary.txt"),
+      const_cast<char*>("--build-index=exampleIndex.idx")
+    };
+    hashfinder.parseCommandLineArguments(argc, argv);
+    ASSERT_TRUE(hashfinder.readDictionary());
+    hashfinder.process(1);
+    ASSERT_TRUE(hashfinder.saveIndex());
+    ASSERT_EQ(4u, hashfinder._index.size());
+
+    // every word is hashed once, looking it up only hashes the candidates
+    argv[3] = const_cast<char*>("--index=exampleIndex.idx");
+    argc = 5;
+    char* lookupArgv[5] = { argv[0], argv[1], argv[2], argv[3],
+      const_cast<char*>(kHashes[i]) };
+    hashfinder.parseCommandLineArguments(argc, lookupArgv);
+    ASSERT_TRUE(hashfinder.readDictionary());
+    ASSERT_EQ(1u, hashfinder._scheduler.size());
+    hashfinder.process(1);
+    ASSERT_STREQ(kWords[i].c_str(), hashfinder._collision);
+    ASSERT_EQ(1u, hashfinder._stats.sample().hashes);
+  }
+
+  // Call without a dictionary
+  {
+    HashFinder hashfinder;
+    int argc = 3;
+    char* argv[3] = {
+      const_cast<char*>("HashFinderMain"),
+      const_cast<char*>("--index=exampleIndex.idx"),
+      const_cast<char*>(kHashes[0])
+    };
+    ASSERT_DEATH(hashfinder.parseCommandLineArguments(argc, argv),
+        ".*<index> needs the dictionary.*");
+  }
+  remove(testFileName);
+  remove(indexFileName);
+}
+
+// Test searching the same candidates again for other hashes
+TEST(HashFinderTest, retarget) {
+  HashFinder hashfinder;
+  int argc = 5;
+  char* argv[5] = {
+    const_cast<char*>("HashFinderMain"),
+    const_cast<char*>("--characters=abc"),
+    const_cast<char*>("--min-length=1"),
+    const_cast<char*>("--max-length=3"),
+    const_cast<char*>("16ecfd64586ec6c1ab212762c2c38a90")  // cab
+  };
+  hashfinder.parseCommandLineArguments(argc, argv);
+  ASSERT_TRUE(hashfinder.isReusable());
+  hashfinder.process(1);
+  ASSERT_STREQ("cab", hashfinder._collision);
+
+  vector<string> hashes;
+  hashes.push_back("07159c47ee1b19ae4fb9c40d480856c4");  // ba
+  hashes.push_back("900150983CD24FB0D6963F7D28E17F72");  // abc
+  string error;
+  ASSERT_TRUE(hashfinder.checkTargets(hashes, &error));
+  ASSERT_TRUE(hashfinder.retarget(hashes, &error)) << error;
+  ASSERT_EQ(2u, hashfinder._targets.size());
+  ASSERT_EQ(39u, hashfinder._scheduler.size());
+  hashfinder.process(1);
+  hashfinder.stopReport();
+  hashfinder.report();
+  vector<std::pair<string, string> > collisions = hashfinder.collisions();
+  ASSERT_EQ(2u, collisions.size());
+  std::sort(collisions.begin(), collisions.end());
+  ASSERT_EQ("07159c47ee1b19ae4fb9c40d480856c4", collisions[0].first);
+  ASSERT_EQ("ba", collisions[0].second);
+  ASSERT_EQ("abc", collisions[1].second);
+
+  // a SHA-1 hash is no MD5 hash
+  hashes.push_back("86f7e437faa5a7fce15d1ddcb9eaeaea377667b8");
+  ASSERT_FALSE(hashfinder.checkTargets(hashes, &error));
+}
+
+// Test keeping the searches of the daemon for the next jobs
+TEST(DaemonTest, finder) {
+  Daemon daemon;
+  daemon._maxFinders = 2;
+  const string kHash = "16ecfd64586ec6c1ab212762c2c38a90";
+  const char* kOptions[] = {
+    "--characters=abc -a 1 -z 3",
+    "-z 3 --status=0 -c abc --min-length=1 --max-length 3",
+    "--characters=ab -a 1 -z 2",
+    "--characters=a -a 1 -z 1"
+  };
+  vector<string> options[4];
+  for (unsigned i = 0; i < 4; i++) {
+    std::istringstream stream(kOptions[i]);
+    string word;
+    while (stream >> word) options[i].push_back(word);
+  }
+  string error;
+  HashFinder* first = daemon.finder(options[0], kHash, &error);
+  ASSERT_TRUE(first != NULL) << error;
+  // the same candidates, written in another way
+  ASSERT_EQ(Daemon::key(options[0]), Daemon::key(options[1]));
+  ASSERT_EQ(first, daemon.finder(options[1], kHash, &error));
+  ASSERT_TRUE(daemon.finder(options[2], kHash, &error) != NULL);
+  ASSERT_EQ(2u, daemon._finders.size());
+
+  // the search used least recently makes room for a new one
+  ASSERT_EQ(first, daemon.finder(options[0], kHash, &error));
+  ASSERT_TRUE(daemon.finder(options[3], kHash, &error) != NULL);
+  ASSERT_EQ(2u, daemon._finders.size());
+  ASSERT_EQ(1u, daemon._finders.count(Daemon::key(options[0])));
+  ASSERT_EQ(0u, daemon._finders.count(Daemon::key(options[2])));
+}
+
+// Test batching jobs sent to the daemon at the same time
+TEST(DaemonTest, serve) {
+  const char* socketName = "exampleDaemon.sock";
+  Daemon daemon;
+  string error;
+  ASSERT_TRUE(daemon.listen(socketName, &error));
+  // the three valid jobs below are taken together, whenever they arrive,
+  // and a silent client is never given up
+  daemon._batchWindow = 0;
+  daemon._holdUntil = 3;
+  daemon._readTimeout = 3600;
+  std::thread server(&Daemon::serve, &daemon);
+
+  // a client which connects and sends nothing does not hold up the others
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketName);
+  int silent = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(silent, reinterpret_cast<struct sockaddr*>(&address),
+      sizeof(address)));
+
+  const string kJobs[] = {
+    "--characters=abc -a 1 -z 3 16ecfd64586ec6c1ab212762c2c38a90",
+    "--characters=abc -a 1 -z 3 07159c47ee1b19ae4fb9c40d480856c4 "
+        "9dd4e461268c8034f5c8564e155c67a6",
+    "--characters=abc -a 0 16ecfd64586ec6c1ab212762c2c38a90",
+    "--characters=abc"
+  };
+  string answers[4];
+  bool sent[4];
+  vector<std::thread> clients;
+  for (unsigned i = 0; i < 4; i++) {
+    clients.push_back(std::thread([&, i]() {
+      string clientError;
+      sent[i] = Daemon::submit(socketName, kJobs[i], &answers[i],
+          &clientError);
+    }));
+  }
+  for (unsigned i = 0; i < 4; i++) clients[i].join();
+  // all were answered while the silent client is still being read
+  {
+    std::lock_guard<std::mutex> lock(daemon._mutex);
+    ASSERT_EQ(1u, daemon._readers);
+    daemon._holdUntil = 0;
+  }
+  close(silent);
+  for (unsigned i = 0; i < 4; i++) ASSERT_TRUE(sent[i]);
+  ASSERT_EQ("16ecfd64586ec6c1ab212762c2c38a90:cab\n", answers[0]);
+  // x is not one of the characters
+  ASSERT_EQ("07159c47ee1b19ae4fb9c40d480856c4:ba\n"
+      "9dd4e461268c8034f5c8564e155c67a6\n", answers[1]);
+  ASSERT_EQ("error: <min-length> must be greater than 0.\n", answers[2]);
+  ASSERT_EQ(0u, answers[3].find("error: a job is"));
+  // jobs 0 and 1 have the same options and were answered by one pass
+  ASSERT_EQ(1u, daemon._passes.load());
+
+  // the search of the characters is still resident
+  ASSERT_TRUE(Daemon::submit(socketName, kJobs[0], &answers[0], &error));
+  ASSERT_EQ("16ecfd64586ec6c1ab212762c2c38a90:cab\n", answers[0]);
+  ASSERT_EQ(2u, daemon._passes.load());
+
+  // jobs write no files, and only the user of the daemon may send them
+  ASSERT_TRUE(Daemon::submit(socketName, "--characters=abc "
+      "--status-json=exampleStatus.json 16ecfd64586ec6c1ab212762c2c38a90",
+      &answers[0], &error));
+  ASSERT_EQ(0u, answers[0].find("error: <daemon> jobs cannot"));
+  ASSERT_NE(0, access("exampleStatus.json", F_OK));
+  struct stat info;
+  ASSERT_EQ(0, stat(socketName, &info));
+  ASSERT_EQ(static_cast<mode_t>(S_IRUSR | S_IWUSR), info.st_mode & 0777);
+  daemon.stop();
+  server.join();
+  ASSERT_EQ(1u, daemon._finders.size());
+}
@@ -0,0 +1,86 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "./MappedDictionary.h"
+
+// Constructor, no file mapped
+MappedDictionary::MappedDictionary()
+    : _open(false), _data(NULL), _size(0), _inode(0), _modified(0) {
+}
+
+// Destructor
+MappedDictionary::~MappedDictionary() {
+  close();
+}
+
+bool MappedDictionary::open(const char* fileName) {
+  close();
+  int fd = ::open(fileName, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+  _size = info.st_size;
+  _inode = info.st_ino;
+  _modified = info.st_mtim.tv_sec * 1000000000ULL + info.st_mtim.tv_nsec;
+  // an empty file cannot be mapped, but is a valid empty dictionary
+  if (_size > 0) {
+    void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      _size = 0;
+      return false;
+    }
+    // every range is read once from front to back
+    madvise(data, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(data);
+  }
+  // the mapping stays valid without the file descriptor
+  ::close(fd);
+  _open = true;
+  return true;
+}
+
+void MappedDictionary::copy(char* buffer) const {
+  memcpy(buffer, _data, _size);
+}
+
+void MappedDictionary::close() {
+  if (_data != NULL) munmap(const_cast<char*>(_data), _size);
+  _open = false;
+  _data = NULL;
+  _size = 0;
+}
+
+void MappedDictionary::lines(const char* data, uint64_t size,
+    uint64_t begin, uint64_t end, vector<WordRef>* words) {
+  if (end > size) end = size;
+  if (begin >= end) return;
+  const char* p = data + begin;
+  const char* stop = data + end;
+  const char* last = data + size;
+
+  // skip the rest of the line started in the range before
+  if (begin > 0 && data[begin - 1] != '\n') {
+    p = static_cast<const char*>(memchr(p, '\n', stop - p));
+    if (p == NULL) return;
+    p++;
+  }
+  // the last line of the range may reach into the next one
+  while (p < stop) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', last - p));
+    const char* lineEnd = newline != NULL ? newline : last;
+    WordRef word = { p, static_cast<size_t>(lineEnd - p) };
+    words->push_back(word);
+    p = lineEnd + 1;
+  }
+}
@@ -0,0 +1,74 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_MAPPEDDICTIONARY_H_
+#define PROJEKT_MAPPEDDICTIONARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+using std::vector;
+
+// A word inside a buffer owned by someone else, like a string_view.
+struct WordRef {
+  const char* data;
+  size_t length;
+};
+
+// A dictionary file mapped into memory. Nothing is copied and there is no
+// index of the whole file: the file is searched in byte ranges, and the
+// thread searching a range finds the lines in it itself. So indexing is
+// spread over all threads, hashing starts right away and the memory used
+// is the page cache of the file.
+//
+// A line belongs to the range it starts in, the last line may end without
+// a newline.
+class MappedDictionary {
+ public:
+  MappedDictionary();
+  ~MappedDictionary();
+
+  // Map the file, returns false if it cannot be mapped (e.g. a pipe).
+  bool open(const char* fileName);
+
+  // Unmap the file.
+  void close();
+
+  bool isOpen() const { return _open; }
+
+  // the bytes of the file and their number
+  const char* data() const { return _data; }
+  uint64_t size() const { return _size; }
+
+  // the inode and the modification time in nanoseconds of the file when it
+  // was mapped, an edited file has another time even at the same size
+  uint64_t inode() const { return _inode; }
+  uint64_t modified() const { return _modified; }
+
+  // Append the lines starting at byte begin to end - 1 to words.
+  void words(uint64_t begin, uint64_t end, vector<WordRef>* words) const {
+    lines(_data, _size, begin, end, words);
+  }
+
+  // The same for any buffer of the given size.
+  static void lines(const char* data, uint64_t size, uint64_t begin,
+      uint64_t end, vector<WordRef>* words);
+
+  // Copy the whole file to a buffer of size() bytes.
+  void copy(char* buffer) const;
+
+ private:
+  bool _open;
+  const char* _data;
+  uint64_t _size;
+  uint64_t _inode;
+  uint64_t _modified;
+
+  // no copies, the mapping belongs to exactly one object
+  MappedDictionary(const MappedDictionary&);
+  MappedDictionary& operator=(const MappedDictionary&);
+};
+
+#endif  // PROJEKT_MAPPEDDICTIONARY_H_
@@ -0,0 +1,116 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <string>
+#include <vector>
+#include "./Mask.h"
+
+namespace {
+const char kLower[] = "abcdefghijklmnopqrstuvwxyz";
+const char kUpper[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+const char kDigits[] = "0123456789";
+const char kSpecial[] = " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+// Remove repeated characters, the first one stays
+string unique(const string& characters) {
+  bool seen[256] = { false };
+  string result;
+  for (size_t i = 0; i < characters.size(); i++) {
+    unsigned char c = characters[i];
+    if (!seen[c]) result += characters[i];
+    seen[c] = true;
+  }
+  return result;
+}
+}  // namespace
+
+bool Mask::expand(const char* charset,
+    const char* const custom[kCustomCharsets], bool allowCustom,
+    string* out, string* error) {
+  for (const char* p = charset; *p != '\0'; p++) {
+    if (*p != '?') {
+      *out += *p;
+      continue;
+    }
+    p++;
+    switch (*p) {
+      case 'l': *out += kLower; break;
+      case 'u': *out += kUpper; break;
+      case 'd': *out += kDigits; break;
+      case 's': *out += kSpecial; break;
+      case 'a':
+        *out += kLower;
+        *out += kUpper;
+        *out += kDigits;
+        *out += kSpecial;
+        break;
+      case 'h': *out += "0123456789abcdef"; break;
+      case 'H': *out += "0123456789ABCDEF"; break;
+      case '?': *out += '?'; break;
+      case '1': case '2': case '3': case '4': {
+        const char* charset = custom[*p - '1'];
+        if (!allowCustom || charset == NULL) {
+          *error = string("charset ?") + *p + " is not defined";
+          return false;
+        }
+        // custom charsets may use the built-in ones, but not each other
+        if (!expand(charset, custom, false, out, error)) return false;
+        break;
+      }
+      case '\0':
+        *error = "a mask must not end with a single ?";
+        return false;
+      default:
+        *error = string("unknown charset ?") + *p;
+        return false;
+    }
+  }
+  return true;
+}
+
+bool Mask::parse(const char* mask, const char* const custom[kCustomCharsets],
+    string* error) {
+  _alphabets.clear();
+  for (const char* p = mask; *p != '\0'; p++) {
+    // one position is a single character or a placeholder
+    string position(p, *p == '?' && p[1] != '\0' ? 2 : 1);
+    if (position.size() == 2) p++;
+    string alphabet;
+    if (!expand(position.c_str(), custom, true, &alphabet, error)) {
+      return false;
+    }
+    alphabet = unique(alphabet);
+    if (alphabet.empty()) {
+      *error = "every position needs at least one character";
+      return false;
+    }
+    _alphabets.push_back(alphabet);
+  }
+  if (_alphabets.empty()) {
+    *error = "the mask is empty";
+    return false;
+  }
+
+  // the words are numbered with 64 bit indices
+  uint64_t n = 1;
+  for (size_t i = 0; i < _alphabets.size(); i++) {
+    if (n > UINT64_MAX / _alphabets[i].size()) {
+      *error = "the mask has more than 2^64 words";
+      return false;
+    }
+    n *= _alphabets[i].size();
+  }
+
+  _pointers.clear();
+  for (size_t i = 0; i < _alphabets.size(); i++) {
+    _pointers.push_back(_alphabets[i].c_str());
+  }
+  return true;
+}
+
+uint64_t Mask::keyspace() const {
+  uint64_t n = 1;
+  for (size_t i = 0; i < _alphabets.size(); i++) n *= _alphabets[i].size();
+  return n;
+}
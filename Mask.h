@@ -0,0 +1,53 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_MASK_H_
+#define PROJEKT_MASK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// A mask gives every position of the generated words its own characters:
+//   ?l = abcdefghijklmnopqrstuvwxyz  ?u = ABCDEFGHIJKLMNOPQRSTUVWXYZ
+//   ?d = 0123456789                  ?s = the printable special characters
+//   ?a = ?l?u?d?s                    ?h = 0123456789abcdef
+//   ?H = 0123456789ABCDEF            ?1 - ?4 = custom charsets
+//   ?? = a question mark, every other character stands for itself
+// So "?u?l?l?l?d?d" is a capital letter, three small ones and two digits.
+// Custom charsets may use the built-in ones, e.g. "?l?d_".
+class Mask {
+ public:
+  // number of custom charsets
+  static const unsigned kCustomCharsets = 4;
+
+  // Parse the mask, custom[i] is the charset for ?(i + 1) or NULL.
+  // Returns false and describes the problem in error for invalid masks.
+  bool parse(const char* mask, const char* const custom[kCustomCharsets],
+      string* error);
+
+  // number of positions
+  unsigned length() const { return _alphabets.size(); }
+
+  // the characters of every position, for CandidateGenerator
+  const char* const* alphabets() const { return &_pointers[0]; }
+
+  // number of words matching the mask
+  uint64_t keyspace() const;
+
+ private:
+  // Append the characters of a charset (with ?x placeholders) to out.
+  // Returns false for an unknown placeholder.
+  static bool expand(const char* charset,
+      const char* const custom[kCustomCharsets], bool allowCustom,
+      string* out, string* error);
+
+  vector<string> _alphabets;
+  vector<const char*> _pointers;
+};
+
+#endif  // PROJEKT_MASK_H_
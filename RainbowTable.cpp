@@ -0,0 +1,319 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include "./algorithms/MD5Simd.h"
+#include "./algorithms/SHA1Simd.h"
+#include "./RainbowTable.h"
+
+// The start of a table file, followed by the bucket offsets and the chains.
+struct RainbowTable::Header {
+  char magic[8];
+  uint32_t md5;
+  uint32_t minLength;
+  uint32_t maxLength;
+  uint32_t chainLength;
+  uint64_t keyspace;
+  uint64_t chains;
+  uint64_t buckets;
+  // null-terminated
+  char characters[256];
+};
+
+static const char kMagic[8] = { 'H', 'F', 'R', 'T', 'A', 'B', 'L', '1' };
+
+// Constructor, an empty table
+RainbowTable::RainbowTable() : _md5(true), _minLength(0), _maxLength(0),
+    _chainLength(0), _keyspace(0), _data(NULL), _size(0), _offsets(NULL),
+    _entries(NULL), _nChains(0) {
+}
+
+// Destructor
+RainbowTable::~RainbowTable() {
+  unmap();
+}
+
+bool RainbowTable::init(bool md5, const char* characters, unsigned minLength,
+    unsigned maxLength, unsigned chainLength) {
+  _md5 = md5;
+  _characters = characters;
+  _minLength = minLength;
+  _maxLength = maxLength;
+  _chainLength = chainLength;
+  _sizes.clear();
+  _keyspace = 0;
+  const uint64_t kMax = 1ULL << kMaxKeyspaceBits;
+  const uint64_t kBase = _characters.size();
+  uint64_t size = 1;
+  for (unsigned length = 1; length <= maxLength; length++) {
+    if (kBase > 0 && size > kMax / kBase) return false;
+    size *= kBase;
+    if (length < minLength) continue;
+    _sizes.push_back(size);
+    _keyspace += size;
+    if (_keyspace >= kMax) return false;
+  }
+  return _keyspace > 0;
+}
+
+unsigned RainbowTable::locate(uint64_t* index) const {
+  unsigned i = 0;
+  while (i + 1 < _sizes.size() && *index >= _sizes[i]) *index -= _sizes[i++];
+  return _minLength + i;
+}
+
+bool RainbowTable::save(const char* fileName, vector<Chain>* chains,
+    string* error) const {
+  // equal ends mean the chains merged, only the first one is kept
+  std::sort(chains->begin(), chains->end(),
+      [](const Chain& a, const Chain& b) {
+    return a.end < b.end || (a.end == b.end && a.start < b.start);
+  });
+  chains->erase(std::unique(chains->begin(), chains->end(),
+      [](const Chain& a, const Chain& b) { return a.end == b.end; }),
+      chains->end());
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.md5 = _md5;
+  header.minLength = _minLength;
+  header.maxLength = _maxLength;
+  header.chainLength = _chainLength;
+  header.keyspace = _keyspace;
+  header.chains = chains->size();
+  header.buckets = ((_keyspace - 1) >> 32) + 1;
+  if (_characters.size() >= sizeof(header.characters)) {
+    *error = "has too many characters";
+    return false;
+  }
+  memcpy(header.characters, _characters.data(), _characters.size());
+
+  // the chains of bucket b are offsets[b] to offsets[b + 1] - 1
+  vector<uint64_t> offsets(header.buckets + 1, 0);
+  vector<Entry> entries(chains->size());
+  for (size_t i = 0; i < chains->size(); i++) {
+    const Chain& chain = (*chains)[i];
+    offsets[(chain.end >> 32) + 1]++;
+    entries[i].end = static_cast<uint32_t>(chain.end);
+    entries[i].start = chain.start;
+  }
+  for (uint64_t b = 0; b < header.buckets; b++) offsets[b + 1] += offsets[b];
+
+  FILE* file = fopen(fileName, "wb");
+  if (file == NULL) {
+    *error = "cannot be written";
+    return false;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+      && fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), file)
+      == offsets.size()
+      && (entries.empty() || fwrite(&entries[0], sizeof(Entry),
+      entries.size(), file) == entries.size());
+  if (fclose(file) != 0) written = false;
+  if (!written) *error = "cannot be written";
+  return written;
+}
+
+bool RainbowTable::load(const char* fileName, string* error) {
+  unmap();
+  _nChains = 0;
+  int fd = ::open(fileName, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    if (fd >= 0) ::close(fd);
+    *error = "cannot be read";
+    return false;
+  }
+  if (static_cast<size_t>(info.st_size) < sizeof(Header)) {
+    ::close(fd);
+    *error = "is no rainbow table";
+    return false;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid without the file descriptor
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    *error = "cannot be mapped";
+    return false;
+  }
+  _data = data;
+  _size = info.st_size;
+
+  Header header;
+  memcpy(&header, _data, sizeof(header));
+  header.characters[sizeof(header.characters) - 1] = '\0';
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || !init(header.md5, header.characters, header.minLength,
+      header.maxLength, header.chainLength)
+      || header.chainLength == 0 || header.keyspace != _keyspace
+      || header.buckets != ((_keyspace - 1) >> 32) + 1
+      || _size != sizeof(Header) + (header.buckets + 1) * sizeof(uint64_t)
+      + header.chains * sizeof(Entry)) {
+    unmap();
+    *error = "is no rainbow table or it is damaged";
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(_data);
+  _offsets = reinterpret_cast<const uint64_t*>(bytes + sizeof(Header));
+  _entries = reinterpret_cast<const Entry*>(
+      _offsets + header.buckets + 1);
+  _nChains = header.chains;
+  // every lookup reads a few entries somewhere in the table
+  madvise(_data, _size, MADV_RANDOM);
+  return true;
+}
+
+void RainbowTable::unmap() {
+  if (_data != NULL) munmap(_data, _size);
+  _data = NULL;
+  _size = 0;
+  _offsets = NULL;
+  _entries = NULL;
+}
+
+void RainbowTable::starts(uint64_t end, vector<uint32_t>* result) const {
+  const uint64_t kBucket = end >> 32;
+  const Entry* first = _entries + _offsets[kBucket];
+  const Entry* last = _entries + _offsets[kBucket + 1];
+  const uint32_t kLow = static_cast<uint32_t>(end);
+  const Entry* entry = std::lower_bound(first, last, kLow,
+      [](const Entry& e, uint32_t low) { return e.end < low; });
+  for (; entry != last && entry->end == kLow; entry++) {
+    result->push_back(entry->start);
+  }
+}
+
+string RainbowTable::describe() const {
+  std::ostringstream text;
+  text << (_md5 ? "MD5" : "SHA-1") << ", characters " << _characters
+      << ", length " << _minLength;
+  if (_maxLength != _minLength) text << " - " << _maxLength;
+  return text.str();
+}
+
+template <typename Simd>
+RainbowWalker<Simd>::RainbowWalker(const RainbowTable& table,
+    typename Simd::Kernel kernel) : _table(table), _kernel(kernel),
+    _lanes(Simd::lanes(kernel)), _words(table.md5() ? 4 : 5) {
+  const CandidateGenerator::ByteOrder kOrder = table.md5()
+      ? CandidateGenerator::kLittleEndian : CandidateGenerator::kBigEndian;
+  for (unsigned length = table.minLength(); length <= table.maxLength();
+      length++) {
+    _generators.push_back(CandidateGenerator(table.characters().c_str(),
+        length, kOrder));
+  }
+  // lanes which are not filled hash whatever is left in them
+  memset(&_block, 0, sizeof(_block));
+}
+
+template <typename Simd>
+void RainbowWalker<Simd>::hash(const uint64_t* indices, unsigned n) {
+  for (unsigned lane = 0; lane < n; lane++) {
+    uint64_t index = indices[lane];
+    CandidateGenerator& words =
+        _generators[_table.locate(&index) - _table.minLength()];
+    words.seek(index);
+    const uint32_t* block = words.block();
+    for (unsigned w = 0; w < 16; w++) _block.words[w][lane] = block[w];
+  }
+  Simd::digest(_kernel, _block, &_digests);
+}
+
+template <typename Simd>
+void RainbowWalker<Simd>::laneDigest(unsigned lane, uint32_t* digest) const {
+  for (unsigned w = 0; w < _words; w++) digest[w] = _digests.words[w][lane];
+}
+
+template <typename Simd>
+uint64_t RainbowWalker<Simd>::generate(uint64_t first, uint64_t last,
+    RainbowTable::Chain* chains) {
+  const unsigned kColumns = _table.chainLength();
+  uint64_t indices[kMaxLanes];
+  uint32_t digest[5];
+  uint64_t nHashes = 0;
+  for (uint64_t chain = first; chain < last; chain += _lanes) {
+    const unsigned kN = std::min<uint64_t>(_lanes, last - chain);
+    for (unsigned lane = 0; lane < kN; lane++) indices[lane] = chain + lane;
+    for (unsigned column = 0; column < kColumns; column++) {
+      hash(indices, kN);
+      for (unsigned lane = 0; lane < kN; lane++) {
+        laneDigest(lane, digest);
+        indices[lane] = _table.reduce(digest, column);
+      }
+    }
+    for (unsigned lane = 0; lane < kN; lane++) {
+      chains[chain - first + lane].end = indices[lane];
+      chains[chain - first + lane].start = chain + lane;
+    }
+    nHashes += static_cast<uint64_t>(kN) * kColumns;
+  }
+  return nHashes;
+}
+
+template <typename Simd>
+bool RainbowWalker<Simd>::lookup(const uint32_t* digest, unsigned first,
+    string* word, uint64_t* nHashes) {
+  // lane l assumes the digest is the hash of column first + l and walks
+  // on to the end of the chain, it joins once the columns pass it
+  const unsigned kColumns = _table.chainLength();
+  const unsigned kN = std::min(_lanes, kColumns - first);
+  uint64_t indices[kMaxLanes];
+  uint32_t chainDigest[5];
+  for (unsigned lane = 0; lane < kN; lane++) {
+    indices[lane] = _table.reduce(digest, first + lane);
+  }
+  for (unsigned column = first + 1; column < kColumns; column++) {
+    hash(indices, kN);
+    *nHashes += kN;
+    for (unsigned lane = 0; lane < kN && first + lane < column; lane++) {
+      laneDigest(lane, chainDigest);
+      indices[lane] = _table.reduce(chainDigest, column);
+    }
+  }
+  // the ends are only candidates, a merged or a false chain is walked
+  // from its start without finding the digest
+  vector<uint32_t> starts;
+  for (unsigned lane = 0; lane < kN; lane++) {
+    starts.clear();
+    _table.starts(indices[lane], &starts);
+    for (size_t i = 0; i < starts.size(); i++) {
+      if (verify(starts[i], first + lane, digest, word, nHashes)) return true;
+    }
+  }
+  return false;
+}
+
+template <typename Simd>
+bool RainbowWalker<Simd>::verify(uint32_t start, unsigned column,
+    const uint32_t* digest, string* word, uint64_t* nHashes) {
+  uint64_t index = start;
+  uint32_t chainDigest[5];
+  for (unsigned c = 0; c <= column; c++) {
+    hash(&index, 1);
+    ++*nHashes;
+    laneDigest(0, chainDigest);
+    if (memcmp(chainDigest, digest, _words * sizeof(uint32_t)) == 0) {
+      uint64_t local = index;
+      CandidateGenerator& words =
+          _generators[_table.locate(&local) - _table.minLength()];
+      words.seek(local);
+      word->assign(words.word(), words.length());
+      return true;
+    }
+    index = _table.reduce(chainDigest, c);
+  }
+  return false;
+}
+
+// the search is compiled for both algorithms
+template class RainbowWalker<MD5Simd>;
+template class RainbowWalker<SHA1Simd>;
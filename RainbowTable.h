@@ -0,0 +1,159 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_RAINBOWTABLE_H_
+#define PROJEKT_RAINBOWTABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "./algorithms/LaneBlock.h"
+#include "./CandidateGenerator.h"
+
+using std::string;
+using std::vector;
+
+// A rainbow table over the combinations of a set of characters with a
+// range of lengths. The combinations are numbered like the search numbers
+// them: all combinations of the shortest length first. Chain i starts at
+// combination i, every column hashes its combination and reduces the
+// digest back to the index of the next one, the reduction of column c is
+// (first 64 bits of the digest + c) modulo the keyspace. Only the start and
+// the end of a chain are kept.
+//
+// The file is mapped as it is: a header, the bucket offsets and the chains
+// sorted by their end. The bucket of a chain is its end shifted right by
+// 32 bits, so a chain takes 8 bytes, the low bits of its end and its start.
+// Chains with the same end are merged when the table is saved.
+//
+// usage: 1) init() the keyspace, RainbowWalker::generate() the chains and
+//           save() them
+//        or 2) load() a file and RainbowWalker::lookup() digests in it
+class RainbowTable {
+ public:
+  // a chain while the table is generated
+  struct Chain {
+    uint64_t end;
+    uint32_t start;
+  };
+
+  // the bucket offsets of a table need 8 bytes per 2^32 combinations
+  static const unsigned kMaxKeyspaceBits = 56;
+
+  RainbowTable();
+  ~RainbowTable();
+
+  // The table for MD5 or SHA-1 over the combinations of the characters
+  // with minLength to maxLength characters. Returns false if there are
+  // 2^kMaxKeyspaceBits combinations or more.
+  bool init(bool md5, const char* characters, unsigned minLength,
+      unsigned maxLength, unsigned chainLength);
+
+  // Sort the chains by their end, drop the ones with the end of another
+  // chain and write the table. Returns false with the reason if the file
+  // cannot be written.
+  bool save(const char* fileName, vector<Chain>* chains,
+      string* error) const;
+
+  // Map the table of a file and init() from its header. Returns false with
+  // the reason if it is no table.
+  bool load(const char* fileName, string* error);
+
+  // the parameters of the table
+  bool md5() const { return _md5; }
+  const string& characters() const { return _characters; }
+  unsigned minLength() const { return _minLength; }
+  unsigned maxLength() const { return _maxLength; }
+  unsigned chainLength() const { return _chainLength; }
+  uint64_t keyspace() const { return _keyspace; }
+
+  // number of chains of a loaded table
+  uint64_t chains() const { return _nChains; }
+
+  // The algorithm and the keyspace for printing.
+  string describe() const;
+
+  // The index of the combination in the next column.
+  uint64_t reduce(const uint32_t* digest, unsigned column) const {
+    const uint64_t kBits = static_cast<uint64_t>(digest[1]) << 32 | digest[0];
+    return (kBits + column) % _keyspace;
+  }
+
+  // The length of the combination with this index, the index is made
+  // relative to the combinations of that length.
+  unsigned locate(uint64_t* index) const;
+
+  // Append the starts of the chains of a loaded table ending at end.
+  void starts(uint64_t end, vector<uint32_t>* result) const;
+
+ private:
+  struct Header;
+  struct Entry {
+    uint32_t end;
+    uint32_t start;
+  };
+
+  void unmap();
+
+  bool _md5;
+  string _characters;
+  unsigned _minLength;
+  unsigned _maxLength;
+  unsigned _chainLength;
+
+  // combinations of every length and of all lengths
+  vector<uint64_t> _sizes;
+  uint64_t _keyspace;
+
+  // the mapped file of a loaded table
+  void* _data;
+  size_t _size;
+  const uint64_t* _offsets;
+  const Entry* _entries;
+  uint64_t _nChains;
+};
+
+// Walks the chains of a table with the lanes of a SIMD kernel, one walker
+// per thread. A generator per length turns the indices into padded blocks.
+template <typename Simd>
+class RainbowWalker {
+ public:
+  RainbowWalker(const RainbowTable& table, typename Simd::Kernel kernel);
+
+  // number of chains or columns walked at once
+  unsigned lanes() const { return _lanes; }
+
+  // Walk the chains first to last - 1 to their ends, chains[0] is chain
+  // first. Returns the number of hashes.
+  uint64_t generate(uint64_t first, uint64_t last, RainbowTable::Chain* chains);
+
+  // Look for the digest in the columns first to first + lanes() - 1 of
+  // every chain. Returns true and the word if a chain of the table holds
+  // it, the hashes are added to nHashes.
+  bool lookup(const uint32_t* digest, unsigned first, string* word,
+      uint64_t* nHashes);
+
+ private:
+  // Hash the combinations with the indices of the first n lanes.
+  void hash(const uint64_t* indices, unsigned n);
+
+  // the digest of a lane after hash()
+  void laneDigest(unsigned lane, uint32_t* digest) const;
+
+  // Walk a chain from its start to column, returns true and the word if
+  // one of its combinations has the digest.
+  bool verify(uint32_t start, unsigned column, const uint32_t* digest,
+      string* word, uint64_t* nHashes);
+
+  const RainbowTable& _table;
+  typename Simd::Kernel _kernel;
+  unsigned _lanes;
+  unsigned _words;
+  vector<CandidateGenerator> _generators;
+  LaneBlock _block;
+  LaneDigests _digests;
+};
+
+#endif  // PROJEKT_RAINBOWTABLE_H_
@@ -0,0 +1,41 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include "./ResultQueue.h"
+
+// Constructor, head and tail point to the stub node
+ResultQueue::ResultQueue() {
+  Node* stub = new Node();
+  stub->next = NULL;
+  _head = stub;
+  _tail = stub;
+}
+
+// Destructor, frees the results never taken and the stub
+ResultQueue::~ResultQueue() {
+  Result result;
+  while (pop(&result)) {}
+  delete _tail;
+}
+
+void ResultQueue::push(const Result& result) {
+  Node* node = new Node();
+  node->next.store(NULL, std::memory_order_relaxed);
+  node->result = result;
+  // release: the consumer must see the result when it sees the node
+  Node* previous = _head.exchange(node, std::memory_order_acq_rel);
+  previous->next.store(node, std::memory_order_release);
+}
+
+bool ResultQueue::pop(Result* result) {
+  Node* next = _tail->next.load(std::memory_order_acquire);
+  if (next == NULL) return false;
+  // the next node becomes the new stub, its result is moved out
+  result->threadnumber = next->result.threadnumber;
+  result->target = next->result.target;
+  result->word.swap(next->result.word);
+  delete _tail;
+  _tail = next;
+  return true;
+}
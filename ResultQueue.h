@@ -0,0 +1,56 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_RESULTQUEUE_H_
+#define PROJEKT_RESULTQUEUE_H_
+
+#include <atomic>
+#include <string>
+
+using std::string;
+
+// A word whose hash is one of the targets.
+struct Result {
+  unsigned threadnumber;
+  int target;
+  string word;
+};
+
+// Unbounded lock-free queue with many producers and a single consumer.
+// push() is one atomic exchange, so a worker reporting a hit never waits
+// for another worker or for the consumer. Only one thread may call pop().
+//
+// The queue is a linked list which always contains a stub node: producers
+// swap themselves in at the head, the consumer follows the next pointers
+// from the tail. A producer preempted between the exchange and setting the
+// next pointer hides the nodes behind it for that short time.
+class ResultQueue {
+ public:
+  ResultQueue();
+  ~ResultQueue();
+
+  // Append a result, safe to call from any number of threads.
+  void push(const Result& result);
+
+  // Take the oldest result, returns false if the queue is (still) empty.
+  bool pop(Result* result);
+
+ private:
+  struct Node {
+    std::atomic<Node*> next;
+    Result result;
+  };
+
+  // the node pushed last, shared by the producers
+  std::atomic<Node*> _head;
+
+  // the stub node in front of the oldest result, only used by the consumer
+  Node* _tail;
+
+  // no copies, the nodes belong to exactly one queue
+  ResultQueue(const ResultQueue&);
+  ResultQueue& operator=(const ResultQueue&);
+};
+
+#endif  // PROJEKT_RESULTQUEUE_H_
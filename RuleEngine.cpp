@@ -0,0 +1,238 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "./RuleEngine.h"
+
+namespace {
+// Decode a position 0 - 9 or A - Z, -1 if it is none
+int position(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+  return -1;
+}
+
+uint8_t toggle(uint8_t c) {
+  if (islower(c)) return toupper(c);
+  if (isupper(c)) return tolower(c);
+  return c;
+}
+}  // namespace
+
+const size_t RuleEngine::kMaxWord;
+const size_t RuleEngine::kRejected;
+
+// Constructor, no rules
+RuleEngine::RuleEngine() {
+  clear();
+}
+
+void RuleEngine::clear() {
+  _code.clear();
+  _tables.clear();
+  _start.assign(1, 0);
+  _checksum = 14695981039346656037ULL;
+}
+
+void RuleEngine::translate(const uint8_t table[256], bool* lastWasTable) {
+  if (*lastWasTable) {
+    // apply the new table to the result of the one before
+    size_t index = _code[_code.size() - 2] | (_code.back() << 8);
+    uint8_t* previous = &_tables[index * 256];
+    for (unsigned i = 0; i < 256; i++) previous[i] = table[previous[i]];
+    return;
+  }
+  size_t index = _tables.size() / 256;
+  _tables.insert(_tables.end(), table, table + 256);
+  _code.push_back(kTranslate);
+  _code.push_back(index & 0xff);
+  _code.push_back(index >> 8);
+  *lastWasTable = true;
+}
+
+bool RuleEngine::add(const string& rule, string* error) {
+  const size_t kCodeSize = _code.size();
+  const size_t kTablesSize = _tables.size();
+  if (!compile(rule, error)) {
+    // drop the code of the invalid rule
+    _code.resize(kCodeSize);
+    _tables.resize(kTablesSize);
+    return false;
+  }
+  if (_tables.size() / 256 > 0xffff) {
+    *error = "too many rules";
+    _code.resize(kCodeSize);
+    _tables.resize(kTablesSize);
+    return false;
+  }
+  _start.push_back(_code.size());
+  // the newline ends each rule, so "$1" "$2" differs from "$1$2"
+  for (size_t i = 0; i < rule.size(); i++) {
+    _checksum = (_checksum ^ static_cast<uint8_t>(rule[i])) * 1099511628211ULL;
+  }
+  _checksum = (_checksum ^ '\n') * 1099511628211ULL;
+  return true;
+}
+
+bool RuleEngine::compile(const string& rule, string* error) {
+  bool lastWasTable = false;
+  uint8_t table[256];
+
+  for (size_t i = 0; i < rule.size(); i++) {
+    const char op = rule[i];
+    // the number of argument characters of the operation
+    size_t nArgs = (op == 's') ? 2
+        : (op == '$' || op == '^' || op == 'T' || op == '\'') ? 1 : 0;
+    if (i + nArgs >= rule.size() && nArgs > 0) {
+      *error = string("missing argument for ") + op;
+      return false;
+    }
+    const char* args = rule.c_str() + i + 1;
+    bool wasTable = lastWasTable;
+    lastWasTable = false;
+    switch (op) {
+      case ' ':
+      case ':':
+        lastWasTable = wasTable;
+        break;
+      case 'l':
+      case 'u':
+      case 't':
+        for (unsigned c = 0; c < 256; c++) {
+          table[c] = (op == 'l') ? tolower(c)
+              : (op == 'u') ? toupper(c) : toggle(c);
+        }
+        lastWasTable = wasTable;
+        translate(table, &lastWasTable);
+        break;
+      case 's':
+        for (unsigned c = 0; c < 256; c++) table[c] = c;
+        table[static_cast<uint8_t>(args[0])] = args[1];
+        lastWasTable = wasTable;
+        translate(table, &lastWasTable);
+        break;
+      case 'c':
+      case 'C':
+        for (unsigned c = 0; c < 256; c++) {
+          table[c] = (op == 'c') ? tolower(c) : toupper(c);
+        }
+        lastWasTable = wasTable;
+        translate(table, &lastWasTable);
+        _code.push_back(op == 'c' ? kUpperFirst : kLowerFirst);
+        lastWasTable = false;
+        break;
+      case 'T':
+      case '\'':
+        if (position(args[0]) < 0) {
+          *error = string("invalid position ") + args[0];
+          return false;
+        }
+        _code.push_back(op == 'T' ? kToggleAt : kTruncate);
+        _code.push_back(position(args[0]));
+        break;
+      case '$':
+      case '^':
+        _code.push_back(op == '$' ? kAppend : kPrepend);
+        _code.push_back(args[0]);
+        break;
+      case 'r': _code.push_back(kReverse); break;
+      case 'd': _code.push_back(kDuplicate); break;
+      case '[': _code.push_back(kDeleteFirst); break;
+      case ']': _code.push_back(kDeleteLast); break;
+      default:
+        *error = string("unknown rule ") + op;
+        return false;
+    }
+    i += nArgs;
+  }
+  return true;
+}
+
+bool RuleEngine::read(const char* fileName, string* error) {
+  std::ifstream ruleFile(fileName, std::ios_base::in);
+  if (!ruleFile.is_open()) {
+    *error = string(fileName) + " cannot be read";
+    return false;
+  }
+  string line;
+  unsigned lineNumber = 0;
+  while (getline(ruleFile, line)) {
+    lineNumber++;
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+      line.erase(line.size() - 1);
+    }
+    if (line.empty() || line[0] == '#') continue;
+    string ruleError;
+    if (!add(line, &ruleError)) {
+      char number[16];
+      snprintf(number, sizeof(number), "%u", lineNumber);
+      *error = "line " + string(number) + ": " + ruleError;
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t RuleEngine::apply(unsigned rule, const char* word, size_t length,
+    char* out) const {
+  if (length > kMaxWord) return kRejected;
+  memcpy(out, word, length);
+  const uint8_t* pc = _code.data() + _start[rule];
+  const uint8_t* end = _code.data() + _start[rule + 1];
+  while (pc < end) {
+    switch (*pc++) {
+      case kTranslate: {
+        const uint8_t* table = &_tables[(pc[0] | (pc[1] << 8)) * 256];
+        pc += 2;
+        for (size_t i = 0; i < length; i++) {
+          out[i] = table[static_cast<uint8_t>(out[i])];
+        }
+        break;
+      }
+      case kToggleAt:
+        if (*pc < length) out[*pc] = toggle(out[*pc]);
+        pc++;
+        break;
+      case kUpperFirst:
+        if (length > 0) out[0] = toupper(static_cast<uint8_t>(out[0]));
+        break;
+      case kLowerFirst:
+        if (length > 0) out[0] = tolower(static_cast<uint8_t>(out[0]));
+        break;
+      case kReverse:
+        std::reverse(out, out + length);
+        break;
+      case kDuplicate:
+        if (2 * length > kMaxWord) return kRejected;
+        memcpy(out + length, out, length);
+        length *= 2;
+        break;
+      case kAppend:
+        if (length == kMaxWord) return kRejected;
+        out[length++] = *pc++;
+        break;
+      case kPrepend:
+        if (length == kMaxWord) return kRejected;
+        memmove(out + 1, out, length++);
+        out[0] = *pc++;
+        break;
+      case kTruncate:
+        if (*pc < length) length = *pc;
+        pc++;
+        break;
+      case kDeleteFirst:
+        if (length > 0) memmove(out, out + 1, --length);
+        break;
+      case kDeleteLast:
+        if (length > 0) length--;
+        break;
+    }
+  }
+  return length;
+}
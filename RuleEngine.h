@@ -0,0 +1,100 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_RULEENGINE_H_
+#define PROJEKT_RULEENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Applies mangling rules to dictionary words, one rule per line in the
+// style of other password crackers:
+//   :     do nothing                 r     reverse
+//   l     lowercase                  d     duplicate
+//   u     uppercase                  $X    append X
+//   c     capitalize                 ^X    prepend X
+//   C     lowercase first, upper rest
+//   t     toggle the case            TN    toggle the case at position N
+//   sXY   replace all X by Y         'N    truncate to N characters
+//   [     delete the first char      ]     delete the last char
+// Positions N are 0 - 9 and A - Z for 10 - 35, spaces are ignored.
+//
+// The rules are compiled into a compact bytecode. All case changes and
+// substitutions next to each other become a single lookup table, so e.g.
+// "l sa@ so0 si1" is one pass over the word.
+class RuleEngine {
+ public:
+  // longest word a rule reads or writes
+  static const size_t kMaxWord = 256;
+
+  // returned by apply() if the result would be too long
+  static const size_t kRejected = static_cast<size_t>(-1);
+
+  RuleEngine();
+
+  // Remove all rules.
+  void clear();
+
+  // Compile a rule and add it. Returns false and describes the problem in
+  // error if the rule is invalid.
+  bool add(const string& rule, string* error);
+
+  // Read and compile a rule file, empty lines and lines starting with # are
+  // skipped. Returns false with the line number in error.
+  bool read(const char* fileName, string* error);
+
+  // number of rules
+  unsigned size() const { return _start.size() - 1; }
+
+  // FNV-1a over the text of the rules added, in their order
+  uint64_t checksum() const { return _checksum; }
+
+  // Whether the rule leaves every word as it is, like ':'. Such a rule
+  // also takes words longer than kMaxWord.
+  bool isIdentity(unsigned rule) const {
+    return _start[rule] == _start[rule + 1];
+  }
+
+  // Apply a rule to the word and write the result into out, which must
+  // hold kMaxWord bytes. Returns the length of the result or kRejected.
+  size_t apply(unsigned rule, const char* word, size_t length,
+      char* out) const;
+
+ private:
+  enum Op {
+    kTranslate,        // 2 byte table index
+    kToggleAt,         // position
+    kUpperFirst,
+    kLowerFirst,
+    kReverse,
+    kDuplicate,
+    kAppend,           // character
+    kPrepend,          // character
+    kTruncate,         // length
+    kDeleteFirst,
+    kDeleteLast
+  };
+
+  // Append the code of a rule, false if it is invalid.
+  bool compile(const string& rule, string* error);
+
+  // Append a translation to the code, merged with a table right before it.
+  void translate(const uint8_t table[256], bool* lastWasTable);
+
+  // the code of rule i is _code[_start[i]] to _code[_start[i + 1] - 1]
+  vector<uint8_t> _code;
+  vector<uint32_t> _start;
+
+  // lookup tables of 256 bytes each
+  vector<uint8_t> _tables;
+
+  uint64_t _checksum;
+};
+
+#endif  // PROJEKT_RULEENGINE_H_
@@ -0,0 +1,119 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "./Scheduler.h"
+
+// Constructor, nothing to hand out
+Scheduler::Scheduler() : _chunkSize(1), _size(0), _cursor(0) {
+  _firstChunk.push_back(0);
+}
+
+void Scheduler::plan(const vector<uint64_t>& segmentSizes,
+    uint64_t chunkSize) {
+  plan(segmentSizes, chunkSize, 0, total(segmentSizes));
+}
+
+void Scheduler::plan(const vector<uint64_t>& segmentSizes,
+    uint64_t chunkSize, uint128_t begin, uint128_t end) {
+  _segmentSizes.clear();
+  _segmentStarts.clear();
+  _chunkSize = chunkSize;
+  _size = 0;
+  _firstChunk.assign(1, 0);
+  // intersect every segment with the range, as offsets into the segment
+  uint128_t first = 0;
+  for (size_t i = 0; i < segmentSizes.size(); i++) {
+    const uint128_t kLast = first + segmentSizes[i];
+    const uint128_t kBegin = std::min(std::max(begin, first), kLast);
+    const uint128_t kEnd = std::max(std::min(end, kLast), kBegin);
+    _segmentStarts.push_back(kBegin - first);
+    _segmentSizes.push_back(kEnd - kBegin);
+    uint64_t nChunks = (_segmentSizes[i] + chunkSize - 1) / chunkSize;
+    _firstChunk.push_back(_firstChunk.back() + nChunks);
+    _size += _segmentSizes[i];
+    first = kLast;
+  }
+  _cursor = 0;
+  _done.clear();
+}
+
+uint128_t Scheduler::total(const vector<uint64_t>& segmentSizes) {
+  uint128_t n = 0;
+  for (size_t i = 0; i < segmentSizes.size(); i++) n += segmentSizes[i];
+  return n;
+}
+
+void Scheduler::shard(uint64_t part, uint64_t n, uint128_t* begin,
+    uint128_t* end) {
+  const uint128_t kSize = *end - *begin;
+  *end = *begin + splitAt(kSize, part, n);
+  *begin += splitAt(kSize, part - 1, n);
+}
+
+uint128_t Scheduler::splitAt(uint128_t size, uint64_t part, uint64_t n) {
+  // size * part / n without overflow: the remainder is less than n, so its
+  // product with part fits into 128 bits
+  return size / n * part + size % n * part / n;
+}
+
+string Scheduler::format(uint128_t n) {
+  string digits;
+  do {
+    digits.insert(digits.begin(), '0' + static_cast<char>(n % 10));
+    n /= 10;
+  } while (n > 0);
+  return digits;
+}
+
+uint64_t Scheduler::restore(uint64_t first, const vector<uint64_t>& done) {
+  first = std::min(first, chunks());
+  _cursor = first;
+  _done = done;
+  std::sort(_done.begin(), _done.end());
+  uint64_t skipped = itemsBefore(first);
+  for (size_t i = 0; i < _done.size(); i++) {
+    if (_done[i] < first || _done[i] >= chunks()) continue;
+    Chunk c;
+    chunk(_done[i], &c);
+    skipped += c.end - c.begin;
+  }
+  return skipped;
+}
+
+bool Scheduler::next(Chunk* chunk) {
+  // the threads only share this counter, the order of the chunks does not
+  // matter, so a relaxed increment is enough
+  uint64_t i;
+  do {
+    i = _cursor.fetch_add(1, std::memory_order_relaxed);
+    if (i >= _firstChunk.back()) return false;
+  } while (!_done.empty()
+      && std::binary_search(_done.begin(), _done.end(), i));
+  this->chunk(i, chunk);
+  return true;
+}
+
+void Scheduler::chunk(uint64_t index, Chunk* chunk) const {
+  // there are only a few segments, empty ones have no chunks at all
+  unsigned segment = std::upper_bound(_firstChunk.begin(), _firstChunk.end(),
+      index) - _firstChunk.begin() - 1;
+  const uint64_t kOffset = (index - _firstChunk[segment]) * _chunkSize;
+  chunk->segment = segment;
+  chunk->begin = _segmentStarts[segment] + kOffset;
+  chunk->end = _segmentStarts[segment]
+      + std::min(kOffset + _chunkSize, _segmentSizes[segment]);
+  chunk->index = index;
+}
+
+uint64_t Scheduler::itemsBefore(uint64_t index) const {
+  if (index >= chunks()) return _size;
+  Chunk c;
+  chunk(index, &c);
+  uint64_t items = c.begin - _segmentStarts[c.segment];
+  for (unsigned i = 0; i < c.segment; i++) items += _segmentSizes[i];
+  return items;
+}
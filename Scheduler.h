@@ -0,0 +1,102 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_SCHEDULER_H_
+#define PROJEKT_SCHEDULER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// The keyspaces of all word lengths together do not fit into 64 bits.
+typedef unsigned __int128 uint128_t;
+
+// A range of work items [begin, end) inside one segment of the keyspace.
+struct Chunk {
+  unsigned segment;
+  uint64_t begin;
+  uint64_t end;
+  // position of the chunk in the order of Scheduler::next()
+  uint64_t index;
+};
+
+// Hands out the work in fixed-size chunks from a shared atomic cursor, so
+// a thread which is faster than the others simply takes more chunks and
+// no thread waits for a straggler with a big static slice.
+//
+// The keyspace consists of segments (the dictionary or the combinations of
+// one word length), a chunk never crosses the end of a segment. Only a
+// range of the keyspace may be planned, e.g. the shard of one machine.
+//
+// usage: 1) plan() the segments before the threads are started and
+//           restore() the chunks done by an earlier run
+//        2) every thread calls next() until it returns false
+class Scheduler {
+ public:
+  Scheduler();
+
+  // Split every segment into chunks of at most chunkSize items and start
+  // handing them out from the first chunk of the first segment.
+  void plan(const vector<uint64_t>& segmentSizes, uint64_t chunkSize);
+
+  // The same for the items begin to end - 1 of all segments one after
+  // another, the range must hold less than 2^64 items.
+  void plan(const vector<uint64_t>& segmentSizes, uint64_t chunkSize,
+      uint128_t begin, uint128_t end);
+
+  // Sum of the segment sizes, exact for any number of segments.
+  static uint128_t total(const vector<uint64_t>& segmentSizes);
+
+  // The items begin to end - 1 cut into n parts of almost the same size,
+  // part is from 1 to n. Every item is in exactly one part.
+  static void shard(uint64_t part, uint64_t n, uint128_t* begin,
+      uint128_t* end);
+
+  // decimal digits of a 128 bit number
+  static string format(uint128_t n);
+
+  // Continue a search: start at chunk first and skip the chunks in done,
+  // which all come after it. Returns the number of items skipped.
+  uint64_t restore(uint64_t first, const vector<uint64_t>& done);
+
+  // Get the next chunk, returns false when all chunks are handed out.
+  bool next(Chunk* chunk);
+
+  // total number of items in the planned range and of chunks
+  uint64_t size() const { return _size; }
+  uint64_t chunks() const { return _firstChunk.back(); }
+
+ private:
+  // The first item of part + 1 when size items are cut into n parts.
+  static uint128_t splitAt(uint128_t size, uint64_t part, uint64_t n);
+
+  // the items of every segment in the range, starting at _segmentStarts
+  vector<uint64_t> _segmentSizes;
+  vector<uint64_t> _segmentStarts;
+
+  // index of the first chunk of every segment, the last entry is the total
+  // number of chunks
+  vector<uint64_t> _firstChunk;
+
+  uint64_t _chunkSize;
+  uint64_t _size;
+
+  // the chunks after the start which are skipped, sorted
+  vector<uint64_t> _done;
+
+  // the chunk with this index
+  void chunk(uint64_t index, Chunk* chunk) const;
+
+  // number of items in the chunks before this index
+  uint64_t itemsBefore(uint64_t index) const;
+
+  // the next chunk to hand out, counts over all segments
+  std::atomic<uint64_t> _cursor;
+};
+
+#endif  // PROJEKT_SCHEDULER_H_
@@ -0,0 +1,127 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <stdio.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "./Stats.h"
+
+// Constructor, nothing counted yet
+Stats::Stats() {
+  start(0);
+}
+
+void Stats::start(uint64_t total, uint64_t restored) {
+  for (unsigned i = 0; i < kMaxThreads; i++) {
+    _counters[i].hashes = 0;
+    _counters[i].work = 0;
+  }
+  _threads = 0;
+  _total = total;
+  _restored = std::min(restored, total);
+  _start = std::chrono::steady_clock::now();
+}
+
+Stats::Sample Stats::sample() const {
+  Sample sample;
+  sample.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - _start).count();
+  sample.hashes = 0;
+  sample.work = 0;
+  const unsigned kThreads = std::min(_threads.load(), kMaxThreads);
+  for (unsigned i = 0; i < kThreads; i++) {
+    const uint64_t kHashes =
+        _counters[i].hashes.load(std::memory_order_relaxed);
+    sample.threadHashes.push_back(kHashes);
+    sample.hashes += kHashes;
+    sample.work += _counters[i].work.load(std::memory_order_relaxed);
+  }
+  return sample;
+}
+
+bool Stats::progress(const Sample& now, double* done, double* eta) const {
+  if (_total == 0 || now.work == 0 || now.seconds <= 0) return false;
+  const uint64_t kDone = _restored + now.work;
+  *done = std::min(1.0, static_cast<double>(kDone) / _total);
+  // the average since the start is steadier than the last interval
+  const double kWorkPerSecond = now.work / now.seconds;
+  *eta = kDone >= _total ? 0 : (_total - kDone) / kWorkPerSecond;
+  return true;
+}
+
+string Stats::formatRate(double rate) {
+  const char* kUnits[] = { "H/s", "kH/s", "MH/s", "GH/s", "TH/s" };
+  unsigned unit = 0;
+  while (rate >= 1000 && unit < 4) {
+    rate /= 1000;
+    unit++;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.2f %s", rate, kUnits[unit]);
+  return buffer;
+}
+
+// hashes per second of every worker between the samples
+static vector<double> threadRates(const Stats::Sample& before,
+    const Stats::Sample& now) {
+  const double kSeconds = now.seconds - before.seconds;
+  vector<double> rates;
+  for (size_t i = 0; i < now.threadHashes.size(); i++) {
+    uint64_t hashes = now.threadHashes[i];
+    if (i < before.threadHashes.size()) hashes -= before.threadHashes[i];
+    rates.push_back(kSeconds > 0 ? hashes / kSeconds : 0);
+  }
+  return rates;
+}
+
+string Stats::format(const Sample& before, const Sample& now) const {
+  const double kSeconds = now.seconds - before.seconds;
+  const double kRate =
+      kSeconds > 0 ? (now.hashes - before.hashes) / kSeconds : 0;
+  char buffer[128];
+  string status = "[Status] " + formatRate(kRate);
+  double done, eta;
+  if (progress(now, &done, &eta)) {
+    const uint64_t kEta = eta + 0.5;
+    snprintf(buffer, sizeof(buffer), ", %.1f%% done, ETA %" PRIu64
+        ":%02u:%02u", done * 100, kEta / 3600, (unsigned)(kEta / 60 % 60),
+        (unsigned)(kEta % 60));
+    status += buffer;
+  }
+  status += "\n[Status] Threads:";
+  vector<double> rates = threadRates(before, now);
+  for (size_t i = 0; i < rates.size(); i++) {
+    status += " " + formatRate(rates[i]);
+    if (i + 1 < rates.size()) status += ",";
+  }
+  return status + "\n";
+}
+
+string Stats::formatJson(const Sample& before, const Sample& now) const {
+  const double kSeconds = now.seconds - before.seconds;
+  const double kRate =
+      kSeconds > 0 ? (now.hashes - before.hashes) / kSeconds : 0;
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer), "{\"seconds\":%.3f,\"hashes\":%" PRIu64
+      ",\"rate\":%.0f,", now.seconds, now.hashes, kRate);
+  string json = buffer;
+  double done, eta;
+  if (progress(now, &done, &eta)) {
+    snprintf(buffer, sizeof(buffer), "\"progress\":%.6f,\"eta\":%.0f,",
+        done, eta);
+  } else {
+    snprintf(buffer, sizeof(buffer), "\"progress\":null,\"eta\":null,");
+  }
+  json += buffer;
+  json += "\"threads\":[";
+  vector<double> rates = threadRates(before, now);
+  for (size_t i = 0; i < rates.size(); i++) {
+    snprintf(buffer, sizeof(buffer), "%s%.0f", i > 0 ? "," : "", rates[i]);
+    json += buffer;
+  }
+  return json + "]}";
+}
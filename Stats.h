@@ -0,0 +1,91 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_STATS_H_
+#define PROJEKT_STATS_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Throughput and progress of the workers. Every worker adds to its own
+// counters once per chunk, the counters of different workers are on
+// different cache lines, so the workers never write to a shared line. The
+// reporter samples all counters now and then with relaxed loads.
+//
+// usage: 1) start() the clock with the total work of the search
+//        2) every worker calls add() after each chunk
+//        3) the reporter takes a sample() and formats the rates since the
+//           sample before
+class Stats {
+ public:
+  // workers with counters of their own, more threads share them
+  static const unsigned kMaxThreads = 256;
+
+  // The counters at one point in time.
+  struct Sample {
+    // seconds since start()
+    double seconds;
+    // candidates hashed and work done by all workers
+    uint64_t hashes;
+    uint64_t work;
+    // candidates hashed by every worker, thread i is at index i - 1
+    vector<uint64_t> threadHashes;
+  };
+
+  Stats();
+
+  // Reset the counters and start the clock. The total work is counted in
+  // the units of add(), 0 if it is not known in advance. The work restored
+  // from a checkpoint counts as done but not for the rates.
+  void start(uint64_t total, uint64_t restored = 0);
+
+  // Count the candidates and the work of a chunk of worker thread (from 1).
+  void add(unsigned thread, uint64_t hashes, uint64_t work) {
+    Counter& counter = _counters[(thread - 1) % kMaxThreads];
+    counter.hashes.fetch_add(hashes, std::memory_order_relaxed);
+    counter.work.fetch_add(work, std::memory_order_relaxed);
+    unsigned threads = _threads.load(std::memory_order_relaxed);
+    while (thread > threads && !_threads.compare_exchange_weak(threads,
+        thread, std::memory_order_relaxed)) {}
+  }
+
+  // Read the counters of all workers.
+  Sample sample() const;
+
+  // The status lines for the time between before and now: hash rate of
+  // all and of every worker, progress and ETA.
+  string format(const Sample& before, const Sample& now) const;
+
+  // The same as a single JSON object without a line break.
+  string formatJson(const Sample& before, const Sample& now) const;
+
+  // Hashes per second with a unit prefix, e.g. 12.34 MH/s.
+  static string formatRate(double rate);
+
+ private:
+  struct Counter {
+    std::atomic<uint64_t> hashes;
+    std::atomic<uint64_t> work;
+  } __attribute__((aligned(64)));
+
+  // Fraction of the total work done and seconds left, false if unknown.
+  bool progress(const Sample& now, double* done, double* eta) const;
+
+  Counter _counters[kMaxThreads];
+
+  // highest thread number seen by add()
+  std::atomic<unsigned> _threads;
+
+  uint64_t _total;
+  uint64_t _restored;
+  std::chrono::steady_clock::time_point _start;
+};
+
+#endif  // PROJEKT_STATS_H_
@@ -0,0 +1,111 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "./TargetSet.h"
+
+// Constructor, an empty set of MD5 digests
+TargetSet::TargetSet() : _remaining(0) {
+  clear(4);
+}
+
+void TargetSet::clear(unsigned words) {
+  _words = words;
+  _nTargets = 0;
+  _digests.clear();
+  _bitmap.assign(1, 0);
+  _bitmapMask = 63;
+  _table.assign(1, 0);
+  _tableMask = 0;
+  _found.reset();
+  _remaining = 0;
+}
+
+void TargetSet::replicate(const TargetSet& other) {
+  _words = other._words;
+  _nTargets = other._nTargets;
+  _digests = other._digests;
+  _bitmap = other._bitmap;
+  _bitmapMask = other._bitmapMask;
+  _table = other._table;
+  _tableMask = other._tableMask;
+  _found.reset();
+  _remaining = 0;
+}
+
+void TargetSet::add(const uint32_t* digest) {
+  _digests.insert(_digests.end(), digest, digest + _words);
+  _nTargets++;
+}
+
+void TargetSet::build() {
+  // sort the digests and drop duplicates
+  vector<size_t> order(_nTargets);
+  for (size_t i = 0; i < _nTargets; i++) order[i] = i;
+  const vector<uint32_t>& digests = _digests;
+  const unsigned kWords = _words;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::lexicographical_compare(
+        digests.begin() + a * kWords, digests.begin() + (a + 1) * kWords,
+        digests.begin() + b * kWords, digests.begin() + (b + 1) * kWords);
+  });
+  vector<uint32_t> sorted;
+  for (size_t i = 0; i < _nTargets; i++) {
+    const uint32_t* d = &_digests[order[i] * _words];
+    if (!sorted.empty() &&
+        memcmp(&sorted[sorted.size() - _words], d, _words * 4) == 0) {
+      continue;
+    }
+    sorted.insert(sorted.end(), d, d + _words);
+  }
+  _digests.swap(sorted);
+  _nTargets = _digests.size() / _words;
+
+  // about 16 bits per target keep the false positive rate of the bitmap
+  // low, but at least 64 Kbit so a single target needs no table lookups
+  uint64_t bits = 1 << 16;
+  while (bits < 16 * (uint64_t)_nTargets && bits < (1ULL << 32)) bits <<= 1;
+  _bitmap.assign(bits / 64, 0);
+  _bitmapMask = bits - 1;
+
+  // the table is at most half full, the second word decides the slot
+  uint64_t slots = 16;
+  while (slots < 2 * (uint64_t)_nTargets) slots <<= 1;
+  _table.assign(slots, 0);
+  _tableMask = slots - 1;
+
+  for (size_t i = 0; i < _nTargets; i++) {
+    const uint32_t* d = digest(i);
+    _bitmap[(d[0] & _bitmapMask) >> 6] |= 1ULL << (d[0] & 63);
+    uint32_t slot = d[1] & _tableMask;
+    while (_table[slot] != 0) slot = (slot + 1) & _tableMask;
+    _table[slot] = i + 1;
+  }
+
+  _found.reset(new std::atomic<bool>[_nTargets]);
+  for (size_t i = 0; i < _nTargets; i++) _found[i] = false;
+  _remaining = _nTargets;
+}
+
+int TargetSet::find(const uint32_t* d) const {
+  if (!mayContain(d[0])) return -1;
+  for (uint32_t slot = d[1] & _tableMask; _table[slot] != 0;
+       slot = (slot + 1) & _tableMask) {
+    const uint32_t* t = digest(_table[slot] - 1);
+    if (memcmp(t, d, _words * 4) == 0) return _table[slot] - 1;
+  }
+  return -1;
+}
+
+bool TargetSet::markFound(int index) {
+  if (_found[index].exchange(true)) return false;
+  _remaining--;
+  return true;
+}
+
+bool TargetSet::isFound(int index) const {
+  return _found[index].load();
+}
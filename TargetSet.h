@@ -0,0 +1,86 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_TARGETSET_H_
+#define PROJEKT_TARGETSET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using std::vector;
+
+// The binary digests of all hashes we are searching for. Every candidate
+// is looked up in O(1): a bitmap on the first digest word rejects almost
+// all candidates with a single memory access, the rest goes to an open
+// addressing table which compares the whole digest.
+//
+// usage: 1) clear() with the number of digest words (4 MD5, 5 SHA-1)
+//        2) add() every target, then build() the lookup structures
+//        3) mayContain() and find() from as many threads as you like
+class TargetSet {
+ public:
+  TargetSet();
+
+  // Remove all targets, digests have the given number of words.
+  void clear(unsigned words);
+
+  // Add a target, call build() after the last one.
+  void add(const uint32_t* digest);
+
+  // Remove duplicates and build the bitmap and the hash table.
+  void build();
+
+  // Copy the digests, the bitmap and the hash table of a built set, e.g.
+  // into the memory of another NUMA node. The copy is only for
+  // mayContain(), find() and digest(), targets are marked in the original.
+  void replicate(const TargetSet& other);
+
+  // number of targets and words per digest
+  size_t size() const { return _nTargets; }
+  unsigned words() const { return _words; }
+
+  // the digest of the target with the given index
+  const uint32_t* digest(size_t index) const {
+    return &_digests[index * _words];
+  }
+
+  // Prefilter on the first digest word, false means it is no target.
+  bool mayContain(uint32_t word0) const {
+    return (_bitmap[(word0 & _bitmapMask) >> 6] >> (word0 & 63)) & 1;
+  }
+
+  // Index of the target with this digest or -1.
+  int find(const uint32_t* digest) const;
+
+  // Mark a target as found, true only for the first thread doing so.
+  bool markFound(int index);
+  bool isFound(int index) const;
+
+  // Number of targets not found yet.
+  size_t remaining() const { return _remaining.load(); }
+  bool allFound() const { return remaining() == 0; }
+
+ private:
+  unsigned _words;
+  size_t _nTargets;
+
+  // all digests one after another, sorted after build()
+  vector<uint32_t> _digests;
+
+  // bitmap over the low bits of the first word
+  vector<uint64_t> _bitmap;
+  uint32_t _bitmapMask;
+
+  // open addressing table with linear probing, slots hold index + 1
+  vector<uint32_t> _table;
+  uint32_t _tableMask;
+
+  std::unique_ptr<std::atomic<bool>[]> _found;
+  std::atomic<size_t> _remaining;
+};
+
+#endif  // PROJEKT_TARGETSET_H_
@@ -0,0 +1,201 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./Topology.h"
+
+// Constructor, a single CPU until detect() is called
+Topology::Topology() : _nodes(1), _cores(1), _quota(0) {
+  Cpu cpu = { 0, 0, 0, 0 };
+  _cpus.push_back(cpu);
+}
+
+void Topology::detect() {
+  vector<unsigned> allowed;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (unsigned i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &set)) allowed.push_back(i);
+    }
+  }
+  // without an affinity mask every online CPU is allowed
+  if (allowed.empty()) {
+    for (int i = 0; i < get_nprocs(); i++) allowed.push_back(i);
+  }
+  detect(allowed, "");
+}
+
+void Topology::detect(const vector<unsigned>& allowed, const string& root) {
+  // the node of every CPU, CPUs without one are on node 0
+  std::map<unsigned, unsigned> nodeOf;
+  const string kNodes = root + "/sys/devices/system/node";
+  DIR* dir = opendir(kNodes.c_str());
+  if (dir != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      unsigned node;
+      char rest;
+      if (sscanf(entry->d_name, "node%u%c", &node, &rest) != 1) continue;
+      string list;
+      if (!readLine(kNodes + "/" + entry->d_name + "/cpulist", &list)) {
+        continue;
+      }
+      vector<unsigned> cpus = parseList(list);
+      for (size_t i = 0; i < cpus.size(); i++) nodeOf[cpus[i]] = node;
+    }
+    closedir(dir);
+  }
+
+  _cpus.clear();
+  std::map<unsigned, unsigned> nodeIndex;
+  std::set<std::pair<unsigned, unsigned> > cores;
+  vector<unsigned> sorted(allowed);
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); i++) {
+    Cpu cpu;
+    cpu.id = sorted[i];
+    char path[128];
+    string value;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/",
+        cpu.id);
+    // without topology files every CPU is a core of its own
+    cpu.core = readLine(root + path + "core_id", &value)
+        ? atoi(value.c_str()) : cpu.id;
+    cpu.package = readLine(root + path + "physical_package_id", &value)
+        ? atoi(value.c_str()) : 0;
+    const unsigned kNode = nodeOf.count(cpu.id) ? nodeOf[cpu.id] : 0;
+    if (!nodeIndex.count(kNode)) {
+      const unsigned kIndex = nodeIndex.size();
+      nodeIndex[kNode] = kIndex;
+    }
+    cpu.node = nodeIndex[kNode];
+    cores.insert(std::make_pair(cpu.package, cpu.core));
+    _cpus.push_back(cpu);
+  }
+  _nodes = std::max<size_t>(nodeIndex.size(), 1);
+  _cores = cores.size();
+  _quota = readQuota(root);
+}
+
+vector<Topology::Cpu> Topology::workers(bool noSmt) const {
+  // rank 0 for the first CPU of a core, 1 for its first sibling and so on
+  std::map<std::pair<unsigned, unsigned>, unsigned> seen;
+  vector<std::pair<unsigned, size_t> > order;
+  for (size_t i = 0; i < _cpus.size(); i++) {
+    const unsigned kRank = seen[std::make_pair(_cpus[i].package,
+        _cpus[i].core)]++;
+    if (noSmt && kRank > 0) continue;
+    order.push_back(std::make_pair(kRank, i));
+  }
+  std::sort(order.begin(), order.end());
+  size_t count = order.size();
+  if (_quota > 0) {
+    count = std::min(count, std::max<size_t>(1, static_cast<size_t>(
+        _quota + 0.999)));
+  }
+  vector<Cpu> result;
+  for (size_t i = 0; i < count; i++) result.push_back(_cpus[order[i].second]);
+  return result;
+}
+
+bool Topology::pin(unsigned cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+vector<unsigned> Topology::parseList(const string& list) {
+  vector<unsigned> cpus;
+  size_t position = 0;
+  while (position < list.size()) {
+    unsigned first;
+    int used = 0;
+    const char* range = list.c_str() + position;
+    if (sscanf(range, "%u%n", &first, &used) != 1) break;
+    // a single CPU or a range first-last
+    unsigned last = first;
+    int more = 0;
+    if (range[used] == '-'
+        && sscanf(range + used + 1, "%u%n", &last, &more) == 1) {
+      used += more + 1;
+    }
+    for (unsigned cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    position += used + 1;
+  }
+  return cpus;
+}
+
+bool Topology::readLine(const string& fileName, string* line) {
+  std::ifstream file(fileName.c_str());
+  return file.is_open() && std::getline(file, *line);
+}
+
+double Topology::readQuota(const string& root) {
+  // the cgroups of this process, v2 is the line 0::<path>
+  string v1Path;
+  string v2Path;
+  std::ifstream cgroups((root + "/proc/self/cgroup").c_str());
+  string line;
+  while (std::getline(cgroups, line)) {
+    const size_t kFirst = line.find(':');
+    const size_t kSecond = line.find(':', kFirst + 1);
+    if (kFirst == string::npos || kSecond == string::npos) continue;
+    const string kControllers = "," + line.substr(kFirst + 1,
+        kSecond - kFirst - 1) + ",";
+    if (line.compare(0, kFirst, "0") == 0 && kControllers == ",,") {
+      v2Path = line.substr(kSecond + 1);
+    } else if (kControllers.find(",cpu,") != string::npos) {
+      v1Path = line.substr(kSecond + 1);
+    }
+  }
+
+  // a container sees its own cgroup as the root, so the path is tried up
+  // to the root and every level may have a smaller limit
+  double quota = 0;
+  const char* kV1Mounts[] = { "/sys/fs/cgroup/cpu",
+    "/sys/fs/cgroup/cpu,cpuacct" };
+  for (string path = v2Path.empty() ? v1Path : v2Path; ; ) {
+    double limit = 0;
+    string value;
+    if (!v2Path.empty()) {
+      char max[32];
+      double period;
+      if (readLine(root + "/sys/fs/cgroup" + path + "/cpu.max", &value)
+          && sscanf(value.c_str(), "%31s %lf", max, &period) == 2
+          && string(max) != "max" && period > 0) {
+        limit = atof(max) / period;
+      }
+    } else {
+      for (unsigned i = 0; i < 2 && limit == 0; i++) {
+        const string kDir = root + kV1Mounts[i] + path;
+        string period;
+        if (readLine(kDir + "/cpu.cfs_quota_us", &value)
+            && readLine(kDir + "/cpu.cfs_period_us", &period)
+            && atof(value.c_str()) > 0 && atof(period.c_str()) > 0) {
+          limit = atof(value.c_str()) / atof(period.c_str());
+        }
+      }
+    }
+    if (limit > 0 && (quota == 0 || limit < quota)) quota = limit;
+    if (path.empty() || path == "/") break;
+    const size_t kSlash = path.rfind('/');
+    path = kSlash == 0 || kSlash == string::npos ? "/"
+        : path.substr(0, kSlash);
+  }
+  return quota;
+}
@@ -0,0 +1,75 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_TOPOLOGY_H_
+#define PROJEKT_TOPOLOGY_H_
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// The CPUs this process may run on with their cores and NUMA nodes, and the
+// CPU time its cgroup grants it. The CPUs come from the affinity mask, the
+// cores and nodes from /sys/devices/system and the quota from cpu.max
+// (cgroup v2) or cpu.cfs_quota_us (cgroup v1).
+//
+// usage: 1) detect() once at startup
+//        2) start one worker for every CPU of workers(), each worker may
+//           pin() itself to its CPU
+class Topology {
+ public:
+  struct Cpu {
+    unsigned id;
+    // core and package as numbered by the kernel
+    unsigned core;
+    unsigned package;
+    // NUMA node, counted from 0 over the nodes with allowed CPUs
+    unsigned node;
+  };
+
+  Topology();
+
+  // Read the topology of the machine we are running on.
+  void detect();
+
+  // The same for the allowed CPUs with the files below root, for tests.
+  void detect(const vector<unsigned>& allowed, const string& root);
+
+  // the allowed CPUs, sorted by id
+  const vector<Cpu>& cpus() const { return _cpus; }
+
+  // number of NUMA nodes and of cores with allowed CPUs
+  unsigned nodes() const { return _nodes; }
+  unsigned cores() const { return _cores; }
+
+  // CPUs granted by the cgroup quota, 0 if there is no quota
+  double quota() const { return _quota; }
+
+  // The CPUs to start a worker on: the first CPU of every core before the
+  // SMT siblings, only the first one with noSmt, and no more than the
+  // quota rounded up.
+  vector<Cpu> workers(bool noSmt) const;
+
+  // Pin the calling thread to the CPU, returns false if it fails.
+  static bool pin(unsigned cpu);
+
+ private:
+  // Parse a CPU list like 0-3,8-11.
+  static vector<unsigned> parseList(const string& list);
+
+  // Read the first line of a file, false if it does not exist.
+  static bool readLine(const string& fileName, string* line);
+
+  // The smallest quota of the cgroup and its parents, 0 for none.
+  static double readQuota(const string& root);
+
+  vector<Cpu> _cpus;
+  unsigned _nodes;
+  unsigned _cores;
+  double _quota;
+};
+
+#endif  // PROJEKT_TOPOLOGY_H_
@@ -0,0 +1,161 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include "./WordStream.h"
+
+// Constructor, the buffers are allocated once the file is opened
+WordStream::WordStream() : _fd(-1), _ownsFd(false), _memory(NULL),
+    _free(kBuffers), _full(kBuffers), _done(true), _skippedLines(0) {
+}
+
+// Destructor
+WordStream::~WordStream() {
+  close();
+}
+
+bool WordStream::open(const char* fileName) {
+  close();
+  if (strcmp(fileName, "-") == 0) {
+    _fd = STDIN_FILENO;
+    _ownsFd = false;
+  } else {
+    _fd = ::open(fileName, O_RDONLY);
+    _ownsFd = true;
+    if (_fd < 0) return false;
+  }
+  _memory = new char[kBuffers * kBufferSize];
+  WordBuffer* buffer;
+  while (_free.pop(&buffer)) {}
+  while (_full.pop(&buffer)) {}
+  for (unsigned i = 0; i < kBuffers; i++) {
+    _buffers[i].data = _memory + i * kBufferSize;
+    _buffers[i].used = 0;
+    _free.push(&_buffers[i]);
+  }
+  _done = false;
+  _skippedLines = 0;
+  return true;
+}
+
+void WordStream::close() {
+  if (_fd >= 0 && _ownsFd) ::close(_fd);
+  _fd = -1;
+  _done = true;
+  delete[] _memory;
+  _memory = NULL;
+}
+
+WordBuffer* WordStream::takeFree(const std::atomic<bool>& stop) {
+  WordBuffer* buffer;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_free.pop(&buffer)) {
+    if (stop.load(std::memory_order_relaxed)) return NULL;
+    // the workers which set stop do not know the stream, so look again
+    // now and then
+    _freed.wait_for(lock, std::chrono::milliseconds(kStopPoll));
+  }
+  buffer->used = 0;
+  return buffer;
+}
+
+void WordStream::pass(BoundedQueue<WordBuffer*>* ring, WordBuffer* buffer) {
+  // the ring holds all buffers of the pool, so it is never full
+  ring->push(buffer);
+  // a waiting thread looked at the ring with the lock held, so it is
+  // either waiting now or sees the buffer
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (ring == &_free) {
+    _freed.notify_one();
+  } else {
+    _filled.notify_one();
+  }
+}
+
+void WordStream::read(const std::atomic<bool>& stop) {
+  WordBuffer* buffer = takeFree(stop);
+  // whether we are dropping the rest of a line longer than a buffer
+  bool skipping = false;
+  bool eof = false;
+  while (buffer != NULL && !eof && !stop.load(std::memory_order_relaxed)) {
+    // a single read, a pipe delivers what has been written so far
+    ssize_t n = ::read(_fd, buffer->data + buffer->used,
+        kBufferSize - buffer->used);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      eof = true;
+    } else {
+      buffer->used += n;
+    }
+
+    if (skipping) {
+      char* newline = static_cast<char*>(
+          memchr(buffer->data, '\n', buffer->used));
+      if (newline == NULL) {
+        buffer->used = 0;
+        continue;
+      }
+      skipping = false;
+      size_t rest = buffer->data + buffer->used - (newline + 1);
+      memmove(buffer->data, newline + 1, rest);
+      buffer->used = rest;
+    }
+
+    // the incomplete last line goes to the front of the next buffer
+    size_t end = buffer->used;
+    if (!eof) {
+      char* newline = static_cast<char*>(
+          memrchr(buffer->data, '\n', buffer->used));
+      // read on for the end of the line unless it fills the buffer
+      if (newline == NULL && buffer->used < kBufferSize) continue;
+      if (newline == NULL) {
+        _skippedLines++;
+        skipping = true;
+        buffer->used = 0;
+        continue;
+      }
+      end = newline + 1 - buffer->data;
+    }
+    WordBuffer* next = NULL;
+    if (!eof) {
+      next = takeFree(stop);
+      if (next != NULL) {
+        memcpy(next->data, buffer->data + end, buffer->used - end);
+        next->used = buffer->used - end;
+      }
+    }
+    buffer->used = end;
+    if (end > 0) {
+      pass(&_full, buffer);
+    } else {
+      recycle(buffer);
+    }
+    buffer = next;
+  }
+  if (buffer != NULL) recycle(buffer);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _done.store(true, std::memory_order_release);
+  _filled.notify_all();
+}
+
+WordBuffer* WordStream::take() {
+  WordBuffer* buffer;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    // check for the end before the ring, the last buffer is pushed before
+    // the reader is done
+    bool done = _done.load(std::memory_order_acquire);
+    if (_full.pop(&buffer)) return buffer;
+    if (done) return NULL;
+    _filled.wait(lock);
+  }
+}
+
+void WordStream::recycle(WordBuffer* buffer) {
+  pass(&_free, buffer);
+}
@@ -0,0 +1,99 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_WORDSTREAM_H_
+#define PROJEKT_WORDSTREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "./BoundedQueue.h"
+
+// A buffer of complete lines read from the dictionary.
+struct WordBuffer {
+  char* data;
+  size_t used;
+};
+
+// Reads a dictionary of any size, also from a pipe, with bounded memory.
+// A reader thread fills a fixed pool of buffers with complete lines and
+// passes them through a lock-free ring to the workers, which give them
+// back to the pool after hashing. A buffer is passed on as soon as a read
+// delivered complete lines, so a slow pipe is hashed while it is written.
+// When all buffers are in use the reader sleeps, and so do workers without
+// a buffer, so reading overlaps with hashing but never runs ahead further
+// than the pool.
+//
+// usage: 1) open() the file, "-" is standard input
+//        2) one thread runs read(), the workers take() and recycle()
+//           buffers until take() returns NULL
+class WordStream {
+ public:
+  // size of one buffer, longer lines are skipped
+  static const size_t kBufferSize = 1 << 20;
+  // number of buffers in the pool
+  static const unsigned kBuffers = 16;
+
+  WordStream();
+  ~WordStream();
+
+  // Open the file, returns false if it cannot be opened.
+  bool open(const char* fileName);
+
+  // Close the file.
+  void close();
+
+  bool isOpen() const { return _fd >= 0; }
+
+  // The reader stage, returns at the end of the file or when stop is set.
+  void read(const std::atomic<bool>& stop);
+
+  // Wait for the next buffer, NULL once the reader has finished and all
+  // buffers are taken.
+  WordBuffer* take();
+
+  // Give a buffer back to the pool after hashing it.
+  void recycle(WordBuffer* buffer);
+
+  // number of lines skipped because they were longer than a buffer
+  uint64_t skippedLines() const { return _skippedLines; }
+
+ private:
+  // milliseconds between two looks at the stop flag of a waiting reader
+  static const int kStopPoll = 10;
+
+  // Wait for a free buffer, NULL if stop is set while waiting.
+  WordBuffer* takeFree(const std::atomic<bool>& stop);
+
+  // Push the buffer to the ring and wake up a thread waiting for it.
+  void pass(BoundedQueue<WordBuffer*>* ring, WordBuffer* buffer);
+
+  int _fd;
+  bool _ownsFd;
+
+  WordBuffer _buffers[kBuffers];
+  char* _memory;
+
+  // empty buffers for the reader and filled ones for the workers
+  BoundedQueue<WordBuffer*> _free;
+  BoundedQueue<WordBuffer*> _full;
+
+  // set by the reader after it pushed its last buffer
+  std::atomic<bool> _done;
+
+  // the reader waits for _free, the workers wait for _full or _done
+  std::mutex _mutex;
+  std::condition_variable _freed;
+  std::condition_variable _filled;
+
+  uint64_t _skippedLines;
+
+  // no copies
+  WordStream(const WordStream&);
+  WordStream& operator=(const WordStream&);
+};
+
+#endif  // PROJEKT_WORDSTREAM_H_
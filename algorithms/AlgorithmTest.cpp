@@ -3,9 +3,34 @@
 // Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
 #include <string>
+#include <vector>
+#include "./CpuFeatures.h"
 #include "./MD5.h"
+#include "./MD5Simd.h"
 #include "./SHA1.h"
+#include "./SHA1Simd.h"
+
+// Test the cpuid detection against the one of the compiler runtime
+TEST(CpuFeatures, TestingDetectionIsCorrect) {
+  __builtin_cpu_init();
+  ASSERT_TRUE(CpuFeatures::has(0));
+  ASSERT_EQ(static_cast<bool>(__builtin_cpu_supports("sse2")),
+      CpuFeatures::has(CpuFeatures::kSSE2));
+  ASSERT_EQ(static_cast<bool>(__builtin_cpu_supports("sse4.1")),
+      CpuFeatures::has(CpuFeatures::kSSE41));
+  ASSERT_EQ(static_cast<bool>(__builtin_cpu_supports("avx2")),
+      CpuFeatures::has(CpuFeatures::kAVX2));
+  ASSERT_EQ(static_cast<bool>(__builtin_cpu_supports("avx512f")),
+      CpuFeatures::has(CpuFeatures::kAVX512F));
+  ASSERT_EQ(static_cast<bool>(__builtin_cpu_supports("sha")),
+      CpuFeatures::has(CpuFeatures::kSHA));
+  ASSERT_TRUE(MD5Simd::supported(MD5Simd::best()));
+  ASSERT_TRUE(SHA1Simd::supported(SHA1Simd::best()));
+  ASSERT_NE(std::string::npos, CpuFeatures::describe().find("sse2"));
+}
 
 // Test generating MD5-hashes
 TEST(MD5, TestingHashIsCorrect) {
@@ -22,6 +47,92 @@ TEST(MD5, TestingHashIsCorrect) {
   delete test;
 }
 
+// Test the single block shortcut against the streaming API
+TEST(MD5, TestingSingleBlockIsCorrect) {
+  uint32_t state[4];
+  MD5::digestSingleBlock("Message-Digest Algorithm 5 (MD5)", 32, state);
+  ASSERT_STREQ(MD5::hexdigest(state).c_str(),
+      "291c6183ebadebd1a87aa6074176a837");
+
+  // every length up to the longest one fitting into one block
+  std::string mystr(MD5::kMaxSingleBlock, 'x');
+  for (size_t i = 0; i <= MD5::kMaxSingleBlock; i++) {
+    MD5::digestSingleBlock(mystr.c_str(), i, state);
+    ASSERT_EQ(MD5(mystr.substr(0, i)).hexdigest(), MD5::hexdigest(state));
+  }
+}
+
+// Test every SIMD kernel the CPU supports against the scalar MD5
+TEST(MD5Simd, TestingLanesAreCorrect) {
+  const MD5Simd::Kernel kKernels[] = { MD5Simd::kScalar, MD5Simd::kSSE2,
+    MD5Simd::kAVX2, MD5Simd::kAVX512 };
+  const std::string kMessages[] = { "Message-Digest Algorithm 5 (MD5)",
+    "Ronald L. Rivest 1991", "", std::string(MD5::kMaxSingleBlock, 'x') };
+  for (unsigned i = 0; i < 4; i++) {
+    if (!MD5Simd::supported(kKernels[i])) continue;
+    const unsigned kLanes = MD5Simd::lanes(kKernels[i]);
+    for (unsigned m = 0; m < 4; m++) {
+      uint32_t target[4];
+      MD5::digestSingleBlock(kMessages[m].c_str(), kMessages[m].size(),
+          target);
+      // the message goes into the last lane, the others get a different one
+      LaneBlock block;
+      for (unsigned j = 0; j < kLanes; j++) {
+        const std::string& other = kMessages[(m + 1) % 4];
+        MD5Simd::setLane(&block, j, other.c_str(), other.size());
+      }
+      MD5Simd::setLane(&block, kLanes - 1, kMessages[m].c_str(),
+          kMessages[m].size());
+      ASSERT_EQ(1u << (kLanes - 1), MD5Simd::match(kKernels[i], block, target))
+          << MD5Simd::name(kKernels[i]);
+      LaneDigests digests;
+      MD5Simd::digest(kKernels[i], block, &digests);
+      for (unsigned w = 0; w < 4; w++) {
+        ASSERT_EQ(target[w], digests.words[w][kLanes - 1]);
+      }
+    }
+  }
+}
+
+// Test the prefix kernels against whole blocks, the lanes of the batch
+// only differ in one word
+TEST(MD5Simd, TestingPrefixIsCorrect) {
+  const MD5Simd::Kernel kKernels[] = { MD5Simd::kScalar, MD5Simd::kSSE2,
+    MD5Simd::kAVX2, MD5Simd::kAVX512 };
+  for (unsigned i = 0; i < 4; i++) {
+    if (!MD5Simd::supported(kKernels[i])) continue;
+    const unsigned kLanes = MD5Simd::lanes(kKernels[i]);
+    for (unsigned word = 0; word <= kMaxPrefixWord; word++) {
+      LaneBlock block;
+      for (unsigned j = 0; j < kLanes; j++) {
+        std::string message("Ronald L. Rivest 1991");
+        message[4 * word + j % 4] = 'a' + j;
+        MD5Simd::setLane(&block, j, message.c_str(), message.size());
+      }
+      uint32_t shared[16];
+      for (unsigned w = 0; w < 16; w++) shared[w] = block.words[w][0];
+      LanePrefix prefix;
+      MD5Simd::prepare(shared, word, &prefix);
+
+      LaneDigests digests, prefixDigests;
+      MD5Simd::digest(kKernels[i], block, &digests);
+      MD5Simd::digestPrefix(kKernels[i], prefix, block, &prefixDigests);
+      for (unsigned j = 0; j < kLanes; j++) {
+        for (unsigned w = 0; w < 4; w++) {
+          ASSERT_EQ(digests.words[w][j], prefixDigests.words[w][j])
+              << MD5Simd::name(kKernels[i]) << " word " << word;
+        }
+      }
+      uint32_t target[4];
+      for (unsigned w = 0; w < 4; w++) {
+        target[w] = digests.words[w][kLanes - 1];
+      }
+      ASSERT_EQ(1u << (kLanes - 1),
+          MD5Simd::matchPrefix(kKernels[i], prefix, block, target));
+    }
+  }
+}
+
 // Test generating SHA1-hashes
 TEST(SHA1, TestingHashIsCorrect) {
   SHA1 * test = new SHA1("secure hash algorithm (SHA-1)");
@@ -35,3 +146,165 @@ TEST(SHA1, TestingHashIsCorrect) {
       "3065cba73613f3ad4209a3bb0c08f5dbf35fba24");
   delete test;
 }
+
+// Test feeding a message in pieces of every size through the byte buffer
+// and through the stream adapter
+TEST(SHA1, TestingUpdateIsCorrect) {
+  std::string message;
+  for (unsigned i = 0; i < 300; i++) message += static_cast<char>(i * 7);
+  SHA1 whole;
+  whole.update(message);
+  const std::string kExpected = whole.finalize().hexdigest();
+  ASSERT_EQ(SHA1(message).hexdigest(), kExpected);
+  for (size_t piece = 1; piece <= 130; piece++) {
+    SHA1 test;
+    for (size_t i = 0; i < message.size(); i += piece) {
+      test.update(reinterpret_cast<const uint8_t*>(message.data()) + i,
+          std::min(piece, message.size() - i));
+    }
+    ASSERT_EQ(kExpected, test.finalize().hexdigest()) << piece;
+  }
+  std::istringstream stream(message);
+  SHA1 test;
+  test.update(&stream);
+  ASSERT_EQ(kExpected, test.finalize().hexdigest());
+}
+
+// Test every SHA-1 batch kernel the CPU supports against the SHA1 class
+TEST(SHA1Simd, TestingLanesAreCorrect) {
+  const SHA1Simd::Kernel kKernels[] = { SHA1Simd::kScalar, SHA1Simd::kSSE2,
+    SHA1Simd::kAVX2, SHA1Simd::kAVX512, SHA1Simd::kSHANI };
+  const std::string kMessages[] = { "secure hash algorithm (SHA-1)",
+    "United States National Security Agency 1995", "",
+    std::string(SHA1::kMaxSingleBlock, 'x') };
+  for (unsigned i = 0; i < 5; i++) {
+    if (!SHA1Simd::supported(kKernels[i])) continue;
+    const unsigned kLanes = SHA1Simd::lanes(kKernels[i]);
+    for (unsigned m = 0; m < 4; m++) {
+      SHA1 sha1(kMessages[m]);
+      // the message goes into the last lane, the others get a different one
+      LaneBlock block;
+      for (unsigned j = 0; j < kLanes; j++) {
+        const std::string& other = kMessages[(m + 1) % 4];
+        SHA1Simd::setLane(&block, j, other.c_str(), other.size());
+      }
+      SHA1Simd::setLane(&block, kLanes - 1, kMessages[m].c_str(),
+          kMessages[m].size());
+      ASSERT_EQ(1u << (kLanes - 1),
+          SHA1Simd::match(kKernels[i], block, sha1.rawdigest()))
+          << SHA1Simd::name(kKernels[i]);
+      LaneDigests digests;
+      SHA1Simd::digest(kKernels[i], block, &digests);
+      for (unsigned w = 0; w < 5; w++) {
+        ASSERT_EQ(sha1.rawdigest()[w], digests.words[w][kLanes - 1]);
+      }
+    }
+  }
+}
+
+// The same for the SHA-1 prefix kernels
+TEST(SHA1Simd, TestingPrefixIsCorrect) {
+  const SHA1Simd::Kernel kKernels[] = { SHA1Simd::kScalar, SHA1Simd::kSSE2,
+    SHA1Simd::kAVX2, SHA1Simd::kAVX512, SHA1Simd::kSHANI };
+  for (unsigned i = 0; i < 5; i++) {
+    if (!SHA1Simd::supported(kKernels[i])) continue;
+    const unsigned kLanes = SHA1Simd::lanes(kKernels[i]);
+    for (unsigned word = 0; word <= kMaxPrefixWord; word++) {
+      LaneBlock block;
+      for (unsigned j = 0; j < kLanes; j++) {
+        std::string message("secure hash algorithm (SHA-1)");
+        message[4 * word + j % 4] = 'a' + j;
+        SHA1Simd::setLane(&block, j, message.c_str(), message.size());
+      }
+      uint32_t shared[16];
+      for (unsigned w = 0; w < 16; w++) shared[w] = block.words[w][0];
+      LanePrefix prefix;
+      SHA1Simd::prepare(shared, word, &prefix);
+
+      LaneDigests digests, prefixDigests;
+      SHA1Simd::digest(kKernels[i], block, &digests);
+      SHA1Simd::digestPrefix(kKernels[i], prefix, block, &prefixDigests);
+      for (unsigned j = 0; j < kLanes; j++) {
+        for (unsigned w = 0; w < 5; w++) {
+          ASSERT_EQ(digests.words[w][j], prefixDigests.words[w][j])
+              << SHA1Simd::name(kKernels[i]) << " word " << word;
+        }
+      }
+      uint32_t target[5];
+      for (unsigned w = 0; w < 5; w++) {
+        target[w] = digests.words[w][kLanes - 1];
+      }
+      ASSERT_EQ(1u << (kLanes - 1),
+          SHA1Simd::matchPrefix(kKernels[i], prefix, block, target));
+    }
+  }
+}
+
+// Hash messages of 0 to 199 bytes with hashBatch() in batches of different
+// sizes, so every kernel and every padding case is used, and compare them
+// with the digests of reference.
+static void testBatch(HashAlgorithm* hash,
+    void (*reference)(const std::string& message, uint32_t* digest)) {
+  const size_t kMessages = 200;
+  const unsigned kWords = hash->digestWords();
+  std::string arena;
+  std::vector<size_t> lengths(kMessages);
+  std::vector<HashAlgorithm::Message> messages(kMessages);
+  for (size_t i = 0; i < kMessages; i++) {
+    lengths[i] = i;
+    for (size_t k = 0; k < i; k++) arena += static_cast<char>('a' + i + k);
+  }
+  for (size_t i = 0, offset = 0; i < kMessages; offset += lengths[i++]) {
+    messages[i].data = arena.data() + offset;
+    messages[i].length = lengths[i];
+  }
+  std::vector<uint32_t> expected(kMessages * kWords);
+  for (size_t i = 0; i < kMessages; i++) {
+    reference(std::string(messages[i].data, messages[i].length),
+        &expected[i * kWords]);
+  }
+
+  const size_t kBatches[] = { 1, 2, 3, 4, 5, 8, 9, 16, 17, kMessages };
+  for (unsigned b = 0; b < sizeof(kBatches) / sizeof(kBatches[0]); b++) {
+    std::vector<uint32_t> digests(kMessages * kWords);
+    for (size_t first = 0; first < kMessages; first += kBatches[b]) {
+      const size_t kCount = std::min(kBatches[b], kMessages - first);
+      hash->hashBatch(&messages[first], kCount, &digests[first * kWords]);
+    }
+    ASSERT_EQ(expected, digests) << "batches of " << kBatches[b];
+  }
+
+  // the same messages back to back in one arena
+  std::vector<uint32_t> digests(kMessages * kWords);
+  hash->hashBatch(arena.data(), &lengths[0], kMessages, &digests[0]);
+  ASSERT_EQ(expected, digests);
+}
+
+// the streaming APIs as reference for the batches
+static void md5Update(const std::string& message, uint32_t* digest) {
+  MD5 md5;
+  md5.update(message.c_str(), message.size());
+  md5.finalize();
+  std::copy(md5.rawdigest(), md5.rawdigest() + 4, digest);
+}
+
+static void sha1Update(const std::string& message, uint32_t* digest) {
+  SHA1 sha1;
+  sha1.update(message);
+  sha1.finalize();
+  std::copy(sha1.rawdigest(), sha1.rawdigest() + 5, digest);
+}
+
+// Test the MD5 batch API against the streaming API
+TEST(MD5, TestingBatchIsCorrect) {
+  MD5 hash;
+  ASSERT_EQ(4u, hash.digestWords());
+  testBatch(&hash, md5Update);
+}
+
+// Test the SHA-1 batch API against the streaming API
+TEST(SHA1, TestingBatchIsCorrect) {
+  SHA1 hash;
+  ASSERT_EQ(5u, hash.digestWords());
+  testBatch(&hash, sha1Update);
+}
@@ -0,0 +1,55 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <cpuid.h>
+#include <stdint.h>
+#include <string>
+#include "./CpuFeatures.h"
+
+// the register state enabled by the operating system in XCR0
+static uint64_t enabledState() {
+  uint32_t low, high;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return ((uint64_t)high << 32) | low;
+}
+
+unsigned CpuFeatures::detect() {
+  unsigned eax, ebx, ecx, edx;
+  unsigned features = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return features;
+  if (edx & bit_SSE2) features |= kSSE2;
+  if (ecx & bit_SSE4_1) features |= kSSE41;
+
+  // SSE and AVX registers (bits 1, 2), AVX-512 adds the opmask and upper
+  // ZMM registers (bits 5 to 7)
+  const uint64_t kState = (ecx & bit_OSXSAVE) ? enabledState() : 0;
+  const bool kAVXState = (kState & 0x6) == 0x6;
+  const bool kAVX512State = (kState & 0xe6) == 0xe6;
+
+  if (__get_cpuid_max(0, NULL) < 7) return features;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if ((ebx & bit_AVX2) && kAVXState) features |= kAVX2;
+  if ((ebx & bit_AVX512F) && kAVX512State) features |= kAVX512F;
+  if (ebx & bit_SHA) features |= kSHA;
+  return features;
+}
+
+bool CpuFeatures::has(unsigned features) {
+  static const unsigned kDetected = detect();
+  return (kDetected & features) == features;
+}
+
+std::string CpuFeatures::describe() {
+  const struct { Feature feature; const char* name; } kNames[] = {
+    { kSSE2, "sse2" }, { kSSE41, "sse4.1" }, { kAVX2, "avx2" },
+    { kAVX512F, "avx512f" }, { kSHA, "sha" }
+  };
+  std::string result;
+  for (unsigned i = 0; i < sizeof(kNames) / sizeof(kNames[0]); i++) {
+    if (!has(kNames[i].feature)) continue;
+    if (!result.empty()) result += ' ';
+    result += kNames[i].name;
+  }
+  return result.empty() ? "none" : result;
+}
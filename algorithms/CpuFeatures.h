@@ -0,0 +1,35 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_ALGORITHMS_CPUFEATURES_H_
+#define PROJEKT_ALGORITHMS_CPUFEATURES_H_
+
+#include <string>
+
+// The instruction set extensions of the CPU we are running on, read once
+// with cpuid on first use. AVX2 and AVX-512 also need the operating system
+// to save their registers, which xgetbv tells. The kernels are compiled
+// with per-function target attributes for all of them, this decides at
+// runtime which ones may be called.
+class CpuFeatures {
+ public:
+  enum Feature {
+    kSSE2 = 1 << 0,
+    kSSE41 = 1 << 1,
+    kAVX2 = 1 << 2,
+    kAVX512F = 1 << 3,
+    kSHA = 1 << 4
+  };
+
+  // whether the CPU has all the features of the mask
+  static bool has(unsigned features);
+
+  // the names of the detected features separated by blanks
+  static std::string describe();
+
+ private:
+  static unsigned detect();
+};
+
+#endif  // PROJEKT_ALGORITHMS_CPUFEATURES_H_
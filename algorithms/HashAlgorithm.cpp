@@ -17,6 +17,7 @@ void HashAlgorithm::reset() {
 }
 
 void HashAlgorithm::update(const std::string &s) {
+  update(s.data(), s.size());
 }
 
 void HashAlgorithm::update(const char *buf, size_t length) {
@@ -33,3 +34,41 @@ HashAlgorithm& HashAlgorithm::finalize() {
 std::string HashAlgorithm::hexdigest() const {
   return std::string("");
 }
+
+const uint32_t* HashAlgorithm::rawdigest() const {
+  return NULL;
+}
+
+unsigned HashAlgorithm::digestWords() const {
+  return 0;
+}
+
+void HashAlgorithm::hashBatch(const Message* messages, size_t n,
+  uint32_t* digests) {
+  const unsigned kWords = digestWords();
+  for (size_t i = 0; i < n; i++) {
+    reset();
+    update(messages[i].data, messages[i].length);
+    finalize();
+    const uint32_t* digest = rawdigest();
+    for (unsigned w = 0; w < kWords; w++) digests[i * kWords + w] = digest[w];
+  }
+}
+
+// the messages are passed on in groups of kGroup, so the arena can be as
+// large as the caller likes
+void HashAlgorithm::hashBatch(const char* arena, const size_t* lengths,
+  size_t n, uint32_t* digests) {
+  static const size_t kGroup = 256;
+  Message messages[kGroup];
+  const unsigned kWords = digestWords();
+  for (size_t first = 0; first < n; first += kGroup) {
+    const size_t kCount = n - first < kGroup ? n - first : kGroup;
+    for (size_t i = 0; i < kCount; i++) {
+      messages[i].data = arena;
+      messages[i].length = lengths[first + i];
+      arena += lengths[first + i];
+    }
+    hashBatch(messages, kCount, digests + first * kWords);
+  }
+}
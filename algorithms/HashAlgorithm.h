@@ -19,6 +19,29 @@ class HashAlgorithm {
   virtual void reset();
   virtual HashAlgorithm& finalize();
   virtual std::string hexdigest() const;
+  // the digest as native state words, NULL if not finalized
+  virtual const uint32_t* rawdigest() const;
+
+  // number of state words of a raw digest
+  virtual unsigned digestWords() const;
+
+  // one message of a batch
+  struct Message {
+    const char* data;
+    size_t length;
+  };
+
+  // Hash n independent messages and store their raw digests one after
+  // another in digests, digestWords() words each. MD5 and SHA1 hash them
+  // in the lanes of their SIMD kernels, the default goes through reset(),
+  // update() and finalize(), so it discards a hash in progress.
+  virtual void hashBatch(const Message* messages, size_t n,
+    uint32_t* digests);
+
+  // The same for n messages stored back to back in arena, message i is
+  // lengths[i] bytes long.
+  void hashBatch(const char* arena, const size_t* lengths, size_t n,
+    uint32_t* digests);
 
  protected:
   bool finalized;
@@ -0,0 +1,71 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_ALGORITHMS_LANEBATCH_H_
+#define PROJEKT_ALGORITHMS_LANEBATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "./HashAlgorithm.h"
+#include "./LaneBlock.h"
+#include "./MD5.h"
+
+// Hash n messages of any length with the widest kernel of Simd (MD5Simd or
+// SHA1Simd) and store words raw digest words per message in digests. Every
+// lane works through its message one block per kernel call and takes the
+// next message as soon as it is done, so short and long messages can be
+// mixed without leaving lanes idle.
+template <typename Simd>
+void hashInLanes(const HashAlgorithm::Message* messages, size_t n,
+    unsigned words, uint32_t* digests) {
+  if (n == 0) return;
+  const typename Simd::Kernel kKernel = Simd::best(n);
+  const unsigned kLanes = Simd::lanes(kKernel);
+  LaneBlock block;
+  LaneDigests state;
+  // the message of every lane and its next block
+  size_t message[kMaxLanes];
+  size_t next[kMaxLanes];
+  size_t nStarted = 0;
+  unsigned nBusy = 0;
+  for (unsigned lane = 0; lane < kLanes; lane++) {
+    Simd::startLane(&state, lane);
+    message[lane] = nStarted++;
+    next[lane] = 0;
+    nBusy++;
+  }
+
+  // best() does not return more lanes than messages, so every lane holds
+  // a block from the start and lanes which run out of messages only
+  // repeat their last block
+  while (nBusy > 0) {
+    for (unsigned lane = 0; lane < kLanes; lane++) {
+      if (message[lane] >= n) continue;
+      const HashAlgorithm::Message& m = messages[message[lane]];
+      if (m.length <= MD5::kMaxSingleBlock) {
+        Simd::setLane(&block, lane, m.data, m.length);
+      } else {
+        Simd::setBlock(&block, lane, m.data, m.length, next[lane]);
+      }
+    }
+    Simd::update(kKernel, block, &state);
+    for (unsigned lane = 0; lane < kLanes; lane++) {
+      if (message[lane] >= n) continue;
+      const HashAlgorithm::Message& m = messages[message[lane]];
+      if (++next[lane] < paddedBlocks(m.length)) continue;
+      uint32_t* digest = digests + message[lane] * words;
+      for (unsigned i = 0; i < words; i++) digest[i] = state.words[i][lane];
+      if (nStarted < n) {
+        Simd::startLane(&state, lane);
+        message[lane] = nStarted++;
+        next[lane] = 0;
+      } else {
+        message[lane] = n;
+        nBusy--;
+      }
+    }
+  }
+}
+
+#endif  // PROJEKT_ALGORITHMS_LANEBATCH_H_
@@ -0,0 +1,52 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_ALGORITHMS_LANEBLOCK_H_
+#define PROJEKT_ALGORITHMS_LANEBLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// number of messages hashed at once by the widest kernel (AVX-512)
+static const unsigned kMaxLanes = 16;
+
+// A batch of independent single block messages in structure-of-arrays
+// layout: word i of the message in lane j is stored in words[i][j], so
+// a SIMD kernel loads word i of all lanes with a single vector load.
+struct LaneBlock {
+  uint32_t words[16][kMaxLanes] __attribute__((aligned(64)));
+};
+
+// The digests of a LaneBlock in the same layout, word i of the digest of
+// lane j is stored in words[i][j]. MD5 only uses the first four words.
+struct LaneDigests {
+  uint32_t words[5][kMaxLanes] __attribute__((aligned(64)));
+};
+
+// number of 64 byte blocks of a message after MD5 or SHA-1 padding: the
+// 0x80 byte and the 8 byte bit length have to fit behind the message
+inline size_t paddedBlocks(size_t length) {
+  return (length + 8) / 64 + 1;
+}
+
+// highest message word which may differ between the lanes of a prefix
+// batch, words 0 to 3 hold the characters of combinations up to length 16
+static const unsigned kMaxPrefixWord = 3;
+
+// A batch of messages which only differ in one word: the lanes share all
+// other words of the block. The steps before the first use of that word
+// are done once in prepare() of the kernel, and the shared words are added
+// to the step constants, so zero padding words cost nothing.
+struct LanePrefix {
+  // the message word which differs between the lanes
+  unsigned word;
+  // the state after the steps before the first use of word
+  uint32_t state[5];
+  // the message schedule (MD5 only uses the first 16 words)
+  uint32_t words[80];
+  // step constant plus the shared message word of every step
+  uint32_t constants[80];
+};
+
+#endif  // PROJEKT_ALGORITHMS_LANEBLOCK_H_
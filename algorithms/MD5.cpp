@@ -42,6 +42,8 @@ Programmieren in C++ SS-2012
 
 /* interface header */
 #include "./MD5.h"
+#include "./LaneBatch.h"
+#include "./MD5Simd.h"
 
 // Constants for MD5Transform routine.
 #define S11 7
@@ -113,11 +115,13 @@ MD5::MD5() {
 }
 
 // nifty shortcut constructor, compute MD5 for string
-// and finalize it right away
+// and finalize it right away, a batch of one message
 MD5::MD5(const std::string &text) {
   reset();
-  update(text.c_str(), text.length());
-  finalize();
+  Message message = { text.data(), text.length() };
+  hashBatch(&message, 1, state);
+  encode(digest, state, 16);
+  finalized = true;
 }
 
 void MD5::reset() {
@@ -154,8 +158,17 @@ void MD5::encode(uint8_t output[], const uint32_t input[], size_t len) {
 
 // apply MD5 algorithm on a block
 void MD5::apply(const uint8_t block[kBlocksize]) {
-  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], x[16];
+  uint32_t x[16];
   decode(x, block, kBlocksize);
+  transform(state, x);
+
+  // Zeroize sensitive information.
+  memset(x, 0, sizeof x);
+}
+
+// the 64 MD5 steps on an already decoded block
+void MD5::transform(uint32_t state[4], const uint32_t x[16]) {
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
 
   /* Round 1 */
   FF(&a, b, c, d, x[ 0], S11, 0xd76aa478); /* 1 */
@@ -233,9 +246,25 @@ void MD5::apply(const uint8_t block[kBlocksize]) {
   state[1] += b;
   state[2] += c;
   state[3] += d;
+}
 
-  // Zeroize sensitive information.
-  memset(x, 0, sizeof x);
+// single block MD5, the message is padded and its length in bits
+// appended right here instead of going through update() and finalize()
+void MD5::digestSingleBlock(const char *buf, size_t length,
+  uint32_t state[4]) {
+  uint8_t block[kBlocksize];
+  memcpy(block, buf, length);
+  block[length] = 0x80;
+  memset(block + length + 1, 0, kBlocksize - length - 1);
+  uint32_t x[16];
+  decode(x, block, kBlocksize);
+  x[14] = length << 3;
+
+  state[0] = 0x67452301;
+  state[1] = 0xefcdab89;
+  state[2] = 0x98badcfe;
+  state[3] = 0x10325476;
+  transform(state, x);
 }
 
 // MD5 block update operation. Continues an MD5 message-digest
@@ -325,3 +354,31 @@ std::string MD5::hexdigest() const {
 
   return std::string(buf);
 }
+
+// return the state words, after finalize() they hold the digest
+const uint32_t* MD5::rawdigest() const {
+  if (!finalized)
+    return NULL;
+  return state;
+}
+
+unsigned MD5::digestWords() const {
+  return 4;
+}
+
+void MD5::hashBatch(const Message* messages, size_t n, uint32_t* digests) {
+  hashInLanes<MD5Simd>(messages, n, 4, digests);
+}
+
+// return hex representation of raw state words
+std::string MD5::hexdigest(const uint32_t state[4]) {
+  uint8_t bytes[16];
+  encode(bytes, state, 16);
+
+  char buf[33];
+  for (int i = 0; i < 16; i++)
+    snprintf(buf + i*2, sizeof(buf) - i*2, "%02x", bytes[i]);
+  buf[32]=0;
+
+  return std::string(buf);
+}
@@ -60,6 +60,25 @@ class MD5: public HashAlgorithm {
   void reset();
   MD5& finalize();
   std::string hexdigest() const;
+  const uint32_t* rawdigest() const;
+  unsigned digestWords() const;
+
+  // the messages are hashed in the lanes of the widest SIMD kernel, this
+  // object is not touched
+  void hashBatch(const Message* messages, size_t n, uint32_t* digests);
+  using HashAlgorithm::hashBatch;
+
+  // longest message which still fits into a single padded block
+  static const size_t kMaxSingleBlock = 55;
+
+  // one-shot MD5 of a message of at most kMaxSingleBlock bytes: builds the
+  // padded block on the stack, applies it once and writes the raw state
+  // words to state, no reset(), update() or finalize() involved
+  static void digestSingleBlock(const char *buf, size_t length,
+    uint32_t state[4]);
+
+  // hex representation of raw state words as written by digestSingleBlock
+  static std::string hexdigest(const uint32_t state[4]);
 
  private:
   bool finalized;
@@ -71,6 +90,7 @@ class MD5: public HashAlgorithm {
   uint8_t digest[16];          // the result
 
   void apply(const uint8_t block[kBlocksize]);
+  static void transform(uint32_t state[4], const uint32_t x[16]);
 
   static void decode(uint32_t output[], const uint8_t input[], size_t len);
   static void encode(uint8_t output[], const uint32_t input[], size_t len);
@@ -0,0 +1,454 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <string.h>
+#include <algorithm>
+#include "./MD5Simd.h"
+#include "./CpuFeatures.h"
+
+// GCC vector types, one uint32_t per lane
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef uint32_t v8u __attribute__((vector_size(32)));
+typedef uint32_t v16u __attribute__((vector_size(64)));
+
+// F, G, H and I are basic MD5 functions. They are macros (and not inline
+// functions like in MD5.cpp) so that the same code works on uint32_t and on
+// vector types without passing vectors through function arguments.
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// Step i of MD5 with message word k, the same for all four rounds apart
+// from the function. With a prefix (W >= 0) only word W comes from the
+// lanes, the shared words are already added to the step constants and the
+// steps before the first use of W are done by MD5Simd::prepare().
+#define STEP(f, a, b, c, d, k, s, ac, i) { \
+  if (W < 0) { \
+    a += f(b, c, d) + x[k] + (ac); \
+    a = ROTATE_LEFT(a, s) + b; \
+  } else if ((i) >= W) { \
+    a += f(b, c, d) + prefix->constants[i]; \
+    if ((k) == W) a += x[k]; \
+    a = ROTATE_LEFT(a, s) + b; \
+  } \
+}
+
+// The MD5 steps for all lanes of V. With a target the digests are compared
+// right away, otherwise they are stored in out. Both are compile time
+// constants after inlining, so the unused branch disappears. W is the word
+// which differs between the lanes of a prefix batch, or -1 for a batch of
+// whole blocks. A block of a longer message continues from the states in
+// chain instead of the initial constants.
+template <typename V, int W>
+static inline __attribute__((always_inline)) uint32_t hashLanes(
+  const LaneBlock& block, const LanePrefix* prefix, const uint32_t target[4],
+  const LaneDigests* chain, LaneDigests* out) {
+  const unsigned kLanes = sizeof(V) / sizeof(uint32_t);
+  V x[16];
+  for (int i = 0; i < 16; i++) {
+    if (W < 0 || i == W) memcpy(&x[i], block.words[i], sizeof(V));
+  }
+
+  // the state before this block
+  V a0 = V() + 0x67452301u;
+  V b0 = V() + 0xefcdab89u;
+  V c0 = V() + 0x98badcfeu;
+  V d0 = V() + 0x10325476u;
+  if (chain != NULL) {
+    memcpy(&a0, chain->words[0], sizeof(V));
+    memcpy(&b0, chain->words[1], sizeof(V));
+    memcpy(&c0, chain->words[2], sizeof(V));
+    memcpy(&d0, chain->words[3], sizeof(V));
+  }
+
+  V a = W < 0 ? a0 : V() + prefix->state[0];
+  V b = W < 0 ? b0 : V() + prefix->state[1];
+  V c = W < 0 ? c0 : V() + prefix->state[2];
+  V d = W < 0 ? d0 : V() + prefix->state[3];
+
+  /* Round 1 */
+  STEP(F, a, b, c, d,  0,  7, 0xd76aa478u,  0); /* 1 */
+  STEP(F, d, a, b, c,  1, 12, 0xe8c7b756u,  1); /* 2 */
+  STEP(F, c, d, a, b,  2, 17, 0x242070dbu,  2); /* 3 */
+  STEP(F, b, c, d, a,  3, 22, 0xc1bdceeeu,  3); /* 4 */
+  STEP(F, a, b, c, d,  4,  7, 0xf57c0fafu,  4); /* 5 */
+  STEP(F, d, a, b, c,  5, 12, 0x4787c62au,  5); /* 6 */
+  STEP(F, c, d, a, b,  6, 17, 0xa8304613u,  6); /* 7 */
+  STEP(F, b, c, d, a,  7, 22, 0xfd469501u,  7); /* 8 */
+  STEP(F, a, b, c, d,  8,  7, 0x698098d8u,  8); /* 9 */
+  STEP(F, d, a, b, c,  9, 12, 0x8b44f7afu,  9); /* 10 */
+  STEP(F, c, d, a, b, 10, 17, 0xffff5bb1u, 10); /* 11 */
+  STEP(F, b, c, d, a, 11, 22, 0x895cd7beu, 11); /* 12 */
+  STEP(F, a, b, c, d, 12,  7, 0x6b901122u, 12); /* 13 */
+  STEP(F, d, a, b, c, 13, 12, 0xfd987193u, 13); /* 14 */
+  STEP(F, c, d, a, b, 14, 17, 0xa679438eu, 14); /* 15 */
+  STEP(F, b, c, d, a, 15, 22, 0x49b40821u, 15); /* 16 */
+
+  /* Round 2 */
+  STEP(G, a, b, c, d,  1,  5, 0xf61e2562u, 16); /* 17 */
+  STEP(G, d, a, b, c,  6,  9, 0xc040b340u, 17); /* 18 */
+  STEP(G, c, d, a, b, 11, 14, 0x265e5a51u, 18); /* 19 */
+  STEP(G, b, c, d, a,  0, 20, 0xe9b6c7aau, 19); /* 20 */
+  STEP(G, a, b, c, d,  5,  5, 0xd62f105du, 20); /* 21 */
+  STEP(G, d, a, b, c, 10,  9, 0x02441453u, 21); /* 22 */
+  STEP(G, c, d, a, b, 15, 14, 0xd8a1e681u, 22); /* 23 */
+  STEP(G, b, c, d, a,  4, 20, 0xe7d3fbc8u, 23); /* 24 */
+  STEP(G, a, b, c, d,  9,  5, 0x21e1cde6u, 24); /* 25 */
+  STEP(G, d, a, b, c, 14,  9, 0xc33707d6u, 25); /* 26 */
+  STEP(G, c, d, a, b,  3, 14, 0xf4d50d87u, 26); /* 27 */
+  STEP(G, b, c, d, a,  8, 20, 0x455a14edu, 27); /* 28 */
+  STEP(G, a, b, c, d, 13,  5, 0xa9e3e905u, 28); /* 29 */
+  STEP(G, d, a, b, c,  2,  9, 0xfcefa3f8u, 29); /* 30 */
+  STEP(G, c, d, a, b,  7, 14, 0x676f02d9u, 30); /* 31 */
+  STEP(G, b, c, d, a, 12, 20, 0x8d2a4c8au, 31); /* 32 */
+
+  /* Round 3 */
+  STEP(H, a, b, c, d,  5,  4, 0xfffa3942u, 32); /* 33 */
+  STEP(H, d, a, b, c,  8, 11, 0x8771f681u, 33); /* 34 */
+  STEP(H, c, d, a, b, 11, 16, 0x6d9d6122u, 34); /* 35 */
+  STEP(H, b, c, d, a, 14, 23, 0xfde5380cu, 35); /* 36 */
+  STEP(H, a, b, c, d,  1,  4, 0xa4beea44u, 36); /* 37 */
+  STEP(H, d, a, b, c,  4, 11, 0x4bdecfa9u, 37); /* 38 */
+  STEP(H, c, d, a, b,  7, 16, 0xf6bb4b60u, 38); /* 39 */
+  STEP(H, b, c, d, a, 10, 23, 0xbebfbc70u, 39); /* 40 */
+  STEP(H, a, b, c, d, 13,  4, 0x289b7ec6u, 40); /* 41 */
+  STEP(H, d, a, b, c,  0, 11, 0xeaa127fau, 41); /* 42 */
+  STEP(H, c, d, a, b,  3, 16, 0xd4ef3085u, 42); /* 43 */
+  STEP(H, b, c, d, a,  6, 23, 0x04881d05u, 43); /* 44 */
+  STEP(H, a, b, c, d,  9,  4, 0xd9d4d039u, 44); /* 45 */
+  STEP(H, d, a, b, c, 12, 11, 0xe6db99e5u, 45); /* 46 */
+  STEP(H, c, d, a, b, 15, 16, 0x1fa27cf8u, 46); /* 47 */
+  STEP(H, b, c, d, a,  2, 23, 0xc4ac5665u, 47); /* 48 */
+
+  /* Round 4 */
+  STEP(I, a, b, c, d,  0,  6, 0xf4292244u, 48); /* 49 */
+  STEP(I, d, a, b, c,  7, 10, 0x432aff97u, 49); /* 50 */
+  STEP(I, c, d, a, b, 14, 15, 0xab9423a7u, 50); /* 51 */
+  STEP(I, b, c, d, a,  5, 21, 0xfc93a039u, 51); /* 52 */
+  STEP(I, a, b, c, d, 12,  6, 0x655b59c3u, 52); /* 53 */
+  STEP(I, d, a, b, c,  3, 10, 0x8f0ccc92u, 53); /* 54 */
+  STEP(I, c, d, a, b, 10, 15, 0xffeff47du, 54); /* 55 */
+  STEP(I, b, c, d, a,  1, 21, 0x85845dd1u, 55); /* 56 */
+  STEP(I, a, b, c, d,  8,  6, 0x6fa87e4fu, 56); /* 57 */
+  STEP(I, d, a, b, c, 15, 10, 0xfe2ce6e0u, 57); /* 58 */
+  STEP(I, c, d, a, b,  6, 15, 0xa3014314u, 58); /* 59 */
+  STEP(I, b, c, d, a, 13, 21, 0x4e0811a1u, 59); /* 60 */
+  STEP(I, a, b, c, d,  4,  6, 0xf7537e82u, 60); /* 61 */
+
+  if (target == NULL) {
+    STEP(I, d, a, b, c, 11, 10, 0xbd3af235u, 61); /* 62 */
+    STEP(I, c, d, a, b,  2, 15, 0x2ad7d2bbu, 62); /* 63 */
+    STEP(I, b, c, d, a,  9, 21, 0xeb86d391u, 63); /* 64 */
+    a += a0;
+    b += b0;
+    c += c0;
+    d += d0;
+    memcpy(out->words[0], &a, sizeof(V));
+    memcpy(out->words[1], &b, sizeof(V));
+    memcpy(out->words[2], &c, sizeof(V));
+    memcpy(out->words[3], &d, sizeof(V));
+    return 0;
+  }
+
+  // a does not change anymore, most batches can be rejected right here
+  uint32_t lane[kLanes];
+  uint32_t mask = 0;
+  memcpy(lane, &a, sizeof(V));
+  for (unsigned j = 0; j < kLanes; j++) {
+    if (lane[j] + 0x67452301u == target[0]) mask |= 1u << j;
+  }
+  if (mask == 0) return 0;
+
+  STEP(I, d, a, b, c, 11, 10, 0xbd3af235u, 61); /* 62 */
+  STEP(I, c, d, a, b,  2, 15, 0x2ad7d2bbu, 62); /* 63 */
+  STEP(I, b, c, d, a,  9, 21, 0xeb86d391u, 63); /* 64 */
+
+  uint32_t laneB[kLanes], laneC[kLanes], laneD[kLanes];
+  memcpy(laneB, &b, sizeof(V));
+  memcpy(laneC, &c, sizeof(V));
+  memcpy(laneD, &d, sizeof(V));
+  for (unsigned j = 0; j < kLanes; j++) {
+    if (laneB[j] + 0xefcdab89u != target[1] ||
+        laneC[j] + 0x98badcfeu != target[2] ||
+        laneD[j] + 0x10325476u != target[3]) {
+      mask &= ~(1u << j);
+    }
+  }
+  return mask;
+}
+
+// one instantiation per instruction set and varying word, W = -1 hashes
+// whole blocks
+template <int W>
+static uint32_t matchScalar(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[4]) {
+  return hashLanes<uint32_t, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("sse2")))
+static uint32_t matchSSE2(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[4]) {
+  return hashLanes<v4u, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("avx2")))
+static uint32_t matchAVX2(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[4]) {
+  return hashLanes<v8u, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("avx512f")))
+static uint32_t matchAVX512(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[4]) {
+  return hashLanes<v16u, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+static void digestScalar(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<uint32_t, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("sse2")))
+static void digestSSE2(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v4u, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("avx2")))
+static void digestAVX2(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v8u, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("avx512f")))
+static void digestAVX512(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v16u, W>(block, prefix, NULL, NULL, out);
+}
+
+// the next block of messages longer than one block, state is updated in
+// place
+static void updateScalar(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<uint32_t, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("sse2")))
+static void updateSSE2(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v4u, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("avx2")))
+static void updateAVX2(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v8u, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("avx512f")))
+static void updateAVX512(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v16u, -1>(block, NULL, NULL, state, state);
+}
+
+typedef uint32_t (*MatchFunction)(const LaneBlock& block,
+  const LanePrefix* prefix, const uint32_t target[4]);
+typedef void (*DigestFunction)(const LaneBlock& block,
+  const LanePrefix* prefix, LaneDigests* out);
+
+// the prefix kernels by instruction set (in the order of MD5Simd::Kernel)
+// and varying word
+static const MatchFunction kMatchPrefix[][kMaxPrefixWord + 1] = {
+  { matchScalar<0>, matchScalar<1>, matchScalar<2>, matchScalar<3> },
+  { matchSSE2<0>, matchSSE2<1>, matchSSE2<2>, matchSSE2<3> },
+  { matchAVX2<0>, matchAVX2<1>, matchAVX2<2>, matchAVX2<3> },
+  { matchAVX512<0>, matchAVX512<1>, matchAVX512<2>, matchAVX512<3> }
+};
+
+static const DigestFunction kDigestPrefix[][kMaxPrefixWord + 1] = {
+  { digestScalar<0>, digestScalar<1>, digestScalar<2>, digestScalar<3> },
+  { digestSSE2<0>, digestSSE2<1>, digestSSE2<2>, digestSSE2<3> },
+  { digestAVX2<0>, digestAVX2<1>, digestAVX2<2>, digestAVX2<3> },
+  { digestAVX512<0>, digestAVX512<1>, digestAVX512<2>, digestAVX512<3> }
+};
+
+// the constants of the 64 steps, the same as in hashLanes()
+static const uint32_t kStepConstants[64] = {
+  0xd76aa478u, 0xe8c7b756u, 0x242070dbu, 0xc1bdceeeu,
+  0xf57c0fafu, 0x4787c62au, 0xa8304613u, 0xfd469501u,
+  0x698098d8u, 0x8b44f7afu, 0xffff5bb1u, 0x895cd7beu,
+  0x6b901122u, 0xfd987193u, 0xa679438eu, 0x49b40821u,
+  0xf61e2562u, 0xc040b340u, 0x265e5a51u, 0xe9b6c7aau,
+  0xd62f105du, 0x02441453u, 0xd8a1e681u, 0xe7d3fbc8u,
+  0x21e1cde6u, 0xc33707d6u, 0xf4d50d87u, 0x455a14edu,
+  0xa9e3e905u, 0xfcefa3f8u, 0x676f02d9u, 0x8d2a4c8au,
+  0xfffa3942u, 0x8771f681u, 0x6d9d6122u, 0xfde5380cu,
+  0xa4beea44u, 0x4bdecfa9u, 0xf6bb4b60u, 0xbebfbc70u,
+  0x289b7ec6u, 0xeaa127fau, 0xd4ef3085u, 0x04881d05u,
+  0xd9d4d039u, 0xe6db99e5u, 0x1fa27cf8u, 0xc4ac5665u,
+  0xf4292244u, 0x432aff97u, 0xab9423a7u, 0xfc93a039u,
+  0x655b59c3u, 0x8f0ccc92u, 0xffeff47du, 0x85845dd1u,
+  0x6fa87e4fu, 0xfe2ce6e0u, 0xa3014314u, 0x4e0811a1u,
+  0xf7537e82u, 0xbd3af235u, 0x2ad7d2bbu, 0xeb86d391u
+};
+
+unsigned MD5Simd::lanes(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return 4;
+    case kAVX2: return 8;
+    case kAVX512: return 16;
+    default: return 1;
+  }
+}
+
+const char* MD5Simd::name(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return "sse2";
+    case kAVX2: return "avx2";
+    case kAVX512: return "avx512";
+    default: return "scalar";
+  }
+}
+
+bool MD5Simd::parseKernel(const char* name, Kernel* kernel) {
+  const Kernel kKernels[] = { kScalar, kSSE2, kAVX2, kAVX512 };
+  for (unsigned i = 0; i < sizeof(kKernels) / sizeof(kKernels[0]); i++) {
+    if (strcmp(name, MD5Simd::name(kKernels[i])) == 0) {
+      *kernel = kKernels[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MD5Simd::supported(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return CpuFeatures::has(CpuFeatures::kSSE2);
+    case kAVX2: return CpuFeatures::has(CpuFeatures::kAVX2);
+    case kAVX512: return CpuFeatures::has(CpuFeatures::kAVX512F);
+    default: return true;
+  }
+}
+
+MD5Simd::Kernel MD5Simd::best(unsigned maxLanes) {
+  if (maxLanes >= 16 && supported(kAVX512)) return kAVX512;
+  if (maxLanes >= 8 && supported(kAVX2)) return kAVX2;
+  if (maxLanes >= 4 && supported(kSSE2)) return kSSE2;
+  return kScalar;
+}
+
+// same padding as in MD5::digestSingleBlock, only the words are scattered
+// into the column of the lane. The kernels only run on x86, which stores
+// words little endian like MD5, so the bytes are copied as they are.
+void MD5Simd::setLane(LaneBlock* block, unsigned lane, const char* buf,
+  size_t length) {
+  uint32_t words[16] = { 0 };
+  memcpy(words, buf, length);
+  reinterpret_cast<uint8_t*>(words)[length] = 0x80;
+  for (unsigned i = 0; i < 14; i++) block->words[i][lane] = words[i];
+  block->words[14][lane] = length << 3;
+  block->words[15][lane] = 0;
+}
+
+void MD5Simd::startLane(LaneDigests* state, unsigned lane) {
+  state->words[0][lane] = 0x67452301u;
+  state->words[1][lane] = 0xefcdab89u;
+  state->words[2][lane] = 0x98badcfeu;
+  state->words[3][lane] = 0x10325476u;
+}
+
+// the padding of MD5::finalize, cut into blocks
+void MD5Simd::setBlock(LaneBlock* block, unsigned lane, const char* buf,
+  size_t length, size_t index) {
+  uint32_t words[16] = { 0 };
+  const size_t kOffset = index * 64;
+  if (kOffset < length) {
+    memcpy(words, buf + kOffset, std::min<size_t>(length - kOffset, 64));
+  }
+  if (kOffset <= length && length < kOffset + 64) {
+    reinterpret_cast<uint8_t*>(words)[length - kOffset] = 0x80;
+  }
+  if (index + 1 == paddedBlocks(length)) {
+    const uint64_t kBits = (uint64_t)length << 3;
+    words[14] = (uint32_t)kBits;
+    words[15] = (uint32_t)(kBits >> 32);
+  }
+  for (unsigned i = 0; i < 16; i++) block->words[i][lane] = words[i];
+}
+
+uint32_t MD5Simd::match(Kernel kernel, const LaneBlock& block,
+  const uint32_t target[4]) {
+  switch (kernel) {
+    case kSSE2: return matchSSE2<-1>(block, NULL, target);
+    case kAVX2: return matchAVX2<-1>(block, NULL, target);
+    case kAVX512: return matchAVX512<-1>(block, NULL, target);
+    default: return matchScalar<-1>(block, NULL, target);
+  }
+}
+
+void MD5Simd::digest(Kernel kernel, const LaneBlock& block,
+  LaneDigests* out) {
+  switch (kernel) {
+    case kSSE2: digestSSE2<-1>(block, NULL, out); break;
+    case kAVX2: digestAVX2<-1>(block, NULL, out); break;
+    case kAVX512: digestAVX512<-1>(block, NULL, out); break;
+    default: digestScalar<-1>(block, NULL, out); break;
+  }
+}
+
+void MD5Simd::update(Kernel kernel, const LaneBlock& block,
+  LaneDigests* state) {
+  switch (kernel) {
+    case kSSE2: updateSSE2(block, state); break;
+    case kAVX2: updateAVX2(block, state); break;
+    case kAVX512: updateAVX512(block, state); break;
+    default: updateScalar(block, state); break;
+  }
+}
+
+void MD5Simd::prepare(const uint32_t block[16], unsigned word,
+  LanePrefix* prefix) {
+  prefix->word = word;
+  memcpy(prefix->words, block, 16 * sizeof(uint32_t));
+
+  // add the shared message word of every step to its constant, the rounds
+  // use the words in the orders i, 5i + 1, 3i + 5 and 7i
+  for (unsigned i = 0; i < 64; i++) {
+    const unsigned k = i < 16 ? i : i < 32 ? (5 * i + 1) & 15
+        : i < 48 ? (3 * i + 5) & 15 : (7 * i) & 15;
+    prefix->constants[i] = kStepConstants[i] + (k == word ? 0 : block[k]);
+  }
+
+  // round 1 uses the words in order, so the steps before word only need
+  // shared words. They update a, d, c and b in turn.
+  const unsigned kShifts[4] = { 7, 12, 17, 22 };
+  uint32_t* state = prefix->state;
+  state[0] = 0x67452301u;
+  state[1] = 0xefcdab89u;
+  state[2] = 0x98badcfeu;
+  state[3] = 0x10325476u;
+  for (unsigned i = 0; i < word; i++) {
+    uint32_t& a = state[(4 - i) & 3];
+    const uint32_t b = state[(5 - i) & 3];
+    const uint32_t c = state[(6 - i) & 3];
+    const uint32_t d = state[(7 - i) & 3];
+    a += F(b, c, d) + prefix->constants[i];
+    a = ROTATE_LEFT(a, kShifts[i & 3]) + b;
+  }
+}
+
+uint32_t MD5Simd::matchPrefix(Kernel kernel, const LanePrefix& prefix,
+  const LaneBlock& block, const uint32_t target[4]) {
+  return kMatchPrefix[kernel][prefix.word](block, &prefix, target);
+}
+
+void MD5Simd::digestPrefix(Kernel kernel, const LanePrefix& prefix,
+  const LaneBlock& block, LaneDigests* out) {
+  kDigestPrefix[kernel][prefix.word](block, &prefix, out);
+}
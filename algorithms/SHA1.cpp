@@ -14,6 +14,9 @@ Programmieren in C++ SS-2012
 */
 
 #include "./SHA1.h"
+#include "./LaneBatch.h"
+#include "./SHA1Simd.h"
+#include <string.h>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
@@ -24,28 +27,46 @@ SHA1::SHA1() {
 }
 
 // nifty shortcut constructor, compute SHA1 for string
-// and finalize it right away
+// and finalize it right away, a batch of one message
 SHA1::SHA1(const std::string &text) {
   reset();
-  update(text);
-  finalize();
+  Message message = { text.data(), text.length() };
+  hashBatch(&message, 1, digest);
+  finalized = true;
+}
+
+// the same buffering as in MD5::update: fill the buffer, apply it, apply
+// whole blocks straight from the input and keep the rest
+void SHA1::update(const uint8_t *input, size_t length) {
+  size_t index = count % BLOCK_BYTES;
+  count += length;
+
+  size_t i = 0;
+  if (index + length >= BLOCK_BYTES) {
+    const size_t kFirstpart = BLOCK_BYTES - index;
+    memcpy(&buffer[index], input, kFirstpart);
+    apply(buffer);
+    for (i = kFirstpart; i + BLOCK_BYTES <= length; i += BLOCK_BYTES) {
+      apply(&input[i]);
+    }
+    index = 0;
+  }
+  memcpy(&buffer[index], &input[i], length - i);
+}
+
+void SHA1::update(const char *input, size_t length) {
+  update(reinterpret_cast<const uint8_t*>(input), length);
 }
 
 void SHA1::update(const std::string &s) {
-  std::istringstream is(s);
-  update(&is);
+  update(s.data(), s.size());
 }
 
+// the stream is read in pieces of a fixed size
 void SHA1::update(std::istream *is) {
-  std::string rest_of_buffer;
-  read(is, &rest_of_buffer, BLOCK_BYTES - buffer.size());
-  buffer += rest_of_buffer;
-
-  while (*is) {
-    uint32_t block[BLOCK_INTS];
-    buffer_to_block(buffer, block);
-    apply(block);
-    read(is, &buffer, BLOCK_BYTES);
+  char piece[64 * BLOCK_BYTES];
+  while (is->read(piece, sizeof(piece)) || is->gcount() > 0) {
+    update(piece, is->gcount());
   }
 }
 
@@ -55,30 +76,19 @@ void SHA1::update(std::istream *is) {
 
 SHA1& SHA1::finalize() {
   if (!finalized) {
-    /* Total number of hashed bits */
-    uint64_t total_bits = (transforms*BLOCK_BYTES + buffer.size()) * 8;
-
-    /* Padding */
-    buffer += 0x80;
-    unsigned int orig_size = buffer.size();
-    while (buffer.size() < BLOCK_BYTES) {
-      buffer += static_cast<char>(0x00);
-    }
-
-    uint32_t block[BLOCK_INTS];
-    buffer_to_block(buffer, block);
-
-    if (orig_size > BLOCK_BYTES - 8) {
-      apply(block);
-      for (unsigned int i = 0; i < BLOCK_INTS - 2; i++) {
-        block[i] = 0;
-      }
+    /* Total number of hashed bits, big endian */
+    const uint64_t kTotalBits = count * 8;
+    uint8_t bits[8];
+    for (unsigned int i = 0; i < 8; i++) {
+      bits[i] = kTotalBits >> (56 - 8 * i);
     }
 
-    /* Append total_bits, split this uint64_t into two uint32_t */
-    block[BLOCK_INTS - 1] = total_bits;
-    block[BLOCK_INTS - 2] = (total_bits >> 32);
-    apply(block);
+    /* Padding: 0x80, zeros up to 56 mod 64, the bit count */
+    static const uint8_t kPadding[BLOCK_BYTES] = { 0x80 };
+    const size_t kIndex = count % BLOCK_BYTES;
+    const size_t kPadLength = kIndex < 56 ? 56 - kIndex : 120 - kIndex;
+    update(kPadding, kPadLength);
+    update(bits, 8);
     finalized = true;
   }
 
@@ -97,8 +107,7 @@ void SHA1::reset() {
   digest[4] = 0xc3d2e1f0;
 
   /* Reset counters */
-  transforms = 0;
-  buffer = "";
+  count = 0;
 }
 
 
@@ -106,7 +115,20 @@ void SHA1::reset() {
  * Hash a single 512-bit block. This is the core of the algorithm.
  */
 
-void SHA1::apply(uint32_t block[BLOCK_BYTES]) {
+void SHA1::apply(const uint8_t bytes[BLOCK_BYTES]) {
+  uint32_t block[BLOCK_INTS];
+  bytes_to_block(bytes, block);
+  apply(block);
+}
+
+// with the SHA extensions if the CPU has them, else in plain C++
+void SHA1::apply(uint32_t block[BLOCK_INTS]) {
+  static const bool kSHANI = SHA1Simd::supported(SHA1Simd::kSHANI);
+  if (kSHANI) {
+    SHA1Simd::compress(digest, block);
+    return;
+  }
+
   /* Copy digest[] to working vars */
   uint32_t a = digest[0];
   uint32_t b = digest[1];
@@ -226,28 +248,20 @@ void SHA1::apply(uint32_t block[BLOCK_BYTES]) {
   digest[3] += d;
   digest[4] += e;
 
-  /* Count the number of transformations */
-  transforms++;
 }
 
 
-void SHA1::buffer_to_block(const std::string &buffer,
- uint32_t block[BLOCK_BYTES]) {
-  /* Convert the std::string (byte buffer) to a uint32_t array (MSB) */
+void SHA1::bytes_to_block(const uint8_t bytes[BLOCK_BYTES],
+ uint32_t block[BLOCK_INTS]) {
+  /* Convert the byte buffer to a uint32_t array (MSB) */
   for (unsigned int i = 0; i < BLOCK_INTS; i++) {
-    block[i] = (buffer[4*i+3] & 0xff)
-               | (buffer[4*i+2] & 0xff)<<8
-               | (buffer[4*i+1] & 0xff)<<16
-               | (buffer[4*i+0] & 0xff)<<24;
+    block[i] = bytes[4*i+3]
+               | bytes[4*i+2]<<8
+               | bytes[4*i+1]<<16
+               | static_cast<uint32_t>(bytes[4*i+0])<<24;
   }
 }
 
-void SHA1::read(std::istream *is, std::string *s, const int kMax) {
-  char sbuf[kMax];
-  (*is).read(sbuf, kMax);
-  (*s).assign(sbuf, (*is).gcount());
-}
-
 // return hex representation of digest as string
 std::string SHA1::hexdigest() const {
   if (!finalized)
@@ -261,3 +275,18 @@ std::string SHA1::hexdigest() const {
   return result.str();
 }
 
+
+// return the digest words (big endian word order as in hexdigest)
+const uint32_t* SHA1::rawdigest() const {
+  if (!finalized)
+    return NULL;
+  return digest;
+}
+
+unsigned SHA1::digestWords() const {
+  return DIGEST_INTS;
+}
+
+void SHA1::hashBatch(const Message* messages, size_t n, uint32_t* digests) {
+  hashInLanes<SHA1Simd>(messages, n, DIGEST_INTS, digests);
+}
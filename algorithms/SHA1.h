@@ -21,11 +21,24 @@ class SHA1: public HashAlgorithm {
  public:
   SHA1();
   explicit SHA1(const std::string& text);
+  void update(const uint8_t *buf, size_t length);
+  void update(const char *buf, size_t length);
+  // adapters for the byte buffer version
   void update(const std::string &s);
   void update(std::istream *is);
   void reset();
   SHA1& finalize();
   std::string hexdigest() const;
+  const uint32_t* rawdigest() const;
+  unsigned digestWords() const;
+
+  // the messages are hashed in the lanes of the widest SIMD kernel, this
+  // object is not touched
+  void hashBatch(const Message* messages, size_t n, uint32_t* digests);
+  using HashAlgorithm::hashBatch;
+
+  // longest message which still fits into a single padded block
+  static const size_t kMaxSingleBlock = 55;
 
  private:
   bool finalized;
@@ -37,14 +50,15 @@ class SHA1: public HashAlgorithm {
   static const unsigned int BLOCK_BYTES = BLOCK_INTS * 4;
 
   uint32_t digest[DIGEST_INTS];
-  std::string buffer;
-  uint64_t transforms;
+  uint8_t buffer[BLOCK_BYTES];  // bytes that didn't fit in last block
+  uint64_t count;               // number of bytes hashed so far
 
-  void apply(uint32_t block[BLOCK_BYTES]);
+  void apply(const uint8_t bytes[BLOCK_BYTES]);
+  // the block is overwritten by the message schedule
+  void apply(uint32_t block[BLOCK_INTS]);
 
-  static void buffer_to_block(const std::string &buffer,
-    uint32_t block[BLOCK_BYTES]);
-  static void read(std::istream *is, std::string *s, const int max);
+  static void bytes_to_block(const uint8_t bytes[BLOCK_BYTES],
+    uint32_t block[BLOCK_INTS]);
 };
 
 #endif  // PROJEKT_ALGORITHMS_SHA1_H_
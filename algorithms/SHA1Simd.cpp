@@ -0,0 +1,701 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#include <string.h>
+#include <immintrin.h>
+#include <algorithm>
+#include "./SHA1Simd.h"
+#include "./CpuFeatures.h"
+
+// GCC vector types, one uint32_t per lane
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef uint32_t v8u __attribute__((vector_size(32)));
+typedef uint32_t v16u __attribute__((vector_size(64)));
+
+// The same help macros as in SHA1::apply, they work on uint32_t as well as
+// on vector types. m is the circular buffer of the message schedule.
+#define ROL(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+#define BLK(i) (m[(i) & 15] = ROL(m[((i) + 13) & 15] ^ m[((i) + 8) & 15] \
+  ^ m[((i) + 2) & 15] ^ m[(i) & 15], 1))
+
+/* (R0+R1), R2, R3, R4 are the different operations used in SHA1 */
+#define CH(w, x, y) (((w) & ((x) ^ (y))) ^ (y))
+#define PARITY(w, x, y) ((w) ^ (x) ^ (y))
+#define MAJ(w, x, y) ((((w) | (x)) & (y)) | ((w) & (x)))
+#define R0(v, w, x, y, z, i) STEP(CH, 0x5a827999u, v, w, x, y, z, i)
+#define R1(v, w, x, y, z, i) STEP(CH, 0x5a827999u, v, w, x, y, z, i)
+#define R2(v, w, x, y, z, i) STEP(PARITY, 0x6ed9eba1u, v, w, x, y, z, i)
+#define R3(v, w, x, y, z, i) STEP(MAJ, 0x8f1bbcdcu, v, w, x, y, z, i)
+#define R4(v, w, x, y, z, i) STEP(PARITY, 0xca62c1d6u, v, w, x, y, z, i)
+
+// Whether schedule word i depends on message word W. Only those words are
+// computed for all lanes of a prefix batch, the others are shared.
+template <int i, int W, bool kExpanded = (i >= 16)>
+struct Varies {
+  static const bool value = i == W;
+};
+
+template <int i, int W>
+struct Varies<i, W, true> {
+  static const bool value = Varies<i - 3, W>::value ||
+    Varies<i - 8, W>::value || Varies<i - 14, W>::value ||
+    Varies<i - 16, W>::value;
+};
+
+// Step i with function f and constant k. With a prefix (W >= 0) the shared
+// schedule words are already added to the step constants and the steps
+// before the first use of W are done by SHA1Simd::prepare().
+#define STEP(f, k, v, w, x, y, z, i) { \
+  if (W < 0) { \
+    z += f(w, x, y) + ((i) < 16 ? m[(i) & 15] : BLK(i)) + (k) + ROL(v, 5); \
+    w = ROL(w, 30); \
+  } else if ((i) >= W) { \
+    z += f(w, x, y) + prefix->constants[i] + ROL(v, 5); \
+    if (Varies<i, W>::value) { \
+      z += (i) < 16 ? m[(i) & 15] : BLK(i); \
+    } else if ((i) >= 16) { \
+      m[(i) & 15] = V() + prefix->words[i]; \
+    } \
+    w = ROL(w, 30); \
+  } \
+}
+
+// The 80 rounds for all lanes of V. With a target the digests are compared
+// right away, otherwise they are stored in out. Blocks of longer messages
+// continue from the states in chain (see MD5Simd.cpp).
+template <typename V, int W>
+static inline __attribute__((always_inline)) uint32_t hashLanes(
+  const LaneBlock& block, const LanePrefix* prefix, const uint32_t target[5],
+  const LaneDigests* chain, LaneDigests* out) {
+  const unsigned kLanes = sizeof(V) / sizeof(uint32_t);
+  V m[16];
+  for (int i = 0; i < 16; i++) {
+    if (W < 0 || i == W) {
+      memcpy(&m[i], block.words[i], sizeof(V));
+    } else {
+      m[i] = V() + prefix->words[i];
+    }
+  }
+
+  // the state before this block
+  V a0 = V() + 0x67452301u;
+  V b0 = V() + 0xefcdab89u;
+  V c0 = V() + 0x98badcfeu;
+  V d0 = V() + 0x10325476u;
+  V e0 = V() + 0xc3d2e1f0u;
+  if (chain != NULL) {
+    memcpy(&a0, chain->words[0], sizeof(V));
+    memcpy(&b0, chain->words[1], sizeof(V));
+    memcpy(&c0, chain->words[2], sizeof(V));
+    memcpy(&d0, chain->words[3], sizeof(V));
+    memcpy(&e0, chain->words[4], sizeof(V));
+  }
+
+  V a = W < 0 ? a0 : V() + prefix->state[0];
+  V b = W < 0 ? b0 : V() + prefix->state[1];
+  V c = W < 0 ? c0 : V() + prefix->state[2];
+  V d = W < 0 ? d0 : V() + prefix->state[3];
+  V e = W < 0 ? e0 : V() + prefix->state[4];
+
+  /* 4 rounds of 20 operations each. Loop unrolled. */
+  R0(a, b, c, d, e, 0);
+  R0(e, a, b, c, d, 1);
+  R0(d, e, a, b, c, 2);
+  R0(c, d, e, a, b, 3);
+  R0(b, c, d, e, a, 4);
+  R0(a, b, c, d, e, 5);
+  R0(e, a, b, c, d, 6);
+  R0(d, e, a, b, c, 7);
+  R0(c, d, e, a, b, 8);
+  R0(b, c, d, e, a, 9);
+  R0(a, b, c, d, e, 10);
+  R0(e, a, b, c, d, 11);
+  R0(d, e, a, b, c, 12);
+  R0(c, d, e, a, b, 13);
+  R0(b, c, d, e, a, 14);
+  R0(a, b, c, d, e, 15);
+  R1(e, a, b, c, d, 16);
+  R1(d, e, a, b, c, 17);
+  R1(c, d, e, a, b, 18);
+  R1(b, c, d, e, a, 19);
+  R2(a, b, c, d, e, 20);
+  R2(e, a, b, c, d, 21);
+  R2(d, e, a, b, c, 22);
+  R2(c, d, e, a, b, 23);
+  R2(b, c, d, e, a, 24);
+  R2(a, b, c, d, e, 25);
+  R2(e, a, b, c, d, 26);
+  R2(d, e, a, b, c, 27);
+  R2(c, d, e, a, b, 28);
+  R2(b, c, d, e, a, 29);
+  R2(a, b, c, d, e, 30);
+  R2(e, a, b, c, d, 31);
+  R2(d, e, a, b, c, 32);
+  R2(c, d, e, a, b, 33);
+  R2(b, c, d, e, a, 34);
+  R2(a, b, c, d, e, 35);
+  R2(e, a, b, c, d, 36);
+  R2(d, e, a, b, c, 37);
+  R2(c, d, e, a, b, 38);
+  R2(b, c, d, e, a, 39);
+  R3(a, b, c, d, e, 40);
+  R3(e, a, b, c, d, 41);
+  R3(d, e, a, b, c, 42);
+  R3(c, d, e, a, b, 43);
+  R3(b, c, d, e, a, 44);
+  R3(a, b, c, d, e, 45);
+  R3(e, a, b, c, d, 46);
+  R3(d, e, a, b, c, 47);
+  R3(c, d, e, a, b, 48);
+  R3(b, c, d, e, a, 49);
+  R3(a, b, c, d, e, 50);
+  R3(e, a, b, c, d, 51);
+  R3(d, e, a, b, c, 52);
+  R3(c, d, e, a, b, 53);
+  R3(b, c, d, e, a, 54);
+  R3(a, b, c, d, e, 55);
+  R3(e, a, b, c, d, 56);
+  R3(d, e, a, b, c, 57);
+  R3(c, d, e, a, b, 58);
+  R3(b, c, d, e, a, 59);
+  R4(a, b, c, d, e, 60);
+  R4(e, a, b, c, d, 61);
+  R4(d, e, a, b, c, 62);
+  R4(c, d, e, a, b, 63);
+  R4(b, c, d, e, a, 64);
+  R4(a, b, c, d, e, 65);
+  R4(e, a, b, c, d, 66);
+  R4(d, e, a, b, c, 67);
+  R4(c, d, e, a, b, 68);
+  R4(b, c, d, e, a, 69);
+  R4(a, b, c, d, e, 70);
+  R4(e, a, b, c, d, 71);
+  R4(d, e, a, b, c, 72);
+  R4(c, d, e, a, b, 73);
+  R4(b, c, d, e, a, 74);
+  R4(a, b, c, d, e, 75);
+  R4(e, a, b, c, d, 76);
+  R4(d, e, a, b, c, 77);
+
+  if (target == NULL) {
+    R4(c, d, e, a, b, 78);
+    R4(b, c, d, e, a, 79);
+    a += a0;
+    b += b0;
+    c += c0;
+    d += d0;
+    e += e0;
+    memcpy(out->words[0], &a, sizeof(V));
+    memcpy(out->words[1], &b, sizeof(V));
+    memcpy(out->words[2], &c, sizeof(V));
+    memcpy(out->words[3], &d, sizeof(V));
+    memcpy(out->words[4], &e, sizeof(V));
+    return 0;
+  }
+
+  // e does not change anymore, most batches can be rejected right here
+  uint32_t lane[kLanes];
+  uint32_t mask = 0;
+  memcpy(lane, &e, sizeof(V));
+  for (unsigned j = 0; j < kLanes; j++) {
+    if (lane[j] + 0xc3d2e1f0u == target[4]) mask |= 1u << j;
+  }
+  if (mask == 0) return 0;
+
+  R4(c, d, e, a, b, 78);
+  R4(b, c, d, e, a, 79);
+
+  uint32_t laneA[kLanes], laneB[kLanes], laneC[kLanes], laneD[kLanes];
+  memcpy(laneA, &a, sizeof(V));
+  memcpy(laneB, &b, sizeof(V));
+  memcpy(laneC, &c, sizeof(V));
+  memcpy(laneD, &d, sizeof(V));
+  for (unsigned j = 0; j < kLanes; j++) {
+    if (laneA[j] + 0x67452301u != target[0] ||
+        laneB[j] + 0xefcdab89u != target[1] ||
+        laneC[j] + 0x98badcfeu != target[2] ||
+        laneD[j] + 0x10325476u != target[3]) {
+      mask &= ~(1u << j);
+    }
+  }
+  return mask;
+}
+
+// one instantiation per instruction set and varying word, W = -1 hashes
+// whole blocks
+template <int W>
+static uint32_t matchScalar(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[5]) {
+  return hashLanes<uint32_t, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("sse2")))
+static uint32_t matchSSE2(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[5]) {
+  return hashLanes<v4u, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("avx2")))
+static uint32_t matchAVX2(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[5]) {
+  return hashLanes<v8u, W>(block, prefix, target, NULL, NULL);
+}
+
+template <int W>
+__attribute__((target("avx512f")))
+static uint32_t matchAVX512(const LaneBlock& block, const LanePrefix* prefix,
+  const uint32_t target[5]) {
+  return hashLanes<v16u, W>(block, prefix, target, NULL, NULL);
+}
+
+// The SHA-NI kernel hashes kInterleave messages side by side, each
+// instruction depends on the one before, so a single message would leave
+// the SHA unit waiting for results most of the time.
+static const unsigned kInterleave = 2;
+
+// apply an SSE/SHA operation to all interleaved messages
+#define ALL(statement) { \
+  for (unsigned n = 0; n < kMessages; n++) { statement; } \
+}
+
+template <int W>
+static void digestScalar(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<uint32_t, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("sse2")))
+static void digestSSE2(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v4u, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("avx2")))
+static void digestAVX2(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v8u, W>(block, prefix, NULL, NULL, out);
+}
+
+template <int W>
+__attribute__((target("avx512f")))
+static void digestAVX512(const LaneBlock& block, const LanePrefix* prefix,
+  LaneDigests* out) {
+  hashLanes<v16u, W>(block, prefix, NULL, NULL, out);
+}
+
+// the next block of messages longer than one block, state is updated in
+// place
+static void updateScalar(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<uint32_t, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("sse2")))
+static void updateSSE2(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v4u, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("avx2")))
+static void updateAVX2(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v8u, -1>(block, NULL, NULL, state, state);
+}
+
+__attribute__((target("avx512f")))
+static void updateAVX512(const LaneBlock& block, LaneDigests* state) {
+  hashLanes<v16u, -1>(block, NULL, NULL, state, state);
+}
+
+// Rounds 4g to 4g+3 of the SHA-NI kernel for 4 <= g <= 16: m0 holds the
+// schedule words of this group, sha1msg2 finishes the words of the next
+// group, sha1msg1 and the xor prepare the two groups after that.
+#define QUAD(e, enext, m0, m1, m2, m3, f) ALL( \
+  e[n] = _mm_sha1nexte_epu32(e[n], m0[n]); \
+  enext[n] = abcd[n]; \
+  m1[n] = _mm_sha1msg2_epu32(m1[n], m0[n]); \
+  abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e[n], f); \
+  m3[n] = _mm_sha1msg1_epu32(m3[n], m0[n]); \
+  m2[n] = _mm_xor_si128(m2[n], m0[n]))
+
+// SHA extensions, the first kMessages messages of the batch are hashed
+// interleaved. Like hashLanes() the digests are either compared or stored
+// in out, starting from the initial state or the states in chain.
+template <unsigned kMessages>
+__attribute__((target("sha,sse4.1")))
+static inline __attribute__((always_inline)) uint32_t hashSHANI(
+  const LaneBlock& block, const uint32_t target[5], const LaneDigests* chain,
+  LaneDigests* out) {
+  // a is kept in the highest element, the message words likewise
+  __m128i abcdSave[kMessages], eSave[kMessages];
+  ALL(
+    if (chain == NULL) {
+      abcdSave[n] = _mm_set_epi32(0x67452301, 0xefcdab89, 0x98badcfe,
+        0x10325476);
+      eSave[n] = _mm_set_epi32(0xc3d2e1f0, 0, 0, 0);
+    } else {
+      abcdSave[n] = _mm_set_epi32(chain->words[0][n], chain->words[1][n],
+        chain->words[2][n], chain->words[3][n]);
+      eSave[n] = _mm_set_epi32(chain->words[4][n], 0, 0, 0);
+    })
+  __m128i abcd[kMessages], e0[kMessages], e1[kMessages];
+  __m128i msg0[kMessages], msg1[kMessages], msg2[kMessages],
+    msg3[kMessages];
+  ALL(
+    abcd[n] = abcdSave[n];
+    e0[n] = eSave[n];
+    msg0[n] = _mm_set_epi32(block.words[0][n], block.words[1][n],
+      block.words[2][n], block.words[3][n]);
+    msg1[n] = _mm_set_epi32(block.words[4][n], block.words[5][n],
+      block.words[6][n], block.words[7][n]);
+    msg2[n] = _mm_set_epi32(block.words[8][n], block.words[9][n],
+      block.words[10][n], block.words[11][n]);
+    msg3[n] = _mm_set_epi32(block.words[12][n], block.words[13][n],
+      block.words[14][n], block.words[15][n]));
+
+  /* Rounds 0-3 */
+  ALL(
+    e0[n] = _mm_add_epi32(e0[n], msg0[n]);
+    e1[n] = abcd[n];
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e0[n], 0));
+
+  /* Rounds 4-7 */
+  ALL(
+    e1[n] = _mm_sha1nexte_epu32(e1[n], msg1[n]);
+    e0[n] = abcd[n];
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e1[n], 0);
+    msg0[n] = _mm_sha1msg1_epu32(msg0[n], msg1[n]));
+
+  /* Rounds 8-11 */
+  ALL(
+    e0[n] = _mm_sha1nexte_epu32(e0[n], msg2[n]);
+    e1[n] = abcd[n];
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e0[n], 0);
+    msg1[n] = _mm_sha1msg1_epu32(msg1[n], msg2[n]);
+    msg0[n] = _mm_xor_si128(msg0[n], msg2[n]));
+
+  /* Rounds 12-15 */
+  ALL(
+    e1[n] = _mm_sha1nexte_epu32(e1[n], msg3[n]);
+    e0[n] = abcd[n];
+    msg0[n] = _mm_sha1msg2_epu32(msg0[n], msg3[n]);
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e1[n], 0);
+    msg2[n] = _mm_sha1msg1_epu32(msg2[n], msg3[n]);
+    msg1[n] = _mm_xor_si128(msg1[n], msg3[n]));
+
+  /* Rounds 16-67 */
+  QUAD(e0, e1, msg0, msg1, msg2, msg3, 0);
+  QUAD(e1, e0, msg1, msg2, msg3, msg0, 1);
+  QUAD(e0, e1, msg2, msg3, msg0, msg1, 1);
+  QUAD(e1, e0, msg3, msg0, msg1, msg2, 1);
+  QUAD(e0, e1, msg0, msg1, msg2, msg3, 1);
+  QUAD(e1, e0, msg1, msg2, msg3, msg0, 1);
+  QUAD(e0, e1, msg2, msg3, msg0, msg1, 2);
+  QUAD(e1, e0, msg3, msg0, msg1, msg2, 2);
+  QUAD(e0, e1, msg0, msg1, msg2, msg3, 2);
+  QUAD(e1, e0, msg1, msg2, msg3, msg0, 2);
+  QUAD(e0, e1, msg2, msg3, msg0, msg1, 2);
+  QUAD(e1, e0, msg3, msg0, msg1, msg2, 3);
+  QUAD(e0, e1, msg0, msg1, msg2, msg3, 3);
+
+  /* Rounds 68-71 */
+  ALL(
+    e1[n] = _mm_sha1nexte_epu32(e1[n], msg1[n]);
+    e0[n] = abcd[n];
+    msg2[n] = _mm_sha1msg2_epu32(msg2[n], msg1[n]);
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e1[n], 3);
+    msg3[n] = _mm_xor_si128(msg3[n], msg1[n]));
+
+  /* Rounds 72-75 */
+  ALL(
+    e0[n] = _mm_sha1nexte_epu32(e0[n], msg2[n]);
+    e1[n] = abcd[n];
+    msg3[n] = _mm_sha1msg2_epu32(msg3[n], msg2[n]);
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e0[n], 3));
+
+  /* Rounds 76-79 */
+  ALL(
+    e1[n] = _mm_sha1nexte_epu32(e1[n], msg3[n]);
+    e0[n] = abcd[n];
+    abcd[n] = _mm_sha1rnds4_epu32(abcd[n], e1[n], 3));
+
+  /* Add the working vars back into the initial state and compare */
+  uint32_t mask = 0;
+  for (unsigned n = 0; n < kMessages; n++) {
+    e0[n] = _mm_sha1nexte_epu32(e0[n], eSave[n]);
+    abcd[n] = _mm_add_epi32(abcd[n], abcdSave[n]);
+    if (target == NULL) {
+      out->words[0][n] = _mm_extract_epi32(abcd[n], 3);
+      out->words[1][n] = _mm_extract_epi32(abcd[n], 2);
+      out->words[2][n] = _mm_extract_epi32(abcd[n], 1);
+      out->words[3][n] = _mm_extract_epi32(abcd[n], 0);
+      out->words[4][n] = _mm_extract_epi32(e0[n], 3);
+    } else if ((uint32_t)_mm_extract_epi32(abcd[n], 3) == target[0] &&
+        (uint32_t)_mm_extract_epi32(abcd[n], 2) == target[1] &&
+        (uint32_t)_mm_extract_epi32(abcd[n], 1) == target[2] &&
+        (uint32_t)_mm_extract_epi32(abcd[n], 0) == target[3] &&
+        (uint32_t)_mm_extract_epi32(e0[n], 3) == target[4]) {
+      mask |= 1u << n;
+    }
+  }
+  return mask;
+}
+
+__attribute__((target("sha,sse4.1")))
+static uint32_t matchSHANI(const LaneBlock& block, const uint32_t target[5]) {
+  return hashSHANI<kInterleave>(block, target, NULL, NULL);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void digestSHANI(const LaneBlock& block, LaneDigests* out) {
+  hashSHANI<kInterleave>(block, NULL, NULL, out);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void updateSHANI(const LaneBlock& block, LaneDigests* state) {
+  hashSHANI<kInterleave>(block, NULL, state, state);
+}
+
+// a single message for the streaming SHA1 class, which has no second
+// message to interleave
+__attribute__((target("sha,sse4.1")))
+static void compressSHANI(const LaneBlock& block, LaneDigests* state) {
+  hashSHANI<1>(block, NULL, state, state);
+}
+
+typedef uint32_t (*MatchFunction)(const LaneBlock& block,
+  const LanePrefix* prefix, const uint32_t target[5]);
+typedef void (*DigestFunction)(const LaneBlock& block,
+  const LanePrefix* prefix, LaneDigests* out);
+
+// the prefix kernels by instruction set (in the order of SHA1Simd::Kernel,
+// without SHA-NI) and varying word
+static const MatchFunction kMatchPrefix[][kMaxPrefixWord + 1] = {
+  { matchScalar<0>, matchScalar<1>, matchScalar<2>, matchScalar<3> },
+  { matchSSE2<0>, matchSSE2<1>, matchSSE2<2>, matchSSE2<3> },
+  { matchAVX2<0>, matchAVX2<1>, matchAVX2<2>, matchAVX2<3> },
+  { matchAVX512<0>, matchAVX512<1>, matchAVX512<2>, matchAVX512<3> }
+};
+
+static const DigestFunction kDigestPrefix[][kMaxPrefixWord + 1] = {
+  { digestScalar<0>, digestScalar<1>, digestScalar<2>, digestScalar<3> },
+  { digestSSE2<0>, digestSSE2<1>, digestSSE2<2>, digestSSE2<3> },
+  { digestAVX2<0>, digestAVX2<1>, digestAVX2<2>, digestAVX2<3> },
+  { digestAVX512<0>, digestAVX512<1>, digestAVX512<2>, digestAVX512<3> }
+};
+
+// The SHA unit computes the whole schedule itself, its prefix batches are
+// expanded into whole blocks again.
+static void expandPrefix(const LanePrefix& prefix, const LaneBlock& block,
+  LaneBlock* out) {
+  for (unsigned i = 0; i < 16; i++) {
+    for (unsigned lane = 0; lane < kInterleave; lane++) {
+      out->words[i][lane] = i == prefix.word ? block.words[i][lane]
+          : prefix.words[i];
+    }
+  }
+}
+
+unsigned SHA1Simd::lanes(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return 4;
+    case kAVX2: return 8;
+    case kAVX512: return 16;
+    case kSHANI: return kInterleave;
+    default: return 1;
+  }
+}
+
+const char* SHA1Simd::name(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return "sse2";
+    case kAVX2: return "avx2";
+    case kAVX512: return "avx512";
+    case kSHANI: return "sha-ni";
+    default: return "scalar";
+  }
+}
+
+bool SHA1Simd::parseKernel(const char* name, Kernel* kernel) {
+  const Kernel kKernels[] = { kScalar, kSSE2, kAVX2, kAVX512, kSHANI };
+  for (unsigned i = 0; i < sizeof(kKernels) / sizeof(kKernels[0]); i++) {
+    if (strcmp(name, SHA1Simd::name(kKernels[i])) == 0) {
+      *kernel = kKernels[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SHA1Simd::supported(Kernel kernel) {
+  switch (kernel) {
+    case kSSE2: return CpuFeatures::has(CpuFeatures::kSSE2);
+    case kAVX2: return CpuFeatures::has(CpuFeatures::kAVX2);
+    case kAVX512: return CpuFeatures::has(CpuFeatures::kAVX512F);
+    case kSHANI: return CpuFeatures::has(CpuFeatures::kSHA
+      | CpuFeatures::kSSE41);
+    default: return true;
+  }
+}
+
+// 16 lanes of AVX-512 outrun the SHA unit, but on CPUs without AVX-512
+// the SHA extensions beat the 8 AVX2 lanes
+SHA1Simd::Kernel SHA1Simd::best(unsigned maxLanes) {
+  if (maxLanes >= 16 && supported(kAVX512)) return kAVX512;
+  if (maxLanes >= kInterleave && supported(kSHANI)) return kSHANI;
+  if (maxLanes >= 8 && supported(kAVX2)) return kAVX2;
+  if (maxLanes >= 4 && supported(kSSE2)) return kSSE2;
+  return kScalar;
+}
+
+// the padding of SHA1::finalize for a single block, big endian words
+void SHA1Simd::setLane(LaneBlock* block, unsigned lane, const char* buf,
+  size_t length) {
+  uint32_t words[16] = { 0 };
+  memcpy(words, buf, length);
+  reinterpret_cast<uint8_t*>(words)[length] = 0x80;
+  for (unsigned i = 0; i < 14; i++) {
+    block->words[i][lane] = __builtin_bswap32(words[i]);
+  }
+  block->words[14][lane] = 0;
+  block->words[15][lane] = length << 3;
+}
+
+void SHA1Simd::startLane(LaneDigests* state, unsigned lane) {
+  state->words[0][lane] = 0x67452301u;
+  state->words[1][lane] = 0xefcdab89u;
+  state->words[2][lane] = 0x98badcfeu;
+  state->words[3][lane] = 0x10325476u;
+  state->words[4][lane] = 0xc3d2e1f0u;
+}
+
+// the padding of SHA1::finalize, cut into blocks
+void SHA1Simd::setBlock(LaneBlock* block, unsigned lane, const char* buf,
+  size_t length, size_t index) {
+  uint32_t words[16] = { 0 };
+  const size_t kOffset = index * 64;
+  if (kOffset < length) {
+    memcpy(words, buf + kOffset, std::min<size_t>(length - kOffset, 64));
+  }
+  if (kOffset <= length && length < kOffset + 64) {
+    reinterpret_cast<uint8_t*>(words)[length - kOffset] = 0x80;
+  }
+  for (unsigned i = 0; i < 16; i++) words[i] = __builtin_bswap32(words[i]);
+  if (index + 1 == paddedBlocks(length)) {
+    const uint64_t kBits = (uint64_t)length << 3;
+    words[14] = (uint32_t)(kBits >> 32);
+    words[15] = (uint32_t)kBits;
+  }
+  for (unsigned i = 0; i < 16; i++) block->words[i][lane] = words[i];
+}
+
+uint32_t SHA1Simd::match(Kernel kernel, const LaneBlock& block,
+  const uint32_t target[5]) {
+  switch (kernel) {
+    case kSSE2: return matchSSE2<-1>(block, NULL, target);
+    case kAVX2: return matchAVX2<-1>(block, NULL, target);
+    case kAVX512: return matchAVX512<-1>(block, NULL, target);
+    case kSHANI: return matchSHANI(block, target);
+    default: return matchScalar<-1>(block, NULL, target);
+  }
+}
+
+void SHA1Simd::digest(Kernel kernel, const LaneBlock& block,
+  LaneDigests* out) {
+  switch (kernel) {
+    case kSSE2: digestSSE2<-1>(block, NULL, out); break;
+    case kAVX2: digestAVX2<-1>(block, NULL, out); break;
+    case kAVX512: digestAVX512<-1>(block, NULL, out); break;
+    case kSHANI: digestSHANI(block, out); break;
+    default: digestScalar<-1>(block, NULL, out); break;
+  }
+}
+
+void SHA1Simd::update(Kernel kernel, const LaneBlock& block,
+  LaneDigests* state) {
+  switch (kernel) {
+    case kSSE2: updateSSE2(block, state); break;
+    case kAVX2: updateAVX2(block, state); break;
+    case kAVX512: updateAVX512(block, state); break;
+    case kSHANI: updateSHANI(block, state); break;
+    default: updateScalar(block, state); break;
+  }
+}
+
+void SHA1Simd::compress(uint32_t state[5], const uint32_t block[16]) {
+  LaneBlock lanes;
+  LaneDigests states;
+  for (unsigned i = 0; i < 16; i++) lanes.words[i][0] = block[i];
+  for (unsigned i = 0; i < 5; i++) states.words[i][0] = state[i];
+  compressSHANI(lanes, &states);
+  for (unsigned i = 0; i < 5; i++) state[i] = states.words[i][0];
+}
+
+void SHA1Simd::prepare(const uint32_t block[16], unsigned word,
+  LanePrefix* prefix) {
+  prefix->word = word;
+  memcpy(prefix->words, block, 16 * sizeof(uint32_t));
+
+  // the whole message schedule, and which of its words depend on word
+  // (the same as Varies in hashLanes)
+  bool varies[80];
+  for (unsigned i = 0; i < 80; i++) {
+    uint32_t* w = prefix->words;
+    if (i < 16) {
+      varies[i] = i == word;
+      continue;
+    }
+    w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    varies[i] = varies[i - 3] || varies[i - 8] || varies[i - 14]
+        || varies[i - 16];
+  }
+
+  // add the shared schedule words to the step constants
+  const uint32_t kRoundConstants[4] = { 0x5a827999u, 0x6ed9eba1u,
+    0x8f1bbcdcu, 0xca62c1d6u };
+  for (unsigned i = 0; i < 80; i++) {
+    prefix->constants[i] = kRoundConstants[i / 20]
+        + (varies[i] ? 0 : prefix->words[i]);
+  }
+
+  // the steps before word only need shared words, they update e, d, c, b
+  // and a in turn
+  uint32_t* state = prefix->state;
+  state[0] = 0x67452301u;
+  state[1] = 0xefcdab89u;
+  state[2] = 0x98badcfeu;
+  state[3] = 0x10325476u;
+  state[4] = 0xc3d2e1f0u;
+  for (unsigned i = 0; i < word; i++) {
+    const uint32_t v = state[(5 - i % 5) % 5];
+    uint32_t& w = state[(6 - i % 5) % 5];
+    const uint32_t x = state[(7 - i % 5) % 5];
+    const uint32_t y = state[(8 - i % 5) % 5];
+    uint32_t& z = state[(9 - i % 5) % 5];
+    z += CH(w, x, y) + prefix->constants[i] + ROL(v, 5);
+    w = ROL(w, 30);
+  }
+}
+
+uint32_t SHA1Simd::matchPrefix(Kernel kernel, const LanePrefix& prefix,
+  const LaneBlock& block, const uint32_t target[5]) {
+  if (kernel == kSHANI) {
+    LaneBlock expanded;
+    expandPrefix(prefix, block, &expanded);
+    return matchSHANI(expanded, target);
+  }
+  return kMatchPrefix[kernel][prefix.word](block, &prefix, target);
+}
+
+void SHA1Simd::digestPrefix(Kernel kernel, const LanePrefix& prefix,
+  const LaneBlock& block, LaneDigests* out) {
+  if (kernel == kSHANI) {
+    LaneBlock expanded;
+    expandPrefix(prefix, block, &expanded);
+    digestSHANI(expanded, out);
+    return;
+  }
+  kDigestPrefix[kernel][prefix.word](block, &prefix, out);
+}
@@ -0,0 +1,95 @@
+// Copyright 2012, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Jerome Meinke <meinkej@informatik.uni-freiburg.de>.
+
+#ifndef PROJEKT_ALGORITHMS_SHA1SIMD_H_
+#define PROJEKT_ALGORITHMS_SHA1SIMD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "./LaneBlock.h"
+
+// SHA-1 of a batch of single block messages, the counterpart of MD5Simd.
+// There are two kinds of back ends: the multi-lane kernels run the rounds
+// and the message schedule on one message per SIMD lane, the SHA-NI kernel
+// uses the x86 SHA extensions (sha1rnds4, sha1msg1, sha1msg2) on two
+// interleaved messages.
+//
+// usage: 1) put up to lanes(kernel) messages into a LaneBlock with setLane()
+//        2) match() them against the raw SHA-1 state of the hash to find
+//           or get all their digest() words
+//        or, for messages differing in a single word, prepare() a prefix
+//        once and matchPrefix() or digestPrefix() batches of that word
+//        or, for longer messages, startLane() and update() the lanes with
+//        every block of their messages from setBlock()
+class SHA1Simd {
+ public:
+  enum Kernel {
+    kScalar,  // one lane, plain C++
+    kSSE2,    // 4 lanes
+    kAVX2,    // 8 lanes
+    kAVX512,  // 16 lanes
+    kSHANI    // SHA extensions, 2 interleaved messages
+  };
+
+  // number of messages hashed by one call of match()
+  static unsigned lanes(Kernel kernel);
+
+  // name of the kernel as used on the command line
+  static const char* name(Kernel kernel);
+
+  // look up a kernel by its name, returns false for unknown names
+  static bool parseKernel(const char* name, Kernel* kernel);
+
+  // whether the CPU we are running on can execute the kernel
+  static bool supported(Kernel kernel);
+
+  // the fastest kernel supported by this CPU, with at most maxLanes lanes
+  static Kernel best(unsigned maxLanes = kMaxLanes);
+
+  // Pad a message of at most SHA1::kMaxSingleBlock bytes into a lane,
+  // the words are stored big endian as SHA-1 reads them
+  static void setLane(LaneBlock* block, unsigned lane, const char* buf,
+    size_t length);
+
+  // Hash the first lanes(kernel) messages of the block. Bit j of the result
+  // is set if the digest of lane j equals the state words in target.
+  static uint32_t match(Kernel kernel, const LaneBlock& block,
+    const uint32_t target[5]);
+
+  // Hash the first lanes(kernel) messages of the block and store their
+  // digests as raw state words, for comparing against many targets.
+  static void digest(Kernel kernel, const LaneBlock& block, LaneDigests* out);
+
+  // Put the initial SHA-1 state into a lane of the running states.
+  static void startLane(LaneDigests* state, unsigned lane);
+
+  // Pad a message of any length and put its block with the given index
+  // (up to paddedBlocks(length) - 1) into a lane, big endian like setLane.
+  static void setBlock(LaneBlock* block, unsigned lane, const char* buf,
+    size_t length, size_t index);
+
+  // Hash the next block of the first lanes(kernel) messages of the block,
+  // continuing from the running states which are updated in place. After
+  // the last block they hold the digests like digest() does.
+  static void update(Kernel kernel, const LaneBlock& block,
+    LaneDigests* state);
+
+  // One block of a single message with the SHA extensions, for the
+  // streaming SHA1 class. Only call it if supported(kSHANI).
+  static void compress(uint32_t state[5], const uint32_t block[16]);
+
+  // Set up a prefix batch for messages which share all words of this
+  // padded block apart from word (at most kMaxPrefixWord).
+  static void prepare(const uint32_t block[16], unsigned word,
+    LanePrefix* prefix);
+
+  // match() and digest() for a prefix batch, only the varying word of the
+  // lanes is read from the block.
+  static uint32_t matchPrefix(Kernel kernel, const LanePrefix& prefix,
+    const LaneBlock& block, const uint32_t target[5]);
+  static void digestPrefix(Kernel kernel, const LanePrefix& prefix,
+    const LaneBlock& block, LaneDigests* out);
+};
+
+#endif  // PROJEKT_ALGORITHMS_SHA1SIMD_H_